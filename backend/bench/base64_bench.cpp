@@ -0,0 +1,93 @@
+// Throughput of the shared base64 codec (../common/base64.cpp) in each
+// implementation the CPU supports, against what it replaced: the OpenSSL
+// BIO chain plus newline stripping the CLI used to encode with, and
+// OpenSSL's block decoder standing in for the table-driven scalar decode of
+// the AWS SDK (which is not linked here).
+//
+// Usage: base64_bench [megabytes]   (default 6, the API Gateway payload limit)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <openssl/bio.h>
+#include <openssl/buffer.h>
+#include <openssl/evp.h>
+
+#include "base64.h"
+
+namespace {
+
+const int ROUNDS = 10;
+
+// Best of ROUNDS, in MB/s of raw (decoded) bytes
+double throughput(size_t bytes, const std::function<void()>& fn) {
+    double best = 1e30;
+    for (int i = 0; i < ROUNDS; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return bytes / 1e6 / best;
+}
+
+// The CLI's encoder before the shared codec
+std::string bio_encode(const std::vector<unsigned char>& input) {
+    BIO* b64 = BIO_new(BIO_f_base64());
+    BIO* bio = BIO_new(BIO_s_mem());
+    bio = BIO_push(b64, bio);
+    BIO_write(bio, input.data(), static_cast<int>(input.size()));
+    BIO_flush(bio);
+    BUF_MEM* buffer_ptr;
+    BIO_get_mem_ptr(bio, &buffer_ptr);
+    std::string encoded(buffer_ptr->data, buffer_ptr->length);
+    encoded.erase(std::remove(encoded.begin(), encoded.end(), '\n'), encoded.end());
+    BIO_free_all(bio);
+    return encoded;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    size_t size = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 6) * 1000 * 1000;
+    std::vector<unsigned char> raw(size);
+    std::mt19937 rng(42);
+    for (auto& b : raw) b = static_cast<unsigned char>(rng());
+
+    std::string text(base64_encoded_size(size), '\0');
+    std::vector<unsigned char> decoded(base64_decoded_max_size(text.size()) + 3);
+    Base64Impl best = base64_best();
+
+    std::printf("%-18s %12s %12s\n", "implementation", "encode MB/s", "decode MB/s");
+    double enc = throughput(size, [&] {
+        std::string out = bio_encode(raw);
+        text.swap(out);
+    });
+    double dec = throughput(size, [&] {
+        EVP_DecodeBlock(decoded.data(), reinterpret_cast<const unsigned char*>(text.data()), static_cast<int>(text.size()));
+    });
+    std::printf("%-18s %12.0f %12.0f\n", "openssl (before)", enc, dec);
+
+    for (Base64Impl impl : {Base64Impl::Scalar, Base64Impl::Ssse3, Base64Impl::Avx2}) {
+        if (!base64_use(impl)) {
+            std::printf("%-18s %12s %12s\n", base64_name(impl), "n/a", "n/a");
+            continue;
+        }
+        enc = throughput(size, [&] { base64_encode(raw.data(), raw.size(), &text[0]); });
+        size_t n = 0;
+        bool ok = true;
+        dec = throughput(size, [&] { ok = base64_decode(text.data(), text.size(), decoded.data(), n) && ok; });
+        if (!ok || n != size || std::memcmp(decoded.data(), raw.data(), size) != 0) {
+            std::fprintf(stderr, "%s: round trip failed\n", base64_name(impl));
+            return 1;
+        }
+        std::printf("%-18s %12.0f %12.0f%s\n", base64_name(impl), enc, dec, impl == best ? "  (selected)" : "");
+    }
+    return 0;
+}
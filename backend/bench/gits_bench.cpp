@@ -0,0 +1,270 @@
+// Stage benchmark for `gits schedule`: builds a synthetic git repository, then
+// times each stage between the work tree and the request body on its own,
+// reporting the best run's time, its throughput and the heap allocations it
+// made. Inputs a stage needs (status for gather, the zip for base64, ...) are
+// prepared untimed first.
+//
+//   status   repo_status over the work tree
+//   gather   gather_file_changes on that status
+//   zip      create_zip of the changed files
+//   base64   base64_encode_file of the zip (UPLOAD_MODE=buffered)
+//   payload  serializing the buffered schedule body with zip_base64
+//   stream   draining the streamed schedule body (UPLOAD_MODE=stream)
+//
+// Usage: gits_bench [--files N] [--size BYTES] [--modify R] [--rename R]
+//                   [--delete R] [--stage NAME] [--iterations N]
+// Defaults: 10000 files of 4096 bytes; 20% modified, 5% renamed, 5% deleted;
+// all stages, best of 3.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <unistd.h>
+
+#include "../changeset.h"
+#include "../file_changes.h"
+#include "../git_repo.h"
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+namespace {
+
+std::atomic<size_t> alloc_count{0};
+std::atomic<size_t> alloc_bytes{0};
+
+}  // namespace
+
+// Every heap allocation in the process is counted, worker threads included
+void* operator new(size_t size) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+// Struct for the synthetic repository's shape
+struct Options {
+    size_t files = 10000;
+    size_t size = 4096;
+    double modify = 0.2;
+    double rename = 0.05;
+    double remove = 0.05;
+    std::string stage;
+    int iterations = 3;
+};
+
+// Struct for one stage's best run
+struct Result {
+    double ms = 0;
+    size_t allocs = 0;
+    size_t alloc_bytes = 0;
+};
+
+void run(const std::string& cmd) {
+    if (std::system(cmd.c_str()) != 0) {
+        std::fprintf(stderr, "command failed: %s\n", cmd.c_str());
+        std::exit(1);
+    }
+}
+
+std::string repo_path(size_t i) { return "src/mod" + std::to_string(i % 97) + "/file" + std::to_string(i) + ".cpp"; }
+
+// Source-like text: compressible, but not a single repeated run
+std::string file_content(size_t i, size_t size, unsigned salt) {
+    static const char* const words[] = {"int ", "return ", "value", " = ", "const ", "std::string ", "(i)", ";\n",
+                                        "if ", "for ", "{\n", "}\n", "auto ", "result", "++", "0x7f"};
+    std::string out;
+    out.reserve(size);
+    uint64_t x = i * 0x9e3779b97f4a7c15ULL + salt + 1;
+    while (out.size() < size) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        out += words[x % 16];
+    }
+    out.resize(size);
+    return out;
+}
+
+// Function to create and commit opt.files files, then modify, rename (staged,
+// so status reports them as renames) and delete the requested share of them
+void build_repo(const fs::path& dir, const Options& opt) {
+    fs::create_directories(dir);
+    fs::current_path(dir);
+    run("git init -q . && git config user.email bench@gits && git config user.name bench");
+    for (size_t i = 0; i < opt.files; ++i) {
+        fs::path p = repo_path(i);
+        fs::create_directories(p.parent_path());
+        std::ofstream(p, std::ios::binary) << file_content(i, opt.size, 0);
+    }
+    run("git add -A && git commit -q -m base");
+
+    size_t modified = static_cast<size_t>(opt.files * opt.modify);
+    size_t renamed = static_cast<size_t>(opt.files * opt.rename);
+    size_t deleted = static_cast<size_t>(opt.files * opt.remove);
+    if (modified + renamed + deleted > opt.files) {
+        std::fprintf(stderr, "--modify, --rename and --delete add up to more than 1\n");
+        std::exit(1);
+    }
+    size_t i = 0;
+    for (; i < modified; ++i) {
+        std::ofstream(repo_path(i), std::ios::binary) << file_content(i, opt.size, 1);
+    }
+    for (; i < modified + renamed; ++i) {
+        fs::path from = repo_path(i);
+        fs::rename(from, fs::path(from).replace_extension(".cc"));
+    }
+    if (renamed > 0) run("git add -A src");
+    for (; i < modified + renamed + deleted; ++i) {
+        fs::remove(repo_path(i));
+    }
+}
+
+// Function to run fn opt.iterations times and keep the fastest run
+Result measure(const Options& opt, const std::function<void()>& fn) {
+    Result best;
+    for (int i = 0; i < opt.iterations; ++i) {
+        size_t count = alloc_count.load();
+        size_t bytes = alloc_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || ms < best.ms) {
+            best = {ms, alloc_count.load() - count, alloc_bytes.load() - bytes};
+        }
+    }
+    return best;
+}
+
+void report(const char* stage, const Result& r, double amount, const char* unit) {
+    double rate = r.ms > 0 ? amount / (r.ms / 1000) : 0;
+    std::printf("%-8s %10.1f %12.1f %-7s %10zu %10.1f\n", stage, r.ms, rate, unit, r.allocs, r.alloc_bytes / 1e6);
+}
+
+Options parse_options(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+            std::exit(1);
+        }
+        const char* value = argv[++i];
+        if (arg == "--files") opt.files = std::strtoul(value, nullptr, 10);
+        else if (arg == "--size") opt.size = std::strtoul(value, nullptr, 10);
+        else if (arg == "--modify") opt.modify = std::atof(value);
+        else if (arg == "--rename") opt.rename = std::atof(value);
+        else if (arg == "--delete") opt.remove = std::atof(value);
+        else if (arg == "--stage") opt.stage = value;
+        else if (arg == "--iterations") opt.iterations = std::max(1, std::atoi(value));
+        else {
+            std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+            std::exit(1);
+        }
+    }
+    static const char* const stages[] = {"", "status", "gather", "zip", "base64", "payload", "stream"};
+    if (std::find(std::begin(stages), std::end(stages), opt.stage) == std::end(stages)) {
+        std::fprintf(stderr, "unknown stage %s\n", opt.stage.c_str());
+        std::exit(1);
+    }
+    return opt;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options opt = parse_options(argc, argv);
+    auto wants = [&](const char* stage) { return opt.stage.empty() || opt.stage == stage; };
+
+    fs::path dir = fs::temp_directory_path() / ("gits-bench-" + std::to_string(::getpid()));
+    build_repo(dir / "repo", opt);
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::printf("%zu files of %zu bytes, %s\n\n", opt.files, opt.size, zstd_available() ? "zstd" : "deflate only");
+    std::printf("%-8s %10s %20s %10s %10s\n", "stage", "best ms", "throughput", "allocs", "alloc MB");
+
+    std::vector<StatusEntry> status = repo_status(threads);
+    if (wants("status")) {
+        report("status", measure(opt, [&] { status = repo_status(threads); }), status.size(), "paths/s");
+    }
+
+    FileChanges changes = gather_file_changes(status, {});
+    if (wants("gather")) {
+        report("gather", measure(opt, [&] { changes = gather_file_changes(status, {}); }), status.size(), "paths/s");
+    }
+
+    uintmax_t source_bytes = 0;
+    for (const auto& f : changes.files_to_zip) source_bytes += fs::file_size(f);
+    CodecPolicy policy;
+    std::string zip_file = (dir / "changes.zip").string();
+    if (wants("zip") || wants("base64") || wants("payload")) {
+        Result r = measure(opt, [&] { create_zip(changes, policy, zip_file); });
+        if (wants("zip")) report("zip", r, source_bytes / 1e6, "MB/s");
+    }
+
+    std::string zip_b64;
+    if (wants("base64") || wants("payload")) {
+        Result r = measure(opt, [&] { zip_b64 = base64_encode_file(zip_file); });
+        if (wants("base64")) report("base64", r, fs::file_size(zip_file) / 1e6, "MB/s");
+    }
+
+    // The metadata send_schedule_request carries, as prepare_schedule_request builds it
+    json payload = {
+        {"schedule_time", "2030-01-01T00:00:00Z"},
+        {"repo_url", "https://github.com/example/repo.git"},
+        {"zip_filename", "gits-changes-0.zip"},
+        {"github_username", "bench"},
+        {"github_display_name", "Bench"},
+        {"github_email", "bench@gits"},
+        {"commit_message", "Scheduled commit"},
+        {"user_id", "bench@gits"},
+        {"idempotency_key", std::string(64, '0')}
+    };
+    if (wants("payload")) {
+        std::string body;
+        Result r = measure(opt, [&] {
+            json buffered = payload;
+            buffered["zip_base64"] = zip_b64;
+            body = buffered.dump();
+        });
+        report("payload", r, body.size() / 1e6, "MB/s");
+    }
+
+    if (wants("stream")) {
+        std::string prefix = schedule_stream_prefix(payload.dump());
+        size_t body_bytes = 0;
+        Result r = measure(opt, [&] {
+            ZipStream zip;
+            add_changes_to_zip(changes, policy, zip);
+            PayloadStream body(prefix, zip);
+            std::vector<char> buffer(ZipStream::CHUNK_SIZE);
+            body_bytes = 0;
+            while (size_t n = body.read(buffer.data(), buffer.size())) body_bytes += n;
+        });
+        report("stream", r, body_bytes / 1e6, "MB/s");
+    }
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(dir);
+    return 0;
+}
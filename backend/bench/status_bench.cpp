@@ -0,0 +1,97 @@
+// Scaling benchmark for change detection: porcelain v2 parsing and
+// gather_file_changes (auto and --file mode) over N paths, half changed and
+// half deleted. Time per path should stay flat as N grows.
+//
+// Usage: status_bench [max_paths]   (default 100000)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../file_changes.h"
+#include "../git_repo.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string changed_path(size_t i) { return "src/mod" + std::to_string(i % 97) + "/file " + std::to_string(i) + ".cpp"; }
+std::string deleted_path(size_t i) { return "old/gone -> " + std::to_string(i) + ".txt"; }
+
+// Porcelain v2 -z output for n modified and n deleted files
+std::string synth_status(size_t n) {
+    const std::string fields = " N... 100644 100644 100644 "
+                               "e69de29bb2d1d6434b8b29ae775ad8c2e48c5391 "
+                               "e69de29bb2d1d6434b8b29ae775ad8c2e48c5391 ";
+    std::string out;
+    for (size_t i = 0; i < n; ++i) {
+        out += "1 .M" + fields + changed_path(i) + '\0';
+        out += "1 .D" + fields + deleted_path(i) + '\0';
+    }
+    return out;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    size_t max_paths = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+
+    fs::path dir = fs::temp_directory_path() / ("gits-status-bench-" + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    fs::current_path(dir);
+
+    std::printf("%10s %12s %12s %12s %14s\n", "paths", "parse ms", "auto ms", "--file ms", "ns/path total");
+    size_t created = 0;
+    for (size_t total = 1000; total <= max_paths; total *= 10) {
+        size_t n = total / 2;
+        for (; created < n; ++created) {
+            fs::path p = changed_path(created);
+            fs::create_directories(p.parent_path());
+            std::ofstream(p) << created;
+        }
+        std::string text = synth_status(n);
+
+        auto start = std::chrono::steady_clock::now();
+        StatusParser parser;
+        for (size_t pos = 0; pos < text.size(); pos += 64 * 1024) {
+            parser.feed(text.data() + pos, std::min<size_t>(64 * 1024, text.size() - pos));
+        }
+        double parse_ms = ms_since(start);
+        std::vector<StatusEntry> status = std::move(parser.entries());
+
+        start = std::chrono::steady_clock::now();
+        FileChanges all = gather_file_changes(status, {});
+        double auto_ms = ms_since(start);
+
+        std::vector<std::string> specified;
+        for (size_t i = 0; i < n; ++i) {
+            specified.push_back(changed_path(i));
+            specified.push_back(deleted_path(i));
+        }
+        start = std::chrono::steady_clock::now();
+        FileChanges picked = gather_file_changes(status, specified);
+        double file_ms = ms_since(start);
+
+        if (all.files_to_zip.size() != n || picked.deletes_for_manifest.size() != n) {
+            std::fprintf(stderr, "unexpected result for n=%zu\n", n);
+            return 1;
+        }
+        std::printf("%10zu %12.1f %12.1f %12.1f %14.0f\n", total, parse_ms, auto_ms, file_ms,
+                    (parse_ms + auto_ms + file_ms) * 1e6 / total);
+    }
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(dir);
+    return 0;
+}
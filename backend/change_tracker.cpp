@@ -0,0 +1,252 @@
+#include "change_tracker.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const uint32_t WORKTREE_EVENTS = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                 IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+const uint32_t GIT_DIR_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+
+// Past this many written paths one full scan is cheaper than checking each
+const size_t MAX_DIRTY_PATHS = 10000;
+
+// Size and modification time of a file, to tell our own index refreshes
+// from index writes by git commands
+std::string file_stamp(const std::string& path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return "";
+    return std::to_string(st.st_size) + ":" + std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec);
+}
+
+}  // namespace
+
+ChangeTracker::ChangeTracker() {
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::runtime_error(std::string("inotify_init1: ") + std::strerror(errno));
+    }
+}
+
+ChangeTracker::~ChangeTracker() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool ChangeTracker::add_watch(Repo& repo, const std::string& dir, bool git_dir) {
+    int wd = inotify_add_watch(fd_, (repo.root + dir).c_str(), git_dir ? GIT_DIR_EVENTS : WORKTREE_EVENTS);
+    if (wd < 0) return false;
+    watches_[wd] = Watch{&repo, dir, git_dir};
+    return true;
+}
+
+// Watch dir and every directory below it, except .git and ignored
+// directories such as build/ or node_modules/, whose files status never
+// reports and which would use up the watch limit
+void ChangeTracker::watch_tree(Repo& repo, const std::string& dir) {
+    auto ignored = repo_ignored_dirs(repo.root, dir);
+    if (ignored.count(dir)) return;
+    if (!add_watch(repo, dir, false)) {
+        // Typically fs.inotify.max_user_watches; the repository is scanned in full instead
+        repo.watched = false;
+        return;
+    }
+    std::error_code ec;
+    fs::recursive_directory_iterator it(repo.root + dir, fs::directory_options::skip_permission_denied, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+        if (!it->is_directory(ec) || it->is_symlink(ec)) continue;
+        if (it->path().filename() == ".git") {
+            it.disable_recursion_pending();
+            continue;
+        }
+        std::string rel = fs::path(it->path()).lexically_relative(repo.root).string() + "/";
+        if (ignored.count(rel)) {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (!add_watch(repo, rel, false)) {
+            repo.watched = false;
+            return;
+        }
+    }
+}
+
+// Remove every watch of repo, so it can be registered again
+void ChangeTracker::unwatch_repo(Repo& repo) {
+    for (auto it = watches_.begin(); it != watches_.end();) {
+        if (it->second.repo == &repo) {
+            inotify_rm_watch(fd_, it->first);
+            it = watches_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ChangeTracker::watch_repo(Repo& repo) {
+    repo.watched = true;
+    repo.rewatch = false;
+    watch_tree(repo, "");
+    // A .git file (linked work tree, submodule) points elsewhere; those
+    // repositories are scanned in full every time
+    std::error_code ec;
+    if (!fs::is_directory(repo.root + ".git", ec) || !add_watch(repo, ".git/", true)) {
+        repo.watched = false;
+        return;
+    }
+    // .git/info/exclude adds ignore rules like .gitignore
+    add_watch(repo, ".git/info/", true);
+    fs::recursive_directory_iterator it(repo.root + ".git/refs/heads", ec), end;
+    add_watch(repo, ".git/refs/heads/", true);
+    for (; !ec && it != end; it.increment(ec)) {
+        if (it->is_directory(ec)) {
+            add_watch(repo, fs::path(it->path()).lexically_relative(repo.root).string() + "/", true);
+        }
+    }
+}
+
+void ChangeTracker::handle_event(const Watch& watch, uint32_t mask, const std::string& name) {
+    Repo& repo = *watch.repo;
+    if (watch.git_dir) {
+        if (watch.dir == ".git/") {
+            // Git replaces the index by renaming index.lock over it
+            if (name == "index") {
+                if (file_stamp(repo.root + ".git/index") != repo.index_stamp) repo.stale = true;
+            } else if (name == "HEAD" || name == "packed-refs") {
+                repo.stale = true;
+            }
+        } else {
+            // A branch moved, was created or was deleted, or the excludes changed
+            if ((mask & IN_ISDIR) && (mask & IN_CREATE)) add_watch(repo, watch.dir + name + "/", true);
+            if (watch.dir == ".git/info/") repo.rewatch = true;
+            repo.stale = true;
+        }
+        return;
+    }
+    if (mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        repo.stale = true;
+        return;
+    }
+    if (name.empty() || (watch.dir.empty() && name == ".git")) return;
+    if (mask & IN_ISDIR) {
+        // Whole directories appearing or leaving change many paths at once
+        if (mask & (IN_CREATE | IN_MOVED_TO)) watch_tree(repo, watch.dir + name + "/");
+        repo.stale = true;
+        return;
+    }
+    if (name == ".gitignore") {
+        // Directories may have stopped or started being ignored
+        repo.rewatch = true;
+        repo.stale = true;
+        return;
+    }
+    repo.dirty.insert(watch.dir + name);
+}
+
+void ChangeTracker::drain() {
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t n = ::read(fd_, buffer, sizeof(buffer));
+        if (n <= 0) return;
+        for (char* p = buffer; p < buffer + n;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (auto& kv : repos_) kv.second->stale = true;
+                continue;
+            }
+            auto it = watches_.find(event->wd);
+            if (it == watches_.end()) continue;
+            if (event->mask & IN_IGNORED) {
+                watches_.erase(it);
+                continue;
+            }
+            handle_event(it->second, event->mask, event->len ? event->name : "");
+        }
+    }
+}
+
+void ChangeTracker::full_scan(Repo& repo, unsigned threads) {
+    repo.dirty.clear();
+    repo.entries.clear();
+    for (auto& e : repo_status(threads)) {
+        std::string path = e.path;
+        repo.entries[path] = std::move(e);
+    }
+    repo.stale = false;
+    // git status may have refreshed the index itself
+    repo.index_stamp = file_stamp(repo.root + ".git/index");
+}
+
+// Recheck the written paths against the index, merging the result the way
+// repo_status combines its index and work tree passes. Like a full scan,
+// git status may refresh the index while doing so.
+void ChangeTracker::refresh(Repo& repo) {
+    std::vector<std::string> paths(repo.dirty.begin(), repo.dirty.end());
+    repo.dirty.clear();
+    if (paths.empty()) return;
+
+    std::unordered_map<std::string, StatusEntry> changed;
+    for (auto& e : repo_worktree_status(paths)) {
+        std::string path = e.path;
+        changed[path] = std::move(e);
+    }
+    for (const auto& path : paths) {
+        auto found = changed.find(path);
+        auto it = repo.entries.find(path);
+        StatusEntry e = it != repo.entries.end() ? it->second : StatusEntry{};
+        e.path = path;
+        if (e.index_status == '?') {
+            e.index_status = ' ';
+            e.worktree_status = ' ';
+        }
+        if (found != changed.end() && found->second.index_status == '?') {
+            if (e.index_status == ' ') {
+                e.index_status = '?';
+                e.worktree_status = '?';
+            }
+        } else {
+            e.worktree_status = found != changed.end() ? found->second.worktree_status : ' ';
+        }
+        if (e.index_status == ' ' && e.worktree_status == ' ') {
+            repo.entries.erase(path);
+        } else {
+            repo.entries[path] = e;
+        }
+    }
+    repo.index_stamp = file_stamp(repo.root + ".git/index");
+}
+
+std::vector<StatusEntry> ChangeTracker::status(const std::string& root, unsigned threads) {
+    auto& slot = repos_[root];
+    if (!slot) {
+        slot.reset(new Repo());
+        slot->root = root;
+        watch_repo(*slot);
+    }
+    Repo& repo = *slot;
+    drain();
+    if (repo.rewatch) {
+        unwatch_repo(repo);
+        watch_repo(repo);
+    }
+    if (!repo.watched || repo.stale || repo.dirty.size() > MAX_DIRTY_PATHS) {
+        full_scan(repo, threads);
+    } else {
+        refresh(repo);
+    }
+
+    std::vector<StatusEntry> out;
+    out.reserve(repo.entries.size());
+    for (const auto& kv : repo.entries) out.push_back(kv.second);
+    return out;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "git_repo.h"
+
+// Incremental git status for gitsd. Each registered repository is scanned in
+// full once; after that inotify reports which paths were written, and only
+// those are checked again. A full scan runs again when the index, HEAD or a
+// branch moves, when a directory appears or disappears, when .gitignore
+// changes or when events were lost. Linux only.
+class ChangeTracker {
+public:
+    // Throws std::runtime_error when inotify is not available
+    ChangeTracker();
+    ~ChangeTracker();
+    ChangeTracker(const ChangeTracker&) = delete;
+    ChangeTracker& operator=(const ChangeTracker&) = delete;
+
+    // Descriptor to poll for events; call drain() when it is readable
+    int fd() const { return fd_; }
+
+    // Function to apply every pending event without blocking
+    void drain();
+
+    // Function to get the status of the repository rooted at root, which
+    // must be the current directory's work tree. Registers it on first use.
+    std::vector<StatusEntry> status(const std::string& root, unsigned threads);
+
+    // Function to count the repositories being watched
+    size_t repository_count() const { return repos_.size(); }
+
+private:
+    struct Repo {
+        std::string root;                             // with a trailing slash
+        std::map<std::string, StatusEntry> entries;   // root-relative path -> status
+        std::set<std::string> dirty;                  // root-relative paths written since the last status
+        bool stale = true;                            // needs a full scan
+        bool watched = false;                         // every directory that is not ignored has a watch
+        bool rewatch = false;                         // ignore rules changed: watch again
+        std::string index_stamp;                      // .git/index size and mtime after the last scan
+    };
+
+    // What a watch descriptor covers
+    struct Watch {
+        Repo* repo;
+        std::string dir;  // root-relative, with a trailing slash; empty for the root
+        bool git_dir;     // .git itself, .git/info or .git/refs/heads
+    };
+
+    void watch_repo(Repo& repo);
+    void unwatch_repo(Repo& repo);
+    void watch_tree(Repo& repo, const std::string& dir);
+    bool add_watch(Repo& repo, const std::string& dir, bool git_dir);
+    void handle_event(const Watch& watch, uint32_t mask, const std::string& name);
+    void full_scan(Repo& repo, unsigned threads);
+    void refresh(Repo& repo);
+
+    int fd_ = -1;
+    std::map<std::string, std::unique_ptr<Repo>> repos_;
+    std::map<int, Watch> watches_;
+};
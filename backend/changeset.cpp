@@ -0,0 +1,170 @@
+#include "changeset.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <nlohmann/json.hpp>
+#include <openssl/rand.h>
+
+#include "base64.h"
+#include "gits_error.h"
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+void add_changes_to_zip(const FileChanges& changes, const CodecPolicy& policy, ZipStream& zip) {
+    zip.set_codec_policy(policy);
+    for (const auto& file : changes.files_to_zip) {
+        zip.add_file(file);
+    }
+    json manifest = {{"deleted", changes.deletes_for_manifest}};
+    if (!changes.blobs_for_manifest.empty()) {
+        json blobs = json::array();
+        for (const auto& blob : changes.blobs_for_manifest) {
+            blobs.push_back({{"path", blob.path}, {"sha256", blob.sha256}, {"mode", blob.mode}});
+        }
+        manifest["blobs"] = blobs;
+    }
+    std::string manifest_filename = ".gits-manifest-" + std::to_string(std::time(nullptr)) + ".json";
+    zip.add_buffer(manifest_filename, manifest.dump(4));
+}
+
+std::string create_zip(const FileChanges& changes, const CodecPolicy& policy, const std::string& zip_filename) {
+    std::ofstream out(zip_filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw GitsError(GITS_ERR_IO, "Failed to create zip file.");
+    }
+    ZipStream zip;
+    add_changes_to_zip(changes, policy, zip);
+    std::vector<char> buffer(ZipStream::CHUNK_SIZE);
+    try {
+        size_t n;
+        while ((n = zip.read(buffer.data(), buffer.size())) > 0) {
+            out.write(buffer.data(), n);
+        }
+    } catch (const std::exception& e) {
+        out.close();
+        fs::remove(zip_filename);
+        throw GitsError(GITS_ERR_IO, e.what());
+    }
+    out.close();
+    if (!out) {
+        throw GitsError(GITS_ERR_IO, "Failed to write zip file.");
+    }
+    return zip_filename;
+}
+
+std::string base64_encode_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        throw GitsError(GITS_ERR_IO, "Cannot open file for base64 encoding.");
+    }
+    std::vector<char> buffer(std::istreambuf_iterator<char>(file), {});
+    file.close();
+    std::string encoded(base64_encoded_size(buffer.size()), '\0');
+    base64_encode(reinterpret_cast<const unsigned char*>(buffer.data()), buffer.size(), &encoded[0]);
+    return encoded;
+}
+
+std::string base64_encode_string(const std::string& input) {
+    std::string encoded(base64_encoded_size(input.size()), '\0');
+    base64_encode(reinterpret_cast<const unsigned char*>(input.data()), input.size(), &encoded[0]);
+    return encoded;
+}
+
+std::string schedule_stream_prefix(std::string payload_json) {
+    payload_json.pop_back();
+    payload_json += ",\"zip_base64\":\"";
+    return payload_json;
+}
+
+std::string multipart_boundary() {
+    unsigned char bytes[16];
+    if (RAND_bytes(bytes, sizeof(bytes)) != 1) {
+        throw GitsError(GITS_ERR_INTERNAL, "Failed to generate a multipart boundary");
+    }
+    static const char hex[] = "0123456789abcdef";
+    std::string boundary = "gits-";
+    for (unsigned char b : bytes) {
+        boundary += hex[b >> 4];
+        boundary += hex[b & 15];
+    }
+    return boundary;
+}
+
+std::string multipart_prefix(const std::string& boundary, const std::string& payload_json, const std::string& filename) {
+    return "--" + boundary + "\r\n"
+           "Content-Disposition: form-data; name=\"payload\"\r\n"
+           "Content-Type: application/json\r\n\r\n" +
+           payload_json + "\r\n"
+           "--" + boundary + "\r\n"
+           "Content-Disposition: form-data; name=\"changes\"; filename=\"" + filename + "\"\r\n"
+           "Content-Type: application/octet-stream\r\n\r\n";
+}
+
+std::string multipart_suffix(const std::string& boundary) {
+    return "\r\n--" + boundary + "--\r\n";
+}
+
+PayloadStream::PayloadStream(std::string prefix, ZipStream& zip)
+    : PayloadStream(std::move(prefix), zip, "\"}", true) {}
+
+PayloadStream::PayloadStream(std::string prefix, ZipStream& zip, std::string suffix, bool encode)
+    : prefix(std::move(prefix)), zip(zip), suffix(std::move(suffix)), encode(encode), raw(ZipStream::CHUNK_SIZE / 3 * 3) {}
+
+size_t PayloadStream::read(char* out, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        if (pos == pending.size()) {
+            if (stage == Stage::Done) break;
+            refill();
+            continue;
+        }
+        size_t n = std::min(len - written, pending.size() - pos);
+        std::copy(pending.begin() + pos, pending.begin() + pos + n, out + written);
+        pos += n;
+        written += n;
+    }
+    return written;
+}
+
+void PayloadStream::refill() {
+    pending.clear();
+    pos = 0;
+    switch (stage) {
+        case Stage::Prefix:
+            pending = prefix;
+            stage = Stage::Body;
+            break;
+        case Stage::Body: {
+            if (!encode) {
+                pending.resize(raw.size());
+                pending.resize(zip.read(&pending[0], pending.size()));
+                if (pending.empty()) stage = Stage::Suffix;
+                break;
+            }
+            // Only whole 3-byte groups are encoded until the zip runs dry,
+            // so no padding appears mid-stream
+            size_t n = carry + zip.read(reinterpret_cast<char*>(raw.data()) + carry, raw.size() - carry);
+            bool last = n < raw.size();
+            size_t full = last ? n : n / 3 * 3;
+            pending.resize(base64_encoded_size(full));
+            base64_encode(raw.data(), full, &pending[0]);
+            carry = n - full;
+            std::copy(raw.begin() + full, raw.begin() + n, raw.begin());
+            if (last) stage = Stage::Suffix;
+            break;
+        }
+        case Stage::Suffix:
+            pending = suffix;
+            stage = Stage::Done;
+            break;
+        case Stage::Done:
+            break;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "codec.h"
+#include "file_changes.h"
+#include "zip_stream.h"
+
+// The stages that turn gathered changes into a schedule request body. They
+// live apart from main() so bench/gits_bench can run and time each one alone.
+
+// Function to queue changed files and the deletion manifest into a zip stream
+void add_changes_to_zip(const FileChanges& changes, const CodecPolicy& policy, ZipStream& zip);
+
+// Function to create zip file
+std::string create_zip(const FileChanges& changes, const CodecPolicy& policy, const std::string& zip_filename);
+
+// Function to base64 encode file
+std::string base64_encode_file(const std::string& filename);
+
+// Function to base64 encode a string
+std::string base64_encode_string(const std::string& input);
+
+// Function to turn a serialized payload object into the start of a streamed
+// schedule body, open at the zip_base64 value
+std::string schedule_stream_prefix(std::string payload_json);
+
+// Function to make a multipart/form-data boundary that will not occur in the archive
+std::string multipart_boundary();
+
+// Function to open a multipart schedule body: the payload part (JSON
+// metadata), then the headers of the changes part holding the raw archive
+std::string multipart_prefix(const std::string& boundary, const std::string& payload_json, const std::string& filename);
+
+// Function to close a multipart schedule body after the archive bytes
+std::string multipart_suffix(const std::string& boundary);
+
+// Class streaming a schedule body: the prefix, then the zip (base64 for a
+// JSON body, raw for a multipart one), then the suffix
+class PayloadStream {
+    public:
+        // The JSON body: the zip base64-encoded into the zip_base64 value
+        PayloadStream(std::string prefix, ZipStream& zip);
+        PayloadStream(std::string prefix, ZipStream& zip, std::string suffix, bool encode);
+
+        size_t read(char* out, size_t len);
+
+        std::string error;
+
+    private:
+        enum class Stage { Prefix, Body, Suffix, Done };
+
+        void refill();
+
+        std::string prefix;
+        ZipStream& zip;
+        std::string suffix;
+        bool encode;
+        std::vector<unsigned char> raw;
+        size_t carry = 0;
+        std::string pending;
+        size_t pos = 0;
+        Stage stage = Stage::Prefix;
+};
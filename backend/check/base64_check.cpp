@@ -0,0 +1,139 @@
+// Correctness of the shared base64 codec (../common/base64.cpp) in each
+// implementation the CPU supports: encoding matches OpenSSL's block encoder,
+// decoding (into a separate buffer and in place) gives the bytes back, and
+// input that is not padded base64 is rejected exactly as the scalar loop
+// rejects it. Run by test/e2e/test_codec.py; exits 1 on any mismatch.
+//
+// Usage: base64_check [seed]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <openssl/evp.h>
+
+#include "base64.h"
+
+namespace {
+
+const Base64Impl IMPLS[] = {Base64Impl::Scalar, Base64Impl::Ssse3, Base64Impl::Avx2};
+
+// Characters outside the alphabet, '=' included (it is only valid as padding)
+const char INVALID[] = {'=', '-', '_', '.', ' ', '\n', '\0', '\x7f', '\x80', '\xff'};
+
+int failures = 0;
+
+void fail(Base64Impl impl, const char* what, size_t n) {
+    std::fprintf(stderr, "%s: %s (length %zu)\n", base64_name(impl), what, n);
+    ++failures;
+}
+
+std::string openssl_encode(const std::vector<unsigned char>& raw) {
+    std::string out(base64_encoded_size(raw.size()) + 1, '\0');
+    int n = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(&out[0]), raw.data(), static_cast<int>(raw.size()));
+    out.resize(n);
+    return out;
+}
+
+// Result of decoding text with impl: accepted or not, and the bytes
+struct Decoded {
+    bool ok = false;
+    std::vector<unsigned char> bytes;
+};
+
+Decoded decode(Base64Impl impl, const std::string& text) {
+    base64_use(impl);
+    Decoded d;
+    d.bytes.resize(base64_decoded_max_size(text.size()));
+    size_t n = 0;
+    d.ok = base64_decode(text.data(), text.size(), d.bytes.data(), n);
+    d.bytes.resize(d.ok ? n : 0);
+    return d;
+}
+
+// Encodes and decodes raw with impl, checking against OpenSSL
+void check_round_trip(Base64Impl impl, const std::vector<unsigned char>& raw) {
+    std::string expected = openssl_encode(raw);
+    base64_use(impl);
+    std::string text(base64_encoded_size(raw.size()), '\0');
+    size_t written = base64_encode(raw.data(), raw.size(), &text[0]);
+    if (written != text.size() || text != expected) fail(impl, "encoding differs from OpenSSL", raw.size());
+
+    Decoded d = decode(impl, expected);
+    if (!d.ok || d.bytes != raw) fail(impl, "decoding does not give the bytes back", raw.size());
+
+    std::string in_place = expected;
+    unsigned char* buffer = reinterpret_cast<unsigned char*>(&in_place[0]);
+    size_t n = 0;
+    if (!base64_decode(in_place.data(), in_place.size(), buffer, n) || n != raw.size() || std::memcmp(buffer, raw.data(), n) != 0) {
+        fail(impl, "decoding in place does not give the bytes back", raw.size());
+    }
+}
+
+// Decodes text with impl and with the scalar loop; both must reject it
+void check_rejected(Base64Impl impl, const std::string& text, const char* what) {
+    if (decode(Base64Impl::Scalar, text).ok) fail(Base64Impl::Scalar, what, text.size());
+    if (decode(impl, text).ok) fail(impl, what, text.size());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    unsigned seed = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : std::random_device()();
+    std::mt19937 rng(seed);
+    auto random_bytes = [&](size_t n) {
+        std::vector<unsigned char> raw(n);
+        for (auto& b : raw) b = static_cast<unsigned char>(rng());
+        return raw;
+    };
+
+    for (Base64Impl impl : IMPLS) {
+        if (!base64_use(impl)) {
+            std::printf("%-8s skipped (not supported by this CPU)\n", base64_name(impl));
+            continue;
+        }
+
+        // Every length across several vector blocks and the scalar tails, then random ones
+        for (size_t n = 0; n <= 300; ++n) check_round_trip(impl, random_bytes(n));
+        for (int i = 0; i < 200; ++i) check_round_trip(impl, random_bytes(rng() % 100000));
+
+        // One invalid character at each position, in and out of the vector loop
+        for (size_t n : {1, 2, 3, 24, 47, 48, 95, 96, 100, 151}) {
+            std::string text = openssl_encode(random_bytes(n));
+            for (size_t pos = 0; pos < text.size(); ++pos) {
+                for (char c : INVALID) {
+                    // '=' in the last two places can be valid padding
+                    if (c == '=' && pos + 2 >= text.size()) continue;
+                    std::string bad = text;
+                    bad[pos] = c;
+                    if (decode(impl, bad).ok) fail(impl, "invalid character accepted", n);
+                }
+            }
+        }
+
+        // Bad padding and lengths that are not a multiple of 4
+        std::string body = openssl_encode(random_bytes(96));
+        for (const char* tail : {"A===", "====", "AB=C", "A=BC", "=ABC", "AB=", "ABC", "A"}) {
+            check_rejected(impl, body + tail, "bad padding accepted");
+        }
+        check_rejected(impl, body.substr(0, 8) + "AB==" + body, "padding before the end accepted");
+        check_rejected(impl, body + "AB==" + body.substr(0, 4), "padding before the end accepted");
+
+        // Decoding agrees with the scalar loop on random input, valid or not
+        const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=-";
+        for (int i = 0; i < 2000; ++i) {
+            std::string text(4 * (rng() % 40), '\0');
+            for (auto& c : text) c = chars[rng() % (sizeof(chars) - 1)];
+            Decoded expected = decode(Base64Impl::Scalar, text), actual = decode(impl, text);
+            if (expected.ok != actual.ok || expected.bytes != actual.bytes) fail(impl, "differs from scalar", text.size());
+        }
+
+        std::printf("%-8s ok\n", base64_name(impl));
+    }
+
+    if (failures) std::fprintf(stderr, "%d failure(s), seed %u\n", failures, seed);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+#include "codec.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <zlib.h>
+
+#ifdef GITS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+const size_t OUT_CHUNK = 64 * 1024;
+const size_t ENTROPY_MIN_SAMPLE = 512;
+const double ENTROPY_STORE_THRESHOLD = 7.5;  // bits per byte
+
+// Signatures of formats that are compressed already
+bool has_compressed_magic(const unsigned char* p, size_t len) {
+    auto starts = [&](const char* magic, size_t n, size_t at = 0) {
+        return len >= at + n && std::memcmp(p + at, magic, n) == 0;
+    };
+    return starts("\x89PNG\r\n\x1a\n", 8) ||
+           starts("\xFF\xD8\xFF", 3) ||             // JPEG
+           starts("GIF8", 4) ||
+           (starts("RIFF", 4) && starts("WEBP", 4, 8)) ||
+           starts("wOF2", 4) || starts("wOFF", 4) ||
+           starts("OggS", 4) || starts("fLaC", 4) || starts("ID3", 3) ||
+           starts("ftyp", 4, 4) ||                  // MP4, MOV, HEIC
+           starts("PK\x03\x04", 4) ||               // zip, jar, apk, docx
+           starts("\x1F\x8B", 2) ||                 // gzip, .tgz
+           starts("BZh", 3) ||
+           starts("\xFD" "7zXZ\x00", 6) ||
+           starts("\x28\xB5\x2F\xFD", 4) ||         // zstd
+           starts("\x04\x22\x4D\x18", 4) ||         // lz4
+           starts("7z\xBC\xAF\x27\x1C", 6) ||
+           starts("Rar!\x1A\x07", 6);
+}
+
+double shannon_entropy(const unsigned char* p, size_t len) {
+    size_t counts[256] = {};
+    for (size_t i = 0; i < len; ++i) counts[p[i]]++;
+    double bits = 0;
+    for (size_t c : counts) {
+        if (c == 0) continue;
+        double f = static_cast<double>(c) / len;
+        bits -= f * std::log2(f);
+    }
+    return bits;
+}
+
+class StoreCompressor : public Compressor {
+public:
+    void update(const unsigned char* in, size_t len, bool, std::string& out) override {
+        out.append(reinterpret_cast<const char*>(in), len);
+    }
+};
+
+class DeflateCompressor : public Compressor {
+public:
+    DeflateCompressor() : buf_(OUT_CHUNK) {
+        if (deflateInit2(&zs_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("Failed to initialize deflate");
+        }
+    }
+    ~DeflateCompressor() override { deflateEnd(&zs_); }
+
+    void update(const unsigned char* in, size_t len, bool finish, std::string& out) override {
+        zs_.next_in = const_cast<unsigned char*>(in);
+        zs_.avail_in = static_cast<uInt>(len);
+        int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+        do {
+            zs_.next_out = buf_.data();
+            zs_.avail_out = static_cast<uInt>(buf_.size());
+            if (deflate(&zs_, flush) == Z_STREAM_ERROR) {
+                throw std::runtime_error("deflate failed");
+            }
+            out.append(reinterpret_cast<const char*>(buf_.data()), buf_.size() - zs_.avail_out);
+        } while (zs_.avail_out == 0);
+    }
+
+private:
+    z_stream zs_{};
+    std::vector<unsigned char> buf_;
+};
+
+}  // namespace
+
+#ifdef GITS_HAVE_ZSTD
+
+// Dictionary digested once and shared read-only by all compressing threads
+struct ZstdDictionary {
+    ZSTD_CDict* cdict = nullptr;
+    ~ZstdDictionary() { ZSTD_freeCDict(cdict); }
+};
+
+namespace {
+
+class ZstdCompressor : public Compressor {
+public:
+    explicit ZstdCompressor(const CodecPolicy& policy) : cctx_(ZSTD_createCCtx()), buf_(OUT_CHUNK) {
+        if (!cctx_) throw std::runtime_error("Failed to initialize zstd");
+        if (policy.zstd_prepared) {
+            ZSTD_CCtx_refCDict(cctx_, policy.zstd_prepared->cdict);
+        } else {
+            ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, policy.zstd_level);
+        }
+    }
+    ~ZstdCompressor() override { ZSTD_freeCCtx(cctx_); }
+
+    void update(const unsigned char* in, size_t len, bool finish, std::string& out) override {
+        ZSTD_inBuffer input = {in, len, 0};
+        ZSTD_EndDirective mode = finish ? ZSTD_e_end : ZSTD_e_continue;
+        for (;;) {
+            ZSTD_outBuffer output = {buf_.data(), buf_.size(), 0};
+            size_t remaining = ZSTD_compressStream2(cctx_, &output, &input, mode);
+            if (ZSTD_isError(remaining)) {
+                throw std::runtime_error(std::string("zstd failed: ") + ZSTD_getErrorName(remaining));
+            }
+            out.append(buf_.data(), output.pos);
+            if (finish ? remaining == 0 : input.pos == input.size) break;
+        }
+    }
+
+private:
+    ZSTD_CCtx* cctx_;
+    std::vector<char> buf_;
+};
+
+}  // namespace
+
+bool zstd_available() { return true; }
+
+void load_zstd_dictionary(CodecPolicy& policy, std::string bytes) {
+    auto dict = std::make_shared<ZstdDictionary>();
+    dict->cdict = ZSTD_createCDict(bytes.data(), bytes.size(), policy.zstd_level);
+    if (!dict->cdict) {
+        throw std::runtime_error("zstd could not load the dictionary");
+    }
+    policy.zstd_dictionary = std::move(bytes);
+    policy.zstd_prepared = dict;
+}
+
+#else
+
+struct ZstdDictionary {};
+
+bool zstd_available() { return false; }
+
+void load_zstd_dictionary(CodecPolicy&, std::string) {
+    throw std::runtime_error("this build of gits has no zstd support");
+}
+
+#endif
+
+Codec choose_codec(const CodecPolicy& policy, const unsigned char* sample, size_t len) {
+    if (policy.mode == "store") return Codec::Store;
+    if (has_compressed_magic(sample, len)) return Codec::Store;
+    if (len >= ENTROPY_MIN_SAMPLE && shannon_entropy(sample, len) > ENTROPY_STORE_THRESHOLD) {
+        return Codec::Store;
+    }
+    if (policy.mode == "deflate") return Codec::Deflate;
+    if (policy.mode == "zstd" || zstd_available()) return Codec::Zstd;
+    return Codec::Deflate;
+}
+
+std::unique_ptr<Compressor> make_compressor(Codec codec, const CodecPolicy& policy) {
+    switch (codec) {
+        case Codec::Store:
+            return std::unique_ptr<Compressor>(new StoreCompressor());
+        case Codec::Deflate:
+            return std::unique_ptr<Compressor>(new DeflateCompressor());
+        case Codec::Zstd:
+#ifdef GITS_HAVE_ZSTD
+            return std::unique_ptr<Compressor>(new ZstdCompressor(policy));
+#else
+            break;
+#endif
+    }
+    (void)policy;
+    throw std::runtime_error("Unsupported compression method");
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Compression methods the archive writer can use (values are ZIP method ids)
+enum class Codec : uint16_t { Store = 0, Deflate = 8, Zstd = 93 };
+
+// Archive entry carrying the zstd dictionary, stored uncompressed
+const char* const ZSTD_DICTIONARY_ENTRY = ".gits-zstd-dict";
+
+struct ZstdDictionary;
+
+// Struct for the per-file codec policy (ZIP_CODEC, ZSTD_LEVEL, ZSTD_DICT)
+struct CodecPolicy {
+    // auto: zstd when built in, else deflate; zstd/deflate: force that codec;
+    // store: no compression. All but store keep compressed content as-is.
+    std::string mode = "auto";
+    int zstd_level = 3;
+    std::string zstd_dictionary;  // raw dictionary bytes, empty for none
+    std::shared_ptr<const ZstdDictionary> zstd_prepared;
+};
+
+// Function to check whether this build can write zstd entries
+bool zstd_available();
+
+// Function to attach a dictionary (e.g. from `zstd --train`) to a policy;
+// throws std::runtime_error if zstd rejects it
+void load_zstd_dictionary(CodecPolicy& policy, std::string bytes);
+
+// Function to pick a codec for a file from a sample of its leading bytes
+Codec choose_codec(const CodecPolicy& policy, const unsigned char* sample, size_t len);
+
+// Incremental compressor producing a raw ZIP entry body
+class Compressor {
+public:
+    virtual ~Compressor() = default;
+    // Compress len bytes, appending output to out; finish ends the stream.
+    // Throws std::runtime_error on failure.
+    virtual void update(const unsigned char* in, size_t len, bool finish, std::string& out) = 0;
+};
+
+std::unique_ptr<Compressor> make_compressor(Codec codec, const CodecPolicy& policy);
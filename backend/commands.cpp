@@ -0,0 +1,1545 @@
+#include "commands.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <regex>
+#include <chrono>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <exception>
+#include <mutex>
+
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+#include <openssl/evp.h>
+
+#include "base64.h"
+#include "changeset.h"
+#include "codec.h"
+#include "file_changes.h"
+#include "git_repo.h"
+#include "http_client.h"
+#include "multipart_upload.h"
+#include "trace.h"
+#include "zip_stream.h"
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+// Function to trim whitespace from string
+std::string trim(const std::string& str) {
+    /*
+    // another implementation
+    path.erase(path.begin(), std::find_if(path.begin(), path.end(), [](unsigned char ch) { return !std::isspace(ch); }));
+    path.erase(std::find_if(path.rbegin(), path.rend(), [](unsigned char ch) { return !std::isspace(ch); }).base(), path.end());
+    */
+    auto start = std::find_if(str.begin(), str.end(), [](unsigned char ch) { return !std::isspace(ch); });
+    auto end = std::find_if(str.rbegin(), str.rend(), [](unsigned char ch) { return !std::isspace(ch); }).base();
+    return (start < end) ? std::string(start, end) : std::string();
+}
+
+// Function to build a message from streamable parts
+template <typename... Parts>
+std::string text(const Parts&... parts) {
+    std::ostringstream out;
+    (out << ... << parts);
+    return out.str();
+}
+
+// Class restoring the working directory when it goes out of scope
+class WorkingDirectory {
+public:
+    WorkingDirectory() : path_(fs::current_path()) {}
+    ~WorkingDirectory() {
+        std::error_code ec;
+        fs::current_path(path_, ec);
+    }
+
+private:
+    fs::path path_;
+};
+
+// Class deleting a temporary file when it goes out of scope
+class TemporaryFile {
+public:
+    explicit TemporaryFile(std::string path) : path_(std::move(path)) {}
+    ~TemporaryFile() {
+        std::error_code ec;
+        fs::remove(path_, ec);
+    }
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// Schedules work inside their repository's directory, which is shared by the
+// whole process, so they run one at a time
+std::mutex schedule_mutex;
+
+// Informational lines go to stdout, warnings to stderr, until a handler is installed
+std::function<void(const std::string&)> notice_handler = [](const std::string& line) { std::cout << line << std::endl; };
+bool notice_console = true;
+
+void notice(const std::string& line) {
+    if (notice_handler) notice_handler(line);
+}
+
+void warning(const std::string& line) {
+    if (notice_console) std::cerr << line << std::endl;
+    else if (notice_handler) notice_handler(line);
+}
+
+void set_notice_handler(std::function<void(const std::string&)> handler) {
+    notice_handler = std::move(handler);
+    notice_console = false;
+}
+
+bool notices_on_console() {
+    return notice_console;
+}
+
+// Function to get ~/.gits; without HOME (services, some CI runners) a gits
+// directory under the temp directory stands in
+fs::path gits_dir() {
+    const char* home = std::getenv("HOME");
+    return home && *home ? fs::path(home) / ".gits" : fs::temp_directory_path() / "gits";
+}
+
+Config load_config(const std::string& path) {
+    Config config;
+    fs::path config_path = !path.empty() ? fs::path(path) : gits_dir() / "config";
+    if (fs::exists(config_path)) {
+        std::ifstream config_file(config_path);
+        std::string line;
+        while (std::getline(config_file, line)) {
+            // Simple key=value parsing, ignore comments or empty lines
+            if (line.empty() || line[0] == '#') continue;
+            size_t eq_pos = line.find('=');
+            if (eq_pos != std::string::npos) {
+                std::string key = trim(line.substr(0, eq_pos));
+                std::string value_part = line.substr(eq_pos + 1);
+                std::string value;
+                if (!value_part.empty() && value_part[0] == '"') {
+                    value = value_part.substr(1);
+                    bool in_quote = true;
+                    while (in_quote && std::getline(config_file, line)) {
+                        size_t quote_pos = line.find('"');
+                        if (quote_pos != std::string::npos) {
+                            value += line.substr(0, quote_pos);
+                            in_quote = false;
+                        } else {
+                            value += line + "\n";
+                        }
+                    }
+                    if (in_quote) {
+                        std::cerr << "Error: Unclosed quote in config for key: " << key << std::endl;
+                        continue;
+                    }
+                } else {
+                    value = trim(value_part);
+                }
+                config[key] = value;
+            }
+        }
+    }
+    return config;
+}
+
+// Callback for libcurl to write response
+size_t write_callback(void* contents, size_t size, size_t nmemb, std::string* response) {
+    size_t total_size = size * nmemb;
+    response->append((char*)contents, total_size);
+    return total_size;
+}
+
+// Function to get a required setting, naming it when it is missing
+std::string require_setting(const Config& config, const char* key) {
+    auto it = config.find(key);
+    if (it == config.end() || it->second.empty()) {
+        throw GitsError(GITS_ERR_CONFIG, std::string(key) + " not set in ~/.gits/config");
+    }
+    return it->second;
+}
+
+// Function to get a curl handle from the shared pool
+CURL* easy_handle() {
+    CURL* curl = http_easy();
+    if (!curl) {
+        throw GitsError(GITS_ERR_INTERNAL, "Failed to initialize curl");
+    }
+    return curl;
+}
+
+// Long-poll waits stay below API Gateway's 29 s integration timeout. Backends
+// that answer at once are not asked more often than the minimum interval.
+const int WATCH_WAIT_SECONDS = 20;
+const std::chrono::seconds WATCH_MIN_INTERVAL(1);
+
+// Status answers are kept in ~/.gits/status-cache: the URL they belong to, the
+// ETag, the body, when it was fetched and for how many seconds it stays fresh.
+fs::path status_cache_path() {
+    return gits_dir() / "status-cache";
+}
+
+// Function to load the cached status answer for a URL, or an empty object
+json load_status_cache(const std::string& url) {
+    std::ifstream in(status_cache_path());
+    if (!in) return json::object();
+    json cache = json::parse(in, nullptr, false);
+    if (cache.is_discarded() || !cache.is_object() || cache.value("url", "") != url) return json::object();
+    return cache;
+}
+
+void save_status_cache(const json& cache) {
+    fs::path path = status_cache_path();
+    fs::path tmp = path.string() + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) return;
+        out << cache.dump();
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+}
+
+// Function to read max-age from a Cache-Control header, or -1 without one
+long long cache_max_age(CURL* curl) {
+    struct curl_header* header = nullptr;
+    if (curl_easy_header(curl, "Cache-Control", 0, CURLH_HEADER, -1, &header) != CURLHE_OK) return -1;
+    std::smatch match;
+    std::string value = header->value;
+    if (!std::regex_search(value, match, std::regex("max-age=(\\d+)"))) return -1;
+    return std::stoll(match[1]);
+}
+
+// Struct for one answer of the status endpoint
+struct StatusResponse {
+    CURLcode res = CURLE_OK;
+    long http_code = 0;
+    std::string body;
+    std::string etag;
+    long long max_age = -1;
+};
+
+// Function to GET a status URL, revalidating etag when one is given
+StatusResponse fetch_status(const std::string& url, const std::string& api_key, const std::string& etag) {
+    CURL* curl = easy_handle();
+    StatusResponse response;
+    struct curl_slist* headers = nullptr;
+    std::string api_key_header = "x-api-key: " + api_key;
+    headers = curl_slist_append(headers, api_key_header.c_str());
+    std::string if_none_match_header = "If-None-Match: " + etag;
+    if (!etag.empty()) {
+        headers = curl_slist_append(headers, if_none_match_header.c_str());
+    }
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response.body);
+    for (int attempt = 0;; ++attempt) {
+        response.body.clear();
+        response.res = http_perform(curl);
+        if (!http_retry(curl, response.res, attempt)) break;
+    }
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.http_code);
+    response.max_age = cache_max_age(curl);
+    struct curl_header* etag_header = nullptr;
+    if (curl_easy_header(curl, "ETag", 0, CURLH_HEADER, -1, &etag_header) == CURLHE_OK) {
+        response.etag = etag_header->value;
+    }
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+    return response;
+}
+
+// Function to fail on a status answer other than the expected ones, passing
+// on the backend's message
+void check_status_response(const StatusResponse& response, long accepted = 200) {
+    if (response.res != CURLE_OK) {
+        throw GitsError(GITS_ERR_NETWORK, std::string("Status request failed: ") + curl_easy_strerror(response.res));
+    }
+    if (response.http_code != 200 && response.http_code != accepted) {
+        throw GitsError(GITS_ERR_HTTP, response.body);
+    }
+}
+
+// Function to read one job record
+JobStatus parse_job(const json& j) {
+    JobStatus job;
+    job.job_id = j.value("job_id", "");
+    job.schedule_time = j.value("schedule_time", "");
+    job.status = j.value("status", "");
+    job.json = j.dump();
+    return job;
+}
+
+JobStatus parse_job(const std::string& body) {
+    json j = json::parse(body, nullptr, false);
+    if (j.is_discarded() || !j.is_object()) {
+        throw GitsError(GITS_ERR_PROTOCOL, "Could not parse the status response");
+    }
+    return parse_job(j);
+}
+
+// Build statuses after which a job's status no longer changes
+bool is_final_status(const std::string& status) {
+    return status == "SUCCEEDED" || status == "FAILED" || status == "FAULT" || status == "STOPPED" || status == "TIMED_OUT";
+}
+
+// Function to build the status URL from the config
+std::string status_url(const Config& config) {
+    std::string api_url = require_setting(config, "API_GATEWAY_URL");
+    std::string user_id = require_setting(config, "GITHUB_EMAIL");
+    return api_url + "/status?user_id=" + user_id;
+}
+
+JobStatus watch_job_status(const Config& config, const std::function<void(const JobStatus&)>& on_change) {
+    std::string wait_url = status_url(config) + "&wait=" + std::to_string(WATCH_WAIT_SECONDS);
+    std::string api_key = require_setting(config, "API_KEY");
+    std::string etag;
+    JobStatus last;
+    bool seen = false;
+    for (;;) {
+        http_retry_restart();
+        auto started = std::chrono::steady_clock::now();
+        StatusResponse response = fetch_status(wait_url, api_key, etag);
+        check_status_response(response, 304);
+        if (response.http_code == 200) {
+            etag = response.etag;
+            JobStatus job = parse_job(response.body);
+            if (!seen || job.job_id != last.job_id || job.status != last.status) {
+                on_change(job);
+                seen = true;
+            }
+            last = job;
+            if (is_final_status(job.status)) {
+                return job;
+            }
+        }
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        if (elapsed < WATCH_MIN_INTERVAL) {
+            std::this_thread::sleep_for(WATCH_MIN_INTERVAL - elapsed);
+        }
+    }
+}
+
+// Function to append an escaped query parameter to a URL
+void add_query_param(std::string& url, const char* name, const std::string& value) {
+    char* escaped = curl_easy_escape(nullptr, value.c_str(), static_cast<int>(value.size()));
+    url += std::string("&") + name + "=" + escaped;
+    curl_free(escaped);
+}
+
+void list_jobs(const Config& config, const JobFilter& filter, const std::function<void(const JobStatus&)>& on_job) {
+    std::string url = status_url(config) + "&all=1";
+    std::string api_key = require_setting(config, "API_KEY");
+    if (!filter.status.empty()) add_query_param(url, "status", filter.status);
+    if (!filter.since.empty()) add_query_param(url, "since", filter.since);
+    if (!filter.until.empty()) add_query_param(url, "until", filter.until);
+    std::string cursor;
+    do {
+        std::string page_url = url;
+        if (!cursor.empty()) add_query_param(page_url, "cursor", cursor);
+        http_retry_restart();
+        StatusResponse response = fetch_status(page_url, api_key, "");
+        check_status_response(response);
+        json page = json::parse(response.body, nullptr, false);
+        if (page.is_discarded() || !page.contains("jobs")) {
+            throw GitsError(GITS_ERR_PROTOCOL, "The status endpoint does not list jobs; redeploy status_lambda");
+        }
+        for (const auto& job : page["jobs"]) {
+            on_job(parse_job(job));
+        }
+        cursor = page.value("next_cursor", "");
+    } while (!cursor.empty());
+}
+
+JobStatus latest_job_status(const Config& config) {
+    std::string url = status_url(config);
+    std::string api_key = require_setting(config, "API_KEY");
+    long long max_age_override = -1;
+    auto max_age_it = config.find("STATUS_MAX_AGE");
+    if (max_age_it != config.end() && !max_age_it->second.empty()) {
+        try {
+            max_age_override = std::stoll(max_age_it->second);
+        } catch (const std::exception&) {
+            throw GitsError(GITS_ERR_CONFIG, "STATUS_MAX_AGE must be a number of seconds");
+        }
+    }
+
+    json cache = load_status_cache(url);
+    long long now = std::time(nullptr);
+    long long fresh_for = max_age_override >= 0 ? max_age_override : cache.value("max_age", 0LL);
+    if (cache.contains("body") && now < cache.value("fetched_at", 0LL) + fresh_for) {
+        return parse_job(cache["body"].get<std::string>());
+    }
+
+    std::string etag = cache.contains("body") ? cache.value("etag", "") : "";
+    StatusResponse response = fetch_status(url, api_key, etag);
+    if (response.http_code == 304) {
+        response.body = cache["body"].get<std::string>();
+    } else {
+        check_status_response(response);
+        if (!response.etag.empty()) {
+            cache = {{"url", url}, {"etag", response.etag}, {"body", response.body}};
+        }
+    }
+    if (cache.contains("body")) {
+        cache["fetched_at"] = now;
+        cache["max_age"] = std::max(0LL, max_age_override >= 0 ? max_age_override : response.max_age);
+        save_status_cache(cache);
+    }
+    return parse_job(response.body);
+}
+
+void delete_job(const Config& config, const std::string& job_id) {
+    std::string url = require_setting(config, "API_GATEWAY_URL") + "/delete";
+    std::string user_id = require_setting(config, "GITHUB_EMAIL");
+    std::string api_key = require_setting(config, "API_KEY");
+    json payload = {
+        {"job_id", job_id},
+        {"user_id", user_id}
+    };
+    std::string payload_str = payload.dump();
+
+    CURL* curl = easy_handle();
+    std::string response;
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    std::string api_key_header = "x-api-key: " + api_key;
+    headers = curl_slist_append(headers, api_key_header.c_str());
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload_str.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    CURLcode res = http_perform(curl);
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+    if (res != CURLE_OK || http_code != 200) {
+        throw GitsError(res != CURLE_OK ? GITS_ERR_NETWORK : GITS_ERR_HTTP,
+                        "Delete failed (status " + std::to_string(http_code) + "). Response: " + response);
+    }
+}
+
+void local_to_utc(std::string& time_str, time_t& local_time) {
+    std::regex time_regex(R"(^\d{4}-\d{2}-\d{2}T\d{2}:\d{2}$)");
+    if (!std::regex_match(time_str, time_regex)) {
+        throw GitsError(GITS_ERR_INVALID, "Time must be in format: YYYY-MM-DDTHH:MM (local time, e.g. 2025-07-17T15:00)");
+    }
+    std::tm tm = {};
+    std::istringstream ss(time_str);
+    ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M");
+    if (ss.fail()) {
+        throw GitsError(GITS_ERR_INVALID, "Invalid time format.");
+    }
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;  // Let mktime determine DST
+    local_time = mktime(&tm);
+    if (local_time == -1) {
+        throw GitsError(GITS_ERR_INVALID, "Invalid time.");
+    }
+    std::ostringstream oss;
+    oss << std::put_time(std::gmtime(&local_time), "%FT%TZ");
+    time_str = oss.str();
+}
+
+void local_to_utc(std::string& time_str) {
+    time_t local_time;
+    local_to_utc(time_str, local_time);
+}
+
+// Function to validate schedule time
+void validate_schedule_time(std::string& time_str) {
+    time_t local_time;
+    local_to_utc(time_str, local_time);
+    auto tp = std::chrono::system_clock::from_time_t(local_time);
+    auto now = std::chrono::system_clock::now();
+    if (tp <= now) {
+        throw GitsError(GITS_ERR_INVALID, "Schedule time must be in the future.");
+    }
+}
+
+// Function to get repo URL
+std::string get_repo_url() {
+    std::string output;
+    if (!repo_remote_url("origin", output)) {
+        throw GitsError(GITS_ERR_REPO, "Could not retrieve repository URL. Ensure 'origin' remote is set.");
+    }
+    bool is_https = output.substr(0, 8) == "https://";
+    bool is_ssh_git = output.substr(0, 4) == "git@";
+    bool is_ssh_url = output.substr(0, 10) == "ssh://git@";
+    if (!is_https && !is_ssh_git && !is_ssh_url) {
+        throw GitsError(GITS_ERR_REPO, "Repository URL must be HTTPS or SSH format for GitHub.");
+    }
+    return output;
+}
+
+// Function to build the zip codec policy from ZIP_CODEC, ZSTD_LEVEL and ZSTD_DICT
+CodecPolicy load_codec_policy(const std::map<std::string, std::string>& config) {
+    CodecPolicy policy;
+    auto codec_it = config.find("ZIP_CODEC");
+    if (codec_it != config.end() && !codec_it->second.empty()) {
+        policy.mode = codec_it->second;
+    }
+    if (policy.mode != "auto" && policy.mode != "zstd" && policy.mode != "deflate" && policy.mode != "store") {
+        throw GitsError(GITS_ERR_CONFIG, "ZIP_CODEC must be auto, zstd, deflate or store");
+    }
+    if (policy.mode == "zstd" && !zstd_available()) {
+        throw GitsError(GITS_ERR_CONFIG, "ZIP_CODEC=zstd but this build of gits has no zstd support");
+    }
+    auto level_it = config.find("ZSTD_LEVEL");
+    if (level_it != config.end() && !level_it->second.empty()) {
+        try {
+            policy.zstd_level = std::stoi(level_it->second);
+        } catch (const std::exception&) {
+            policy.zstd_level = 0;
+        }
+        if (policy.zstd_level < 1 || policy.zstd_level > 19) {
+            throw GitsError(GITS_ERR_CONFIG, "ZSTD_LEVEL must be between 1 and 19");
+        }
+    }
+    auto dict_it = config.find("ZSTD_DICT");
+    if (dict_it != config.end() && !dict_it->second.empty() && zstd_available() && policy.mode != "deflate" && policy.mode != "store") {
+        std::ifstream in(dict_it->second, std::ios::binary);
+        std::stringstream bytes;
+        bytes << in.rdbuf();
+        if (!in || bytes.str().empty()) {
+            throw GitsError(GITS_ERR_IO, text("Could not read ZSTD_DICT: ", dict_it->second));
+        }
+        try {
+            load_zstd_dictionary(policy, bytes.str());
+        } catch (const std::exception& e) {
+            throw GitsError(GITS_ERR_CONFIG, e.what());
+        }
+    }
+    return policy;
+}
+
+// Function to read STATUS_THREADS, the work tree scan threads for git status
+unsigned load_status_threads(const std::map<std::string, std::string>& config) {
+    // Default: one per core
+    unsigned status_threads = std::max(1u, std::thread::hardware_concurrency());
+    auto status_threads_it = config.find("STATUS_THREADS");
+    if (status_threads_it != config.end() && !status_threads_it->second.empty()) {
+        try {
+            status_threads = static_cast<unsigned>(std::stoul(status_threads_it->second));
+        } catch (const std::exception&) {
+            throw GitsError(GITS_ERR_CONFIG, "STATUS_THREADS must be a number");
+        }
+    }
+    return status_threads;
+}
+
+// Function to read UPLOAD_MODE: presigned (default) uploads the raw zip to S3,
+// stream sends it base64-encoded inside a chunked JSON body, buffered uses a temp zip file
+std::string load_upload_mode(const std::map<std::string, std::string>& config) {
+    auto upload_mode_it = config.find("UPLOAD_MODE");
+    std::string upload_mode = upload_mode_it != config.end() && !upload_mode_it->second.empty() ? upload_mode_it->second : "presigned";
+    if (upload_mode != "presigned" && upload_mode != "stream" && upload_mode != "buffered") {
+        throw GitsError(GITS_ERR_CONFIG, "UPLOAD_MODE must be presigned, stream or buffered");
+    }
+    return upload_mode;
+}
+
+// Function to read SCHEDULE_ENCODING: json (default) sends an inline archive
+// base64-encoded in the JSON body, multipart sends it as a raw
+// multipart/form-data part next to the JSON metadata
+std::string load_schedule_encoding(const std::map<std::string, std::string>& config) {
+    auto encoding_it = config.find("SCHEDULE_ENCODING");
+    std::string encoding = encoding_it != config.end() && !encoding_it->second.empty() ? encoding_it->second : "json";
+    if (encoding != "json" && encoding != "multipart") {
+        throw GitsError(GITS_ERR_CONFIG, "SCHEDULE_ENCODING must be json or multipart");
+    }
+    return encoding;
+}
+
+// Function to read BLOB_MIN_SIZE; files at least this large (default 1 MiB) are shipped by content hash
+uintmax_t load_blob_min_size(const std::map<std::string, std::string>& config) {
+    uintmax_t blob_min_size = 1024 * 1024;
+    auto blob_min_size_it = config.find("BLOB_MIN_SIZE");
+    if (blob_min_size_it != config.end() && !blob_min_size_it->second.empty()) {
+        try {
+            blob_min_size = std::stoull(blob_min_size_it->second);
+        } catch (const std::exception&) {
+            throw GitsError(GITS_ERR_CONFIG, "BLOB_MIN_SIZE must be a number of bytes");
+        }
+    }
+    return blob_min_size;
+}
+
+// Function to load MULTIPART_MIN_SIZE, the archive size from which uploads go
+// to S3 in resumable parts (default 64 MiB)
+uintmax_t load_multipart_min_size(const std::map<std::string, std::string>& config) {
+    uintmax_t multipart_min_size = 64 * 1024 * 1024;
+    auto multipart_min_size_it = config.find("MULTIPART_MIN_SIZE");
+    if (multipart_min_size_it != config.end() && !multipart_min_size_it->second.empty()) {
+        try {
+            multipart_min_size = std::stoull(multipart_min_size_it->second);
+        } catch (const std::exception&) {
+            throw GitsError(GITS_ERR_CONFIG, "MULTIPART_MIN_SIZE must be a number of bytes");
+        }
+    }
+    return multipart_min_size;
+}
+
+// Callback for libcurl to pull the streamed request body
+size_t payload_read_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    auto* payload = static_cast<PayloadStream*>(userdata);
+    try {
+        return payload->read(buffer, size * nitems);
+    } catch (const std::exception& e) {
+        payload->error = e.what();
+        return CURL_READFUNC_ABORT;
+    }
+}
+
+// Struct for a validated schedule request, without the zip body
+struct ScheduleRequest {
+    std::string api_url;
+    std::string api_key;
+    std::string encoding;  // SCHEDULE_ENCODING, for an archive sent inline
+    json payload;
+};
+
+// Function to validate config and build the schedule request metadata
+ScheduleRequest prepare_schedule_request(const std::string& schedule_time, const std::string& repo_url, const std::string& zip_filename, const std::string& commit_message, const std::map<std::string, std::string>& config) {
+    std::string api_url = require_setting(config, "API_GATEWAY_URL");
+    std::string user_id = require_setting(config, "GITHUB_EMAIL");
+    std::string github_username = require_setting(config, "GITHUB_USERNAME");
+    std::string github_display_name = require_setting(config, "GITHUB_DISPLAY_NAME");
+    std::string api_key = require_setting(config, "API_KEY");
+
+    ScheduleRequest request;
+    request.api_url = api_url;
+    request.api_key = api_key;
+    request.encoding = load_schedule_encoding(config);
+    request.payload = {
+        {"schedule_time", schedule_time},
+        {"repo_url", repo_url},
+        {"zip_filename", zip_filename},
+        {"github_username", github_username},
+        {"github_display_name", github_display_name},
+        {"github_email", user_id},
+        {"commit_message", commit_message},
+        {"user_id", user_id}
+    };
+    return request;
+}
+
+// Function to read the outcome of a schedule request
+ScheduleResult finish_schedule_request(CURLcode res, long http_code, const std::string& response) {
+    if (res != CURLE_OK) {
+        throw GitsError(GITS_ERR_NETWORK, text("Network request failed: ", curl_easy_strerror(res)));
+    }
+    if (http_code != 200) {
+        throw GitsError(GITS_ERR_HTTP, text("Remote scheduling failed (HTTP ", http_code, "). Response: ", response));
+    }
+    json j = json::parse(response, nullptr, false);
+    ScheduleResult result;
+    if (j.is_object()) {
+        result.job_id = j.value("job_id", j.value("rule_name", ""));
+        result.cron_expression = j.value("cron_expression", "");
+        result.duplicate = j.value("duplicate", false);
+    }
+    return result;
+}
+
+// Function to POST a complete schedule body
+ScheduleResult post_schedule_body(const ScheduleRequest& request, const std::string& payload_str, const std::string& content_type) {
+    CURL* curl = easy_handle();
+    std::string response;
+    struct curl_slist* headers = nullptr;
+    std::string content_type_header = "Content-Type: " + content_type;
+    headers = curl_slist_append(headers, content_type_header.c_str());
+    std::string api_key_header = "x-api-key: " + request.api_key;
+    headers = curl_slist_append(headers, api_key_header.c_str());
+    std::string url = request.api_url + "/schedule";
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload_str.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, payload_str.size());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    CURLcode res = CURLE_OK;
+    for (int attempt = 0;; ++attempt) {
+        response.clear();
+        res = http_perform(curl);
+        if (!http_retry(curl, res, attempt)) break;
+    }
+
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+    return finish_schedule_request(res, http_code, response);
+}
+
+// Function to send schedule request whose payload already references the changes
+ScheduleResult send_schedule_request(const ScheduleRequest& request) {
+    return post_schedule_body(request, request.payload.dump(), "application/json");
+}
+
+// Function to send schedule request carrying a finished archive inline,
+// base64 in the JSON body or raw in a multipart body
+ScheduleResult send_schedule_request_inline(ScheduleRequest request, const std::string& archive_file) {
+    if (request.encoding != "multipart") {
+        request.payload["zip_base64"] = trace_call("base64_encode_file", [&] { return base64_encode_file(archive_file); });
+        return trace_call("send_schedule_request", [&] { return send_schedule_request(request); });
+    }
+    std::ifstream file(archive_file, std::ios::binary);
+    if (!file) {
+        throw GitsError(GITS_ERR_IO, text("Failed to read ", archive_file));
+    }
+    std::string boundary = multipart_boundary();
+    std::string body = multipart_prefix(boundary, request.payload.dump(), request.payload.value("zip_filename", ""));
+    body.append(std::istreambuf_iterator<char>(file), {});
+    body += multipart_suffix(boundary);
+    return trace_call("send_schedule_request", [&] { return post_schedule_body(request, body, "multipart/form-data; boundary=" + boundary); });
+}
+
+// Function to send schedule request, zipping and encoding while uploading.
+// fill_zip queues the changes; it runs again for each retry, as the archive
+// is produced while it is sent.
+ScheduleResult send_schedule_request_stream(const ScheduleRequest& request, const std::function<void(ZipStream&)>& fill_zip) {
+    // A JSON payload is written up to the opening quote of zip_base64 and the
+    // encoded archive is streamed into it; a multipart body streams the raw
+    // archive as its last part. Either way with chunked transfer encoding.
+    bool multipart = request.encoding == "multipart";
+    std::string boundary = multipart ? multipart_boundary() : "";
+    std::string prefix = multipart ? multipart_prefix(boundary, request.payload.dump(), request.payload.value("zip_filename", ""))
+                                   : schedule_stream_prefix(request.payload.dump());
+    std::string suffix = multipart ? multipart_suffix(boundary) : "\"}";
+
+    CURL* curl = easy_handle();
+    std::string response;
+    struct curl_slist* headers = nullptr;
+    std::string content_type_header = multipart ? "Content-Type: multipart/form-data; boundary=" + boundary : "Content-Type: application/json";
+    headers = curl_slist_append(headers, content_type_header.c_str());
+    headers = curl_slist_append(headers, "Transfer-Encoding: chunked");
+    std::string api_key_header = "x-api-key: " + request.api_key;
+    headers = curl_slist_append(headers, api_key_header.c_str());
+    std::string url = request.api_url + "/schedule";
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, payload_read_callback);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    CURLcode res = CURLE_OK;
+    std::string read_error;
+    for (int attempt = 0;; ++attempt) {
+        ZipStream zip;
+        fill_zip(zip);
+        PayloadStream payload(prefix, zip, suffix, !multipart);
+        curl_easy_setopt(curl, CURLOPT_READDATA, &payload);
+        response.clear();
+        res = http_perform(curl);
+        read_error = payload.error;
+        if (!read_error.empty() || !http_retry(curl, res, attempt)) break;
+    }
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+    if (!read_error.empty()) {
+        throw GitsError(GITS_ERR_IO, read_error);
+    }
+    return finish_schedule_request(res, http_code, response);
+}
+
+// Function to POST a JSON body to the API and return the HTTP status
+long post_json(const std::string& url, const std::string& api_key, const std::string& body, std::string& response) {
+    CURL* curl = easy_handle();
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    std::string api_key_header = "x-api-key: " + api_key;
+    headers = curl_slist_append(headers, api_key_header.c_str());
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, body.size());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    CURLcode res = CURLE_OK;
+    for (int attempt = 0;; ++attempt) {
+        response.clear();
+        res = http_perform(curl);
+        if (!http_retry(curl, res, attempt)) break;
+    }
+
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+    if (res != CURLE_OK) {
+        throw GitsError(GITS_ERR_NETWORK, text("Network request failed: ", curl_easy_strerror(res)));
+    }
+    return http_code;
+}
+
+// Function to finish a digest and return it as lowercase hex
+std::string hex_digest(EVP_MD_CTX* ctx) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+    EVP_DigestFinal_ex(ctx, digest, &digest_len);
+    std::ostringstream hex;
+    for (unsigned int i = 0; i < digest_len; ++i) {
+        hex << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(digest[i]);
+    }
+    return hex.str();
+}
+
+// Struct for the body of a PUT, hashing the bytes as they are sent
+struct HashingReader {
+    FILE* file;
+    EVP_MD_CTX* ctx;
+};
+
+size_t hashing_read_callback(char* buffer, size_t size, size_t nitems, void* userp) {
+    auto* reader = static_cast<HashingReader*>(userp);
+    size_t n = fread(buffer, 1, size * nitems, reader->file);
+    if (reader->ctx) EVP_DigestUpdate(reader->ctx, buffer, n);
+    return n;
+}
+
+// Function to PUT an open file to a pre-signed URL. With a sha256 the file
+// goes out with x-amz-checksum-sha256, so S3 refuses a body that does not
+// match, and the bytes sent must hash to it: a file that changed since it
+// was hashed fails the upload instead of storing other content.
+void put_file(const std::string& url, FILE* file, curl_off_t size, const std::string& sha256 = "") {
+    CURL* curl = easy_handle();
+    std::string response;
+    struct curl_slist* headers = nullptr;
+    std::unique_ptr<EVP_MD_CTX, void(*)(EVP_MD_CTX*)> ctx(sha256.empty() ? nullptr : EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    if (ctx) {
+        std::string checksum_header = "x-amz-checksum-sha256: " + sha256_checksum(sha256);
+        headers = curl_slist_append(headers, checksum_header.c_str());
+    }
+    HashingReader reader{file, ctx.get()};
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, hashing_read_callback);
+    curl_easy_setopt(curl, CURLOPT_READDATA, &reader);
+    curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, size);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    long start = ftell(file);
+    CURLcode res = CURLE_OK;
+    for (int attempt = 0;; ++attempt) {
+        response.clear();
+        fseek(file, start, SEEK_SET);
+        if (ctx) EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr);
+        res = http_perform(curl);
+        if (!http_retry(curl, res, attempt)) break;
+    }
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+    if (res != CURLE_OK) {
+        throw GitsError(GITS_ERR_NETWORK, text("Upload failed: ", curl_easy_strerror(res)));
+    }
+    if (http_code != 200) {
+        throw GitsError(GITS_ERR_HTTP, text("Upload failed (HTTP ", http_code, "). Response: ", response));
+    }
+    if (ctx && hex_digest(ctx.get()) != sha256) {
+        throw GitsError(GITS_ERR_IO, "A file changed while it was being uploaded");
+    }
+}
+
+// Struct for a pre-signed upload slot in the artifact bucket
+struct UploadTarget {
+    std::string upload_url;
+    std::string s3_key;
+};
+
+// Function to ask the backend for a pre-signed PUT URL. Returns false when the
+// deployed API predates the upload-url endpoint.
+bool request_upload_url(const ScheduleRequest& request, UploadTarget& target) {
+    json payload = {
+        {"user_id", request.payload["user_id"]},
+        {"zip_filename", request.payload["zip_filename"]}
+    };
+    std::string response;
+    long http_code = post_json(request.api_url + "/upload-url", request.api_key, payload.dump(), response);
+    // API Gateway answers 403 for resources that do not exist
+    if (http_code == 403 || http_code == 404) {
+        return false;
+    }
+    if (http_code != 200) {
+        throw GitsError(GITS_ERR_HTTP, text("Could not get upload URL (HTTP ", http_code, "). Response: ", response));
+    }
+    try {
+        json j = json::parse(response);
+        target.upload_url = j.value("upload_url", "");
+        target.s3_key = j.value("s3_key", "");
+    } catch (const json::parse_error&) {
+        throw GitsError(GITS_ERR_PROTOCOL, "Could not parse the response");
+    }
+    if (target.upload_url.empty() || target.s3_key.empty()) {
+        throw GitsError(GITS_ERR_PROTOCOL, "Upload URL response is missing upload_url or s3_key");
+    }
+    return true;
+}
+
+// Multipart uploads are checkpointed in ~/.gits/uploads/<idempotency key>/:
+// changes.zip is the archive being uploaded and state.json records the S3
+// upload and the ETag of every finished part. Running the same command again
+// finds the directory by key and uploads only the missing parts. Checkpoints
+// are dropped after a week, when the bucket aborts the upload too.
+const auto UPLOAD_CHECKPOINT_MAX_AGE = std::chrono::hours(24 * 7);
+
+// Struct for a checkpointed multipart upload
+struct MultipartState {
+    std::string upload_id;
+    std::string s3_key;
+    uint64_t size = 0;
+    uint64_t part_size = 0;
+    bool completed = false;
+    std::map<int, std::string> etags;  // finished parts
+};
+
+fs::path upload_checkpoint_dir(const ScheduleRequest& request) {
+    return gits_dir() / "uploads" / request.payload["idempotency_key"].get<std::string>();
+}
+
+// Function to remove checkpoints that are too old to resume
+void prune_upload_checkpoints() {
+    std::error_code ec;
+    fs::path uploads = gits_dir() / "uploads";
+    auto now = fs::file_time_type::clock::now();
+    for (const auto& entry : fs::directory_iterator(uploads, ec)) {
+        auto modified = fs::last_write_time(entry.path(), ec);
+        if (!ec && now - modified > UPLOAD_CHECKPOINT_MAX_AGE) {
+            fs::remove_all(entry.path(), ec);
+        }
+    }
+}
+
+// Function to read state.json; a missing or corrupt one is no checkpoint
+bool load_multipart_state(const fs::path& dir, MultipartState& state) {
+    std::ifstream in(dir / "state.json");
+    if (!in) return false;
+    json j = json::parse(in, nullptr, false);
+    if (j.is_discarded() || !j.is_object()) return false;
+    try {
+        state.upload_id = j.value("upload_id", "");
+        state.s3_key = j.value("s3_key", "");
+        state.size = j.value("size", 0ULL);
+        state.part_size = j.value("part_size", 0ULL);
+        state.completed = j.value("completed", false);
+        json parts = j.value("parts", json::object());
+        for (const auto& part : parts.items()) {
+            state.etags[std::stoi(part.key())] = part.value().get<std::string>();
+        }
+    } catch (const std::exception&) {
+        // Wrong types (json::type_error) or part numbers that are not numbers
+        state = MultipartState();
+        return false;
+    }
+    return !state.upload_id.empty() && state.part_size > 0;
+}
+
+// Function to write state.json; a crash leaves the previous version intact
+void save_multipart_state(const fs::path& dir, const MultipartState& state) {
+    json parts = json::object();
+    for (const auto& part : state.etags) parts[std::to_string(part.first)] = part.second;
+    json j = {
+        {"upload_id", state.upload_id},
+        {"s3_key", state.s3_key},
+        {"size", state.size},
+        {"part_size", state.part_size},
+        {"completed", state.completed},
+        {"parts", parts}
+    };
+    fs::path tmp = dir / "state.json.tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << j.dump();
+    }
+    fs::rename(tmp, dir / "state.json");
+}
+
+// Function to call the multipart endpoint; the reply is parsed on HTTP 200
+long multipart_call(const ScheduleRequest& request, json body, json& reply) {
+    body["user_id"] = request.payload["user_id"];
+    std::string response;
+    long http_code = post_json(request.api_url + "/multipart", request.api_key, body.dump(), response);
+    if (http_code == 200) {
+        reply = json::parse(response, nullptr, false);
+        if (reply.is_discarded() || !reply.is_object()) {
+            throw GitsError(GITS_ERR_PROTOCOL, "Could not parse the response");
+        }
+    } else if (http_code != 403 && http_code != 404) {
+        throw GitsError(GITS_ERR_HTTP, text("Multipart upload request failed (HTTP ", http_code, "). Response: ", response));
+    }
+    return http_code;
+}
+
+// Function to upload dir/changes.zip with S3 multipart upload, resuming the
+// checkpoint in dir when there is one, and set s3_key in the payload. Returns
+// false when the deployed API has no multipart endpoint.
+bool upload_multipart(ScheduleRequest& request, const fs::path& dir) {
+    fs::path archive = dir / "changes.zip";
+    uint64_t size = fs::file_size(archive);
+    MultipartState state;
+    std::map<int, std::string> urls;
+    json reply;
+    if (load_multipart_state(dir, state) && state.size == size && !state.completed) {
+        uint64_t part_count = (size + state.part_size - 1) / state.part_size;
+        json missing = json::array();
+        for (uint64_t n = 1; n <= part_count; ++n) {
+            if (!state.etags.count(static_cast<int>(n))) missing.push_back(n);
+        }
+        long http_code = multipart_call(request, {{"action", "resume"}, {"upload_id", state.upload_id}, {"s3_key", state.s3_key}, {"part_numbers", missing}}, reply);
+        if (http_code == 403) return false;
+        if (http_code == 404) {
+            // The bucket aborted the upload; start over with the same archive
+            state = MultipartState();
+        } else {
+            // S3's own list also covers parts that finished after the last checkpoint
+            json parts = reply.value("parts", json::array());
+            for (const auto& part : parts) {
+                state.etags[part.value("part_number", 0)] = part.value("etag", "");
+            }
+            notice(text("Resuming upload: ", state.etags.size(), " of ", part_count, " parts already uploaded"));
+        }
+    } else if (!state.completed) {
+        state = MultipartState();
+    }
+
+    if (state.upload_id.empty()) {
+        long http_code = multipart_call(request, {{"action", "start"}, {"zip_filename", request.payload["zip_filename"]}, {"size", size}}, reply);
+        if (http_code != 200) return false;
+        state.upload_id = reply.value("upload_id", "");
+        state.s3_key = reply.value("s3_key", "");
+        state.size = size;
+        state.part_size = reply.value("part_size", 0ULL);
+        if (state.upload_id.empty() || state.s3_key.empty() || state.part_size == 0) {
+            throw GitsError(GITS_ERR_PROTOCOL, "Multipart response is missing upload_id, s3_key or part_size");
+        }
+        save_multipart_state(dir, state);
+    }
+
+    if (!state.completed) {
+        json part_urls = reply.value("part_urls", json::array());
+        for (const auto& part : part_urls) {
+            int part_number = part.value("part_number", 0);
+            if (!state.etags.count(part_number)) urls[part_number] = part.value("url", "");
+        }
+        uint64_t part_count = (size + state.part_size - 1) / state.part_size;
+        if (state.etags.size() + urls.size() != part_count) {
+            throw GitsError(GITS_ERR_PROTOCOL, "Multipart response does not cover every part");
+        }
+        uint64_t done_bytes = 0;
+        for (const auto& part : state.etags) {
+            done_bytes += std::min<uint64_t>(state.part_size, size - (part.first - 1) * state.part_size);
+        }
+        bool uploaded = upload_parts(archive.string(), size, state.part_size, urls, done_bytes, [&](int part_number, const std::string& etag) {
+            state.etags[part_number] = etag;
+            save_multipart_state(dir, state);
+        });
+        if (!uploaded) {
+            throw GitsError(GITS_ERR_NETWORK, "Upload interrupted; run the same command again to resume it");
+        }
+
+        json parts = json::array();
+        for (const auto& part : state.etags) parts.push_back({{"part_number", part.first}, {"etag", part.second}});
+        long http_code = multipart_call(request, {{"action", "complete"}, {"upload_id", state.upload_id}, {"s3_key", state.s3_key}, {"parts", parts}}, reply);
+        if (http_code != 200) {
+            throw GitsError(GITS_ERR_HTTP, text("Could not complete the upload (HTTP ", http_code, ")"));
+        }
+        state.completed = true;
+        save_multipart_state(dir, state);
+    }
+    request.payload["s3_key"] = state.s3_key;
+    return true;
+}
+
+// Function to compute the hex SHA-256 of a file, reading it in fixed-size chunks
+std::string sha256_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw GitsError(GITS_ERR_IO, text("Cannot open file for hashing: ", path));
+    }
+    std::unique_ptr<EVP_MD_CTX, void(*)(EVP_MD_CTX*)> ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr);
+    std::vector<char> buffer(ZipStream::CHUNK_SIZE);
+    while (file) {
+        file.read(buffer.data(), buffer.size());
+        EVP_DigestUpdate(ctx.get(), buffer.data(), static_cast<size_t>(file.gcount()));
+    }
+    return hex_digest(ctx.get());
+}
+
+// Function to get a changed file's hex SHA-256, hashing it on first use.
+// dedup_large_files and idempotency_key share the digests this way.
+const std::string& changed_file_sha256(FileChanges& changes, const std::string& path) {
+    auto it = changes.sha256_by_path.find(path);
+    if (it == changes.sha256_by_path.end()) {
+        it = changes.sha256_by_path.emplace(path, sha256_file(path)).first;
+    }
+    return it->second;
+}
+
+// Function to derive a schedule request's idempotency key from what it would
+// push. Re-running with the same changes, time, message and mode gives the
+// same key, so the backend recognises a retry whose response was lost.
+std::string idempotency_key(FileChanges& changes, const json& payload) {
+    // Fields and records are NUL-separated, as paths may contain anything else
+    std::string canonical;
+    auto field = [&](const std::string& value) {
+        canonical += value;
+        canonical += '\0';
+    };
+    for (const char* name : {"user_id", "repo_url", "schedule_time", "commit_message"}) {
+        field(payload.value(name, ""));
+    }
+    field(payload.value("format", "zip"));
+    for (const auto& file : changes.files_to_zip) {
+        std::error_code ec;
+        std::ostringstream mode;
+        mode << std::oct << (static_cast<unsigned>(fs::status(file, ec).permissions()) & 0777);
+        field("file");
+        field(file);
+        field(mode.str());
+        field(changed_file_sha256(changes, file));
+    }
+    for (const auto& blob : changes.blobs_for_manifest) {
+        field("blob");
+        field(blob.path);
+        field(blob.mode);
+        field(blob.sha256);
+    }
+    for (const auto& file : changes.deletes_for_manifest) {
+        field("delete");
+        field(file);
+    }
+    std::unique_ptr<EVP_MD_CTX, void(*)(EVP_MD_CTX*)> ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr);
+    EVP_DigestUpdate(ctx.get(), canonical.data(), canonical.size());
+    return hex_digest(ctx.get());
+}
+
+// Hashes sent per /blobs call; the backend accepts up to 1000
+const size_t BLOB_CHECK_BATCH = 500;
+
+// Function to move large files out of the zip into the content-addressed blob
+// store, uploading only the blobs the backend does not already have
+void dedup_large_files(FileChanges& changes, const ScheduleRequest& request, uintmax_t min_size) {
+    std::map<std::string, std::vector<std::string>> paths_by_hash;
+    std::vector<std::string> kept;
+    std::vector<BlobRef> blobs;
+    for (const auto& file : changes.files_to_zip) {
+        std::error_code ec;
+        if (!fs::is_regular_file(file, ec) || fs::file_size(file, ec) < min_size || ec) {
+            kept.push_back(file);
+            continue;
+        }
+        BlobRef blob;
+        blob.path = file;
+        blob.sha256 = changed_file_sha256(changes, file);
+        std::ostringstream mode;
+        mode << std::oct << (static_cast<unsigned>(fs::status(file).permissions()) & 0777);
+        blob.mode = mode.str();
+        paths_by_hash[blob.sha256].push_back(file);
+        blobs.push_back(blob);
+    }
+    if (blobs.empty()) return;
+
+    std::map<std::string, std::string> missing;
+    std::vector<std::string> hashes;
+    bool checksum = false;
+    for (const auto& entry : paths_by_hash) {
+        hashes.push_back(entry.first);
+    }
+    for (size_t start = 0; start < hashes.size(); start += BLOB_CHECK_BATCH) {
+        size_t end = std::min(hashes.size(), start + BLOB_CHECK_BATCH);
+        json payload = {
+            {"user_id", request.payload["user_id"]},
+            {"hashes", std::vector<std::string>(hashes.begin() + start, hashes.begin() + end)}
+        };
+        std::string response;
+        long http_code = post_json(request.api_url + "/blobs", request.api_key, payload.dump(), response);
+        if ((http_code == 403 || http_code == 404) && start == 0) {
+            // Backend without a blob store: everything stays in the zip
+            return;
+        }
+        if (http_code != 200) {
+            throw GitsError(GITS_ERR_HTTP, text("Blob check failed (HTTP ", http_code, "). Response: ", response));
+        }
+        try {
+            json j = json::parse(response);
+            checksum = j.value("checksum_sha256", false);
+            json batch_missing = j.value("missing", json::object());
+            for (const auto& item : batch_missing.items()) {
+                missing[item.key()] = item.value().get<std::string>();
+            }
+        } catch (const json::exception& e) {
+            throw GitsError(GITS_ERR_PROTOCOL, "Could not parse the response");
+        }
+    }
+
+    for (const auto& entry : missing) {
+        const std::string& path = paths_by_hash[entry.first].front();
+        std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(path.c_str(), "rb"), fclose);
+        if (!file) {
+            throw GitsError(GITS_ERR_IO, text("Cannot open file for upload: ", path));
+        }
+        // URLs signed for the checksum only accept the blob's exact bytes
+        put_file(entry.second, file.get(), static_cast<curl_off_t>(fs::file_size(path)), checksum ? entry.first : "");
+    }
+
+    changes.files_to_zip = kept;
+    changes.blobs_for_manifest = blobs;
+    notice(text("Blob store: ", hashes.size() - missing.size(), " reused, ", missing.size(), " uploaded"));
+}
+
+// Function to commit the changes locally into a git bundle in the temp directory.
+// git's own delta compression applies and the build side pushes that exact commit.
+std::string create_bundle(const FileChanges& changes, const std::string& commit_message, const std::string& bundle_filename) {
+    std::vector<std::string> paths = changes.files_to_zip;
+    paths.insert(paths.end(), changes.deletes_for_manifest.begin(), changes.deletes_for_manifest.end());
+    std::string message = commit_message.empty() ? "Applied changes using gits" : commit_message;
+    std::string bundle_file = (fs::temp_directory_path() / bundle_filename).string();
+    try {
+        std::string commit = repo_create_bundle(paths, message, bundle_file);
+        notice(text("Bundled commit ", commit.substr(0, 12), " (", fs::file_size(bundle_file), " bytes)"));
+    } catch (const std::exception& e) {
+        throw GitsError(GITS_ERR_REPO, e.what());
+    }
+    return bundle_file;
+}
+
+// Function to upload a finished archive (zip or bundle) through a pre-signed
+// URL; returns false, changing nothing, when none is available
+bool upload_changes_file(ScheduleRequest& request, const std::string& archive_file, const std::string& upload_mode) {
+    UploadTarget target;
+    if (upload_mode != "presigned" || !request_upload_url(request, target)) {
+        return false;
+    }
+    std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(archive_file.c_str(), "rb"), fclose);
+    if (!file) {
+        throw GitsError(GITS_ERR_IO, text("Failed to read ", archive_file));
+    }
+    put_file(target.upload_url, file.get(), static_cast<curl_off_t>(fs::file_size(archive_file)));
+    request.payload["s3_key"] = target.s3_key;
+    return true;
+}
+
+// Function to attach a finished archive to a request: uploaded through a
+// pre-signed URL when available, otherwise inline as base64
+void attach_changes_file(ScheduleRequest& request, const std::string& archive_file, const std::string& upload_mode) {
+    if (!upload_changes_file(request, archive_file, upload_mode)) {
+        request.payload["zip_base64"] = base64_encode_file(archive_file);
+    }
+}
+
+// Jobs per --batch file; the backend accepts the same number per /schedule/batch call
+const size_t MAX_BATCH_JOBS = 100;
+// Archives of a batch upload in parallel, this many at a time
+const size_t BATCH_UPLOAD_CONCURRENCY = 8;
+
+// Struct for one entry of a --batch jobs file
+struct BatchJob {
+    std::string schedule_time;
+    std::string commit_message;
+    std::vector<std::string> files;
+    std::string mode = "zip";
+    std::string repo;
+};
+
+// Function to read and validate a jobs file: a JSON array of
+// {schedule_time, message?, files?, mode?, repo?} objects
+std::vector<BatchJob> load_batch_jobs(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw GitsError(GITS_ERR_IO, text("Cannot read jobs file: ", path));
+    }
+    json j;
+    try {
+        j = json::parse(in);
+    } catch (const json::parse_error& e) {
+        throw GitsError(GITS_ERR_INVALID, text("Jobs file is not valid JSON: ", e.what()));
+    }
+    if (!j.is_array() || j.empty() || j.size() > MAX_BATCH_JOBS) {
+        throw GitsError(GITS_ERR_INVALID, text("Jobs file must be an array of 1-", MAX_BATCH_JOBS, " jobs"));
+    }
+    std::vector<BatchJob> jobs;
+    for (size_t i = 0; i < j.size(); ++i) {
+        BatchJob job;
+        try {
+            const json& entry = j.at(i);
+            job.schedule_time = entry.at("schedule_time").get<std::string>();
+            job.commit_message = entry.value("message", "");
+            job.files = entry.value("files", std::vector<std::string>());
+            job.mode = entry.value("mode", "zip");
+            job.repo = fs::absolute(entry.value("repo", ".")).string();
+        } catch (const json::exception&) {
+            throw GitsError(GITS_ERR_INVALID, text("Job ", i + 1, " needs a schedule_time and string fields"));
+        }
+        if (job.mode != "zip" && job.mode != "bundle") {
+            throw GitsError(GITS_ERR_INVALID, text("Job ", i + 1, ": mode must be zip or bundle"));
+        }
+        try {
+            validate_schedule_time(job.schedule_time);
+        } catch (const GitsError& e) {
+            throw GitsError(GITS_ERR_INVALID, text("Job ", i + 1, " has an invalid schedule_time: ", e.what()));
+        }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+// Function to build one batch job's archive from inside its repository.
+// The archive is left in the temp directory for upload_batch_archives.
+ScheduleRequest prepare_batch_job(const BatchJob& job, size_t index, const std::map<std::string, std::string>& config, const CodecPolicy& policy, std::string& archive_file) {
+    std::error_code ec;
+    fs::current_path(job.repo, ec);
+    if (ec || !repo_is_inside_work_tree()) {
+        throw GitsError(GITS_ERR_REPO, text("Job ", index + 1, ": not a Git repository: ", job.repo));
+    }
+    std::string repo_url = get_repo_url();
+    auto changes = gather_file_changes(repo_status(load_status_threads(config)), job.files);
+    std::string filename = "gits-changes-" + std::to_string(std::time(nullptr)) + "-" + std::to_string(index + 1) + (job.mode == "bundle" ? ".bundle" : ".zip");
+    auto request = prepare_schedule_request(job.schedule_time, repo_url, filename, job.commit_message, config);
+    if (job.mode == "bundle") {
+        request.payload["format"] = "bundle";
+        request.payload["idempotency_key"] = idempotency_key(changes, request.payload);
+        archive_file = create_bundle(changes, job.commit_message, filename);
+    } else {
+        dedup_large_files(changes, request, load_blob_min_size(config));
+        request.payload["idempotency_key"] = idempotency_key(changes, request.payload);
+        archive_file = create_zip(changes, policy, (fs::temp_directory_path() / filename).string());
+    }
+    return request;
+}
+
+// Function to upload the archives of a batch, several at a time
+void upload_batch_archives(std::vector<ScheduleRequest>& requests, const std::vector<std::string>& archives, const std::string& upload_mode) {
+    for (size_t start = 0; start < requests.size(); start += BATCH_UPLOAD_CONCURRENCY) {
+        size_t end = std::min(requests.size(), start + BATCH_UPLOAD_CONCURRENCY);
+        std::vector<std::thread> uploads;
+        std::vector<std::exception_ptr> errors(end - start);
+        auto deadline = http_retry_deadline();
+        for (size_t i = start; i < end; ++i) {
+            uploads.emplace_back([&, i] {
+                http_retry_inherit(deadline);
+                try {
+                    attach_changes_file(requests[i], archives[i], upload_mode);
+                } catch (...) {
+                    errors[i - start] = std::current_exception();
+                }
+            });
+        }
+        for (auto& upload : uploads) {
+            upload.join();
+        }
+        for (const auto& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+    }
+}
+
+// Function to send all jobs in one /schedule/batch call, falling back to one
+// /schedule call per job on backends without the batch endpoint. Returns one
+// result object per job.
+json send_batch_request(const std::vector<ScheduleRequest>& requests) {
+    // Identity fields are the same for every job and are sent once
+    const char* shared_fields[] = {"user_id", "github_username", "github_display_name", "github_email"};
+    json body = json::object();
+    json jobs = json::array();
+    for (const auto& request : requests) {
+        json job = request.payload;
+        for (const char* field : shared_fields) {
+            body[field] = job[field];
+            job.erase(field);
+        }
+        jobs.push_back(job);
+    }
+    body["jobs"] = jobs;
+
+    const ScheduleRequest& first = requests.front();
+    std::string response;
+    long http_code = post_json(first.api_url + "/schedule/batch", first.api_key, body.dump(), response);
+    if (http_code == 200) {
+        try {
+            json results = json::parse(response).at("results");
+            if (results.is_array() && results.size() == requests.size()) return results;
+        } catch (const json::exception&) {
+        }
+        throw GitsError(GITS_ERR_PROTOCOL, "Could not parse the response");
+    }
+    // API Gateway answers 403 for resources that do not exist
+    if (http_code != 403 && http_code != 404) {
+        throw GitsError(GITS_ERR_HTTP, text("Remote scheduling failed (HTTP ", http_code, "). Response: ", response));
+    }
+
+    json results = json::array();
+    for (size_t i = 0; i < requests.size(); ++i) {
+        std::string job_response;
+        long job_code = post_json(requests[i].api_url + "/schedule", requests[i].api_key, requests[i].payload.dump(), job_response);
+        json result = json::parse(job_response, nullptr, false);
+        if (!result.is_object()) result = json::object();
+        result["index"] = i;
+        if (job_code == 200) {
+            result["status"] = "scheduled";
+        } else {
+            result["status"] = "failed";
+            if (!result.contains("error")) result["error"] = "HTTP " + std::to_string(job_code);
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<BatchJobResult> schedule_batch(const Config& config, const std::string& batch_file) {
+    std::lock_guard<std::mutex> lock(schedule_mutex);
+    auto jobs = load_batch_jobs(batch_file);
+    std::string upload_mode = load_upload_mode(config);
+    auto codec_policy = load_codec_policy(config);
+
+    // Archives are built one job at a time, as each runs inside its own
+    // repository. Each is removed when its TemporaryFile goes, also when a
+    // later job or an upload throws.
+    std::vector<ScheduleRequest> requests;
+    std::vector<std::string> archives(jobs.size());
+    std::vector<std::unique_ptr<TemporaryFile>> archive_files;
+    {
+        WorkingDirectory start_dir;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            requests.push_back(prepare_batch_job(jobs[i], i, config, codec_policy, archives[i]));
+            archive_files.push_back(std::make_unique<TemporaryFile>(archives[i]));
+        }
+    }
+
+    // The batch body is a single JSON document, so stream mode uploads inline like buffered
+    upload_batch_archives(requests, archives, upload_mode);
+    archive_files.clear();
+
+    json results = send_batch_request(requests);
+    std::vector<BatchJobResult> outcomes;
+    for (const auto& result : results) {
+        BatchJobResult outcome;
+        outcome.scheduled = result.value("status", "") == "scheduled";
+        outcome.job_id = result.value("job_id", result.value("rule_name", ""));
+        outcome.cron_expression = result.value("cron_expression", "");
+        if (!outcome.scheduled) outcome.error = result.value("error", "unknown error");
+        outcomes.push_back(outcome);
+    }
+    return outcomes;
+}
+
+ScheduleResult schedule_changes(const Config& config, ScheduleOptions options) {
+    std::lock_guard<std::mutex> lock(schedule_mutex);
+    WorkingDirectory start_dir;
+    if (!options.repo_path.empty()) {
+        std::error_code ec;
+        fs::current_path(options.repo_path, ec);
+        if (ec) {
+            throw GitsError(GITS_ERR_REPO, "Cannot enter " + options.repo_path + ": " + ec.message());
+        }
+    }
+    if (options.mode != "zip" && options.mode != "bundle") {
+        throw GitsError(GITS_ERR_INVALID, "--mode must be zip or bundle");
+    }
+    validate_schedule_time(options.schedule_time);
+
+    std::string repo_url;
+    {
+        TraceSpan span("git checks");
+        if (!repo_is_inside_work_tree()) {
+            throw GitsError(GITS_ERR_REPO, "Must be run inside a Git repository.");
+        }
+        repo_url = get_repo_url();
+    }
+
+    unsigned status_threads = load_status_threads(config);
+    auto status = trace_call("git status", [&] { return options.status ? options.status(status_threads) : repo_status(status_threads); });
+    auto changes = trace_call("gather_file_changes", [&] { return gather_file_changes(status, options.files); });
+    std::string zip_filename = "gits-changes-" + std::to_string(std::time(nullptr)) + (options.mode == "bundle" ? ".bundle" : ".zip");
+    auto request = prepare_schedule_request(options.schedule_time, repo_url, zip_filename, options.commit_message, config);
+
+    std::string upload_mode = load_upload_mode(config);
+    ScheduleResult result;
+
+    if (options.mode == "bundle") {
+        request.payload["format"] = "bundle";
+        request.payload["idempotency_key"] = trace_call("idempotency key", [&] { return idempotency_key(changes, request.payload); });
+        TemporaryFile bundle_file(trace_call("create_bundle", [&] { return create_bundle(changes, options.commit_message, zip_filename); }));
+        if (trace_call("attach changes", [&] { return upload_changes_file(request, bundle_file.path(), upload_mode); })) {
+            result = trace_call("send_schedule_request", [&] { return send_schedule_request(request); });
+        } else {
+            result = send_schedule_request_inline(request, bundle_file.path());
+        }
+        result.schedule_time = options.schedule_time;
+        return result;
+    }
+
+    trace_call("dedup_large_files", [&] { dedup_large_files(changes, request, load_blob_min_size(config)); });
+    request.payload["idempotency_key"] = trace_call("idempotency key", [&] { return idempotency_key(changes, request.payload); });
+
+    auto codec_policy = load_codec_policy(config);
+
+    if (upload_mode == "buffered") {
+        TemporaryFile zip_file(trace_call("create_zip", [&] { return create_zip(changes, codec_policy, (fs::temp_directory_path() / zip_filename).string()); }));
+        result = send_schedule_request_inline(request, zip_file.path());
+    } else {
+        UploadTarget target;
+        fs::path upload_dir = upload_checkpoint_dir(request);
+        if (upload_mode == "presigned") {
+            prune_upload_checkpoints();
+        }
+        if (upload_mode == "presigned" && fs::exists(upload_dir / "state.json") && trace_call("upload", [&] { return upload_multipart(request, upload_dir); })) {
+            // An interrupted upload of the same changes was resumed
+            result = trace_call("send_schedule_request", [&] { return send_schedule_request(request); });
+            fs::remove_all(upload_dir);
+        } else if (upload_mode == "presigned" && trace_call("request upload URL", [&] { return request_upload_url(request, target); })) {
+            // S3 needs a Content-Length for PUT, so the archive is spooled
+            // first, into the checkpoint directory in case it goes up in parts
+            fs::create_directories(upload_dir);
+            std::string zip_file = trace_call("create_zip", [&] { return create_zip(changes, codec_policy, (upload_dir / "changes.zip").string()); });
+            uintmax_t size = fs::file_size(zip_file);
+            {
+                TraceSpan span("upload");
+                if (size < load_multipart_min_size(config) || !upload_multipart(request, upload_dir)) {
+                    std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(zip_file.c_str(), "rb"), fclose);
+                    if (!file) {
+                        throw GitsError(GITS_ERR_IO, "Failed to open " + zip_file);
+                    }
+                    put_file(target.upload_url, file.get(), static_cast<curl_off_t>(size));
+                    request.payload["s3_key"] = target.s3_key;
+                }
+            }
+            result = trace_call("send_schedule_request", [&] { return send_schedule_request(request); });
+            fs::remove_all(upload_dir);
+        } else {
+            // Zipping and encoding run inside the request, as the body is sent
+            TraceSpan span("send_schedule_request_stream");
+            result = send_schedule_request_stream(request, [&](ZipStream& zip) { add_changes_to_zip(changes, codec_policy, zip); });
+        }
+    }
+
+    result.schedule_time = options.schedule_time;
+    return result;
+}
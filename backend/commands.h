@@ -0,0 +1,106 @@
+#pragma once
+
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "git_repo.h"
+#include "gits_error.h"
+
+// The operations behind every gits command, shared by the CLI (gits.cpp) and
+// the C API (libgits.cpp). Failures throw GitsError rather than exiting, and
+// informational lines go through notice().
+
+using Config = std::map<std::string, std::string>;
+
+// Function to report progress such as "Blob store: 3 reused, 1 uploaded".
+// Lines go to stdout unless a handler is installed.
+void notice(const std::string& line);
+
+// Function to report a problem the command recovers from, such as a retried
+// request. Lines go to stderr unless a handler is installed, which then gets
+// them like notices.
+void warning(const std::string& line);
+
+// Function to install a handler for notice() and warning(); an empty one
+// drops the lines
+void set_notice_handler(std::function<void(const std::string&)> handler);
+
+// Function to tell whether lines still go to the console, where live
+// progress can be drawn
+bool notices_on_console();
+
+// Function to load configuration from path, ~/.gits/config when empty
+Config load_config(const std::string& path = "");
+
+// Function to convert a YYYY-MM-DDTHH:MM local time to the UTC ISO8601 form
+// the backend stores; throws GitsError for malformed times
+void local_to_utc(std::string& time_str, time_t& local_time);
+// Same, for callers that only need the converted string
+void local_to_utc(std::string& time_str);
+
+// Struct for one `gits schedule`
+struct ScheduleOptions {
+    std::string repo_path;      // repository to schedule from; empty: current directory
+    std::string schedule_time;  // local time, converted to UTC by schedule_changes
+    std::string commit_message;
+    std::vector<std::string> files;
+    std::string mode = "zip";
+    // Replaces the git status scan when set; gitsd answers it from inotify
+    std::function<std::vector<StatusEntry>(unsigned threads)> status;
+};
+
+// Struct for the backend's answer to a schedule request
+struct ScheduleResult {
+    std::string job_id;
+    std::string schedule_time;
+    std::string cron_expression;
+    bool duplicate = false;
+};
+
+// Function to schedule the changes of a repository. Schedules run one at a
+// time, as they change the process's working directory while they run.
+ScheduleResult schedule_changes(const Config& config, ScheduleOptions options);
+
+// Struct for one job as the status endpoint reports it
+struct JobStatus {
+    std::string job_id;
+    std::string schedule_time;
+    std::string status;
+    std::string json;  // the full record
+};
+
+// Function to get the latest job. A fresh cached answer is returned without a
+// request; otherwise the cached ETag is sent and a 304 reuses the cached body.
+JobStatus latest_job_status(const Config& config);
+
+// Function to follow the latest job with long-poll requests, calling on_change
+// for each new job or status, until it reaches a final status. Returns that job.
+JobStatus watch_job_status(const Config& config, const std::function<void(const JobStatus&)>& on_change);
+
+// Struct for `gits status --all` filters; since and until are UTC
+struct JobFilter {
+    std::string status;
+    std::string since;
+    std::string until;
+};
+
+// Function to list every job, newest first, calling on_job with each record
+// as pages arrive
+void list_jobs(const Config& config, const JobFilter& filter, const std::function<void(const JobStatus&)>& on_job);
+
+// Function to delete a scheduled job
+void delete_job(const Config& config, const std::string& job_id);
+
+// Struct for the outcome of one job of a batch
+struct BatchJobResult {
+    bool scheduled = false;
+    std::string job_id;
+    std::string cron_expression;
+    std::string error;
+};
+
+// Function to schedule every job of a jobs file, one result per job
+std::vector<BatchJobResult> schedule_batch(const Config& config, const std::string& batch_file);
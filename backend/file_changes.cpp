@@ -0,0 +1,102 @@
+#include "file_changes.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "gits_error.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Sort and drop duplicates, in place
+void sort_unique(std::vector<std::string>& v) {
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
+}  // namespace
+
+FileChanges gather_file_changes(const std::vector<StatusEntry>& status, const std::vector<std::string>& specified_files) {
+    FileChanges changes;
+    std::vector<std::string> deleted_paths;
+    std::vector<std::pair<std::string, std::string>> renames;
+    std::unordered_set<std::string> deleted_or_renamed;
+
+    for (const auto& e : status) {
+        char x = e.index_status, y = e.worktree_status;
+        if (x == 'D' || y == 'D') {
+            deleted_paths.push_back(e.path);
+            deleted_or_renamed.insert(e.path);
+        }
+        if ((x == 'R' || y == 'R') && !e.orig_path.empty()) {
+            renames.emplace_back(e.orig_path, e.path);
+            deleted_or_renamed.insert(e.orig_path);
+            deleted_or_renamed.insert(e.path);
+        }
+    }
+
+    std::unordered_set<std::string> zipped;
+    auto add_to_zip = [&](const std::string& path) {
+        if (zipped.insert(path).second) {
+            changes.files_to_zip.push_back(path);
+        }
+    };
+
+    if (!specified_files.empty()) {
+        std::unordered_set<std::string> specified(specified_files.begin(), specified_files.end());
+        for (const auto& f : specified_files) {
+            if (fs::exists(f)) {
+                add_to_zip(f);
+            } else if (deleted_or_renamed.count(f)) {
+                // It's deleted or part of rename, handle in manifest
+            } else {
+                throw GitsError(GITS_ERR_REPO, "file not found: " + f);
+            }
+        }
+        // Filter deletes and renames to specified
+        for (const auto& d : deleted_paths) {
+            if (specified.count(d)) {
+                changes.deletes_for_manifest.push_back(d);
+            }
+        }
+        for (const auto& r : renames) {
+            if (specified.count(r.first) && specified.count(r.second)) {
+                if (fs::exists(r.second)) {
+                    add_to_zip(r.second);
+                }
+                changes.deletes_for_manifest.push_back(r.first);
+            }
+        }
+    } else {
+        // Auto-detect
+        for (const auto& e : status) {
+            char x = e.index_status, y = e.worktree_status;
+            if ((x == 'A' && y == ' ') || (x == 'M' && y == ' ') || (x == ' ' && y == 'M') || (x == 'M' && y == 'M') || (x == '?' && y == '?')) {
+                add_to_zip(e.path);
+            }
+        }
+        for (const auto& r : renames) {
+            if (fs::exists(r.second)) {
+                add_to_zip(r.second);
+            }
+        }
+        changes.deletes_for_manifest = std::move(deleted_paths);
+        for (const auto& r : renames) {
+            changes.deletes_for_manifest.push_back(r.first);
+        }
+        if (changes.files_to_zip.empty() && changes.deletes_for_manifest.empty()) {
+            throw GitsError(GITS_ERR_NO_CHANGES, "No changes found.");
+        }
+    }
+
+    // Deduplicate
+    sort_unique(changes.files_to_zip);
+    sort_unique(changes.deletes_for_manifest);
+
+    return changes;
+}
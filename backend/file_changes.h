@@ -0,0 +1,29 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "git_repo.h"
+
+// Struct for a file shipped by content hash instead of inside the zip
+struct BlobRef {
+    std::string path;
+    std::string sha256;
+    std::string mode;
+};
+
+// Struct for file changes
+struct FileChanges {
+    std::vector<std::string> files_to_zip;
+    std::vector<std::string> deletes_for_manifest;
+    std::vector<BlobRef> blobs_for_manifest;
+    // Hex SHA-256 of the files hashed so far, by path, so no file is read
+    // for its digest twice (see changed_file_sha256 in commands.cpp)
+    std::map<std::string, std::string> sha256_by_path;
+};
+
+// Function to gather file changes from a status listing, restricted to
+// specified_files when given. Throws GitsError for unknown files or when
+// nothing changed. Runs in time linear in the number of paths.
+FileChanges gather_file_changes(const std::vector<StatusEntry>& status, const std::vector<std::string>& specified_files);
@@ -0,0 +1,526 @@
+#include "git_repo.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#ifdef GITS_HAVE_LIBGIT2
+#include <thread>
+#include <git2.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const BUNDLE_REF = "refs/gits/changes";
+
+std::string shell_quote(const std::string& s) {
+    std::string out = "'";
+    for (char c : s) {
+        if (c == '\'') out += "'\\''";
+        else out += c;
+    }
+    return out + "'";
+}
+
+// Run a git command, passing standard output to sink (discarded when null).
+// env is an optional prefix of VAR=value assignments. True on exit status 0.
+template <typename Sink>
+bool run_git_to(const std::string& args, Sink* sink, const std::string& env = "") {
+    std::string cmd = (env.empty() ? "" : env + " ") + "git " + args + (sink ? " 2>/dev/null" : " >/dev/null 2>&1");
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) {
+        throw std::runtime_error("popen() failed!");
+    }
+    std::array<char, 64 * 1024> buffer;
+    size_t n;
+    while ((n = fread(buffer.data(), 1, buffer.size(), pipe)) > 0) {
+        if (sink) (*sink)(buffer.data(), n);
+    }
+    return pclose(pipe) == 0;
+}
+
+// Run a git command, capturing standard output into out when given
+bool run_git(const std::string& args, std::string* out = nullptr, const std::string& env = "") {
+    auto append = [out](const char* data, size_t n) { out->append(data, n); };
+    return run_git_to(args, out ? &append : nullptr, env);
+}
+
+// Run a git command and return its first output line
+bool git_line(const std::string& args, std::string& line, const std::string& env = "") {
+    line.clear();
+    if (!run_git(args, &line, env)) return false;
+    line.erase(std::min(line.find('\n'), line.size()));
+    return !line.empty();
+}
+
+// Stream `git status --porcelain=v2 -z` through the parser
+std::vector<StatusEntry> cli_status() {
+    StatusParser parser;
+    auto feed = [&parser](const char* data, size_t n) { parser.feed(data, n); };
+    run_git_to("status --porcelain=v2 -z -M -uall", &feed);
+    return std::move(parser.entries());
+}
+
+#ifdef GITS_HAVE_LIBGIT2
+
+struct Libgit2 {
+    Libgit2() { git_libgit2_init(); }
+    ~Libgit2() { git_libgit2_shutdown(); }
+};
+
+void ensure_libgit2() {
+    static Libgit2 instance;
+}
+
+// Owning handles for libgit2 objects
+struct RepoHandle {
+    git_repository* repo = nullptr;
+    ~RepoHandle() { if (repo) git_repository_free(repo); }
+};
+
+struct StatusListHandle {
+    git_status_list* list = nullptr;
+    ~StatusListHandle() { if (list) git_status_list_free(list); }
+};
+
+void check(int rc, const char* what) {
+    if (rc < 0) {
+        const git_error* err = git_error_last();
+        throw std::runtime_error(std::string(what) + ": " + (err && err->message ? err->message : "unknown error"));
+    }
+}
+
+// Discover the repository containing the current directory
+bool open_repo(RepoHandle& handle, const char* path = ".") {
+    ensure_libgit2();
+    return git_repository_open_ext(&handle.repo, path, 0, nullptr) == 0;
+}
+
+char index_code(unsigned int status) {
+    if (status & GIT_STATUS_INDEX_NEW) return 'A';
+    if (status & GIT_STATUS_INDEX_MODIFIED) return 'M';
+    if (status & GIT_STATUS_INDEX_DELETED) return 'D';
+    if (status & GIT_STATUS_INDEX_RENAMED) return 'R';
+    if (status & GIT_STATUS_INDEX_TYPECHANGE) return 'T';
+    return ' ';
+}
+
+char worktree_code(unsigned int status) {
+    if (status & GIT_STATUS_WT_MODIFIED) return 'M';
+    if (status & GIT_STATUS_WT_DELETED) return 'D';
+    if (status & GIT_STATUS_WT_RENAMED) return 'R';
+    if (status & GIT_STATUS_WT_TYPECHANGE) return 'T';
+    return ' ';
+}
+
+// Run one status query and hand each entry to `visit`
+template <typename Visit>
+void run_status(git_repository* repo, git_status_show_t show, unsigned int flags,
+                const std::vector<std::string>& pathspec, Visit visit) {
+    git_status_options opts = GIT_STATUS_OPTIONS_INIT;
+    opts.show = show;
+    opts.flags = flags;
+    std::vector<char*> strings;
+    for (const auto& p : pathspec) strings.push_back(const_cast<char*>(p.c_str()));
+    opts.pathspec.strings = strings.data();
+    opts.pathspec.count = strings.size();
+
+    StatusListHandle status;
+    check(git_status_list_new(&status.list, repo, &opts), "git status");
+    size_t count = git_status_list_entrycount(status.list);
+    for (size_t i = 0; i < count; ++i) {
+        visit(git_status_byindex(status.list, i));
+    }
+}
+
+// Split the top level of the work tree into at most `threads` pathspec
+// shards. The names come from both the directory and the index, so a
+// top-level file or directory that was deleted still falls in a shard.
+// Returns a single empty shard (the whole tree) when splitting is not
+// worthwhile or a name would be read as a glob.
+std::vector<std::vector<std::string>> shard_worktree(git_repository* repo, const std::string& workdir,
+                                                     unsigned threads) {
+    std::vector<std::vector<std::string>> shards(1);
+    if (threads < 2) return shards;
+
+    std::set<std::string> unique;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(workdir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name != ".git") unique.insert(std::move(name));
+    }
+    if (ec) return shards;
+
+    git_index* index = nullptr;
+    if (git_repository_index(&index, repo) != 0) return shards;
+    size_t count = git_index_entrycount(index);
+    for (size_t i = 0; i < count; ++i) {
+        const char* path = git_index_get_byindex(index, i)->path;
+        const char* slash = std::strchr(path, '/');
+        unique.emplace(path, slash ? slash - path : std::strlen(path));
+    }
+    git_index_free(index);
+
+    std::vector<std::string> names(unique.begin(), unique.end());
+    for (const auto& name : names) {
+        if (name.find_first_of("*?[\\") != std::string::npos) return shards;
+    }
+    if (names.size() < 2) return shards;
+
+    shards.assign(std::min<size_t>(threads, names.size()), {});
+    for (size_t i = 0; i < names.size(); ++i) {
+        shards[i % shards.size()].push_back(names[i]);
+    }
+    return shards;
+}
+
+// In-process status. HEAD-to-index (which only reads the index and trees)
+// runs once with rename detection, like `git status -M`. The work tree scan,
+// which dominates on large checkouts, is split into shards that each use
+// their own repository handle. Unchanged files are skipped using the stat
+// data cached in the index; with a single shard, entries whose cache was
+// refreshed are written back so later runs stay on the fast path.
+std::vector<StatusEntry> libgit2_status(unsigned threads) {
+    RepoHandle handle;
+    if (!open_repo(handle)) {
+        throw std::runtime_error("libgit2 could not open the repository");
+    }
+    const char* workdir = git_repository_workdir(handle.repo);
+    if (!workdir) {
+        throw std::runtime_error("Repository has no work tree");
+    }
+
+    std::map<std::string, StatusEntry> entries;
+    run_status(handle.repo, GIT_STATUS_SHOW_INDEX_ONLY, GIT_STATUS_OPT_RENAMES_HEAD_TO_INDEX, {},
+               [&](const git_status_entry* s) {
+        const git_diff_delta* d = s->head_to_index;
+        if (!d) return;
+        StatusEntry& e = entries[d->new_file.path];
+        e.path = d->new_file.path;
+        e.index_status = index_code(s->status);
+        if (s->status & GIT_STATUS_INDEX_RENAMED) e.orig_path = d->old_file.path;
+    });
+
+    auto shards = shard_worktree(handle.repo, workdir, threads);
+    unsigned int flags = GIT_STATUS_OPT_INCLUDE_UNTRACKED | GIT_STATUS_OPT_RECURSE_UNTRACKED_DIRS;
+    if (shards.size() == 1) flags |= GIT_STATUS_OPT_UPDATE_INDEX;
+
+    std::vector<std::vector<std::pair<std::string, unsigned int>>> results(shards.size());
+    std::vector<std::string> errors(shards.size());
+    auto scan = [&](size_t i) {
+        try {
+            RepoHandle shard_handle;
+            if (!open_repo(shard_handle, workdir)) {
+                throw std::runtime_error("libgit2 could not open the repository");
+            }
+            run_status(shard_handle.repo, GIT_STATUS_SHOW_WORKDIR_ONLY, flags, shards[i],
+                       [&](const git_status_entry* s) {
+                const git_diff_delta* d = s->index_to_workdir;
+                if (!d) return;
+                results[i].emplace_back(d->old_file.path ? d->old_file.path : d->new_file.path, s->status);
+            });
+        } catch (const std::exception& ex) {
+            errors[i] = ex.what();
+        }
+    };
+    if (shards.size() == 1) {
+        scan(0);
+    } else {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < shards.size(); ++i) workers.emplace_back(scan, i);
+        for (auto& w : workers) w.join();
+    }
+    for (const auto& err : errors) {
+        if (!err.empty()) throw std::runtime_error(err);
+    }
+
+    for (const auto& shard : results) {
+        for (const auto& r : shard) {
+            StatusEntry& e = entries[r.first];
+            e.path = r.first;
+            if ((r.second & GIT_STATUS_WT_NEW) && e.index_status == ' ') {
+                e.index_status = '?';
+                e.worktree_status = '?';
+            } else {
+                e.worktree_status = worktree_code(r.second);
+            }
+        }
+    }
+
+    std::vector<StatusEntry> out;
+    out.reserve(entries.size());
+    for (auto& kv : entries) {
+        if (kv.second.index_status == ' ' && kv.second.worktree_status == ' ') continue;
+        out.push_back(std::move(kv.second));
+    }
+    return out;
+}
+
+// Work tree status of the given root-relative paths, matched literally
+std::vector<StatusEntry> libgit2_worktree_status(const std::vector<std::string>& paths) {
+    RepoHandle handle;
+    if (!open_repo(handle)) {
+        throw std::runtime_error("libgit2 could not open the repository");
+    }
+    std::vector<StatusEntry> out;
+    unsigned int flags = GIT_STATUS_OPT_INCLUDE_UNTRACKED | GIT_STATUS_OPT_RECURSE_UNTRACKED_DIRS | GIT_STATUS_OPT_DISABLE_PATHSPEC_MATCH;
+    run_status(handle.repo, GIT_STATUS_SHOW_WORKDIR_ONLY, flags, paths, [&](const git_status_entry* s) {
+        const git_diff_delta* d = s->index_to_workdir;
+        if (!d) return;
+        StatusEntry e;
+        e.path = d->old_file.path ? d->old_file.path : d->new_file.path;
+        if (s->status & GIT_STATUS_WT_NEW) {
+            e.index_status = '?';
+            e.worktree_status = '?';
+        } else {
+            e.worktree_status = worktree_code(s->status);
+        }
+        if (e.worktree_status != ' ') out.push_back(std::move(e));
+    });
+    return out;
+}
+
+#endif
+
+// Work tree status of the given root-relative paths through the git command
+// line. git status has no --pathspec-from-file, so the paths go on the
+// command line in batches that stay well below the argument limit.
+std::vector<StatusEntry> cli_worktree_status(const std::vector<std::string>& paths) {
+    const size_t MAX_ARGS_SIZE = 64 * 1024;
+    StatusParser parser;
+    auto feed = [&parser](const char* data, size_t n) { parser.feed(data, n); };
+    for (size_t i = 0; i < paths.size();) {
+        std::string args;
+        while (i < paths.size() && (args.empty() || args.size() + paths[i].size() < MAX_ARGS_SIZE)) {
+            args += " " + shell_quote(":(top,literal)" + paths[i++]);
+        }
+        if (!run_git_to("status --porcelain=v2 -z --no-renames -uall --" + args, &feed)) {
+            throw std::runtime_error("git status failed");
+        }
+    }
+    std::vector<StatusEntry> out;
+    for (auto& e : parser.entries()) {
+        if (e.index_status != '?') e.index_status = ' ';
+        if (e.worktree_status != ' ') out.push_back(std::move(e));
+    }
+    return out;
+}
+
+}  // namespace
+
+void StatusParser::feed(const char* data, size_t len) {
+    const char* end = data + len;
+    while (data < end) {
+        const char* nul = static_cast<const char*>(std::memchr(data, '\0', end - data));
+        if (!nul) {
+            partial_.append(data, end - data);
+            return;
+        }
+        if (partial_.empty()) {
+            record(data, nul - data);
+        } else {
+            partial_.append(data, nul - data);
+            record(partial_.data(), partial_.size());
+            partial_.clear();
+        }
+        data = nul + 1;
+    }
+}
+
+// One NUL-terminated record: "1 XY <6 fields> path", "2 XY <7 fields> path"
+// followed by an origPath record, "u XY <8 fields> path" or "? path"
+void StatusParser::record(const char* rec, size_t len) {
+    if (expect_orig_) {
+        expect_orig_ = false;
+        if (!entries_.empty()) entries_.back().orig_path.assign(rec, len);
+        return;
+    }
+    if (len < 3) return;
+
+    int fields = 0;
+    switch (rec[0]) {
+        case '?': {
+            StatusEntry e;
+            e.index_status = e.worktree_status = '?';
+            e.path.assign(rec + 2, len - 2);
+            entries_.push_back(std::move(e));
+            return;
+        }
+        case '1': fields = 8; break;
+        case '2': fields = 9; break;
+        case 'u': fields = 10; break;
+        default: return;  // headers, ignored files
+    }
+
+    size_t pos = 0;
+    for (int spaces = 0; pos < len && spaces < fields; ++pos) {
+        if (rec[pos] == ' ') ++spaces;
+    }
+    if (pos >= len || len < 4) return;
+
+    StatusEntry e;
+    e.index_status = rec[2] == '.' ? ' ' : rec[2];
+    e.worktree_status = rec[3] == '.' ? ' ' : rec[3];
+    e.path.assign(rec + pos, len - pos);
+    entries_.push_back(std::move(e));
+    expect_orig_ = rec[0] == '2';
+}
+
+bool repo_exists() {
+#ifdef GITS_HAVE_LIBGIT2
+    RepoHandle handle;
+    if (open_repo(handle)) return true;
+#endif
+    return run_git("rev-parse --git-dir");
+}
+
+bool repo_is_inside_work_tree() {
+#ifdef GITS_HAVE_LIBGIT2
+    RepoHandle handle;
+    if (open_repo(handle)) {
+        const char* workdir = git_repository_workdir(handle.repo);
+        if (!workdir) return false;
+        std::error_code ec;
+        auto rel = fs::relative(fs::current_path(), workdir, ec);
+        return !ec && !rel.empty() && *rel.begin() != ".." && *rel.begin() != ".git";
+    }
+#endif
+    return run_git("rev-parse --is-inside-work-tree");
+}
+
+bool repo_remote_url(const std::string& remote, std::string& url) {
+#ifdef GITS_HAVE_LIBGIT2
+    RepoHandle handle;
+    if (open_repo(handle)) {
+        git_remote* r = nullptr;
+        if (git_remote_lookup(&r, handle.repo, remote.c_str()) != 0) return false;
+        const char* remote_url = git_remote_url(r);
+        url = remote_url ? remote_url : "";
+        git_remote_free(r);
+        return !url.empty();
+    }
+#endif
+    return git_line("remote get-url " + shell_quote(remote), url);
+}
+
+std::vector<StatusEntry> repo_status(unsigned threads) {
+#ifdef GITS_HAVE_LIBGIT2
+    try {
+        return libgit2_status(threads);
+    } catch (const std::exception&) {
+        // e.g. repository extensions libgit2 does not support; git handles those
+    }
+#else
+    (void)threads;
+#endif
+    return cli_status();
+}
+
+std::string repo_root() {
+#ifdef GITS_HAVE_LIBGIT2
+    RepoHandle handle;
+    if (open_repo(handle)) {
+        const char* workdir = git_repository_workdir(handle.repo);
+        if (!workdir) return "";
+        return fs::path(workdir).lexically_normal().string();
+    }
+#endif
+    std::string root;
+    if (!git_line("rev-parse --show-toplevel", root)) return "";
+    return (fs::path(root) / "").string();
+}
+
+std::vector<StatusEntry> repo_worktree_status(const std::vector<std::string>& paths) {
+    if (paths.empty()) return {};
+#ifdef GITS_HAVE_LIBGIT2
+    try {
+        return libgit2_worktree_status(paths);
+    } catch (const std::exception&) {
+    }
+#endif
+    return cli_worktree_status(paths);
+}
+
+std::set<std::string> repo_ignored_dirs(const std::string& root, const std::string& dir) {
+    std::string out;
+    std::string args = "-C " + shell_quote(root) + " ls-files -z --others --ignored --exclude-standard --directory";
+    if (!dir.empty()) args += " -- " + shell_quote(":(top,literal)" + dir);
+    std::set<std::string> dirs;
+    if (!run_git(args, &out)) return dirs;
+    for (size_t start = 0; start < out.size();) {
+        size_t end = std::min(out.find('\0', start), out.size());
+        if (end > start && out[end - 1] == '/') dirs.emplace(out, start, end - start);
+        start = end + 1;
+    }
+    return dirs;
+}
+
+std::string repo_create_bundle(const std::vector<std::string>& paths, const std::string& message,
+                               const std::string& bundle_path) {
+    // Stage into a throwaway index seeded from HEAD, so the user's index and
+    // branch are left exactly as they were
+    fs::path tmp = fs::temp_directory_path();
+    std::string stamp = std::to_string(::getpid());
+    fs::path index = tmp / ("gits-index-" + stamp);
+    fs::path pathspec = tmp / ("gits-pathspec-" + stamp);
+    fs::path message_file = tmp / ("gits-message-" + stamp);
+    struct Cleanup {
+        std::vector<fs::path> files;
+        ~Cleanup() {
+            std::error_code ec;
+            for (const auto& f : files) fs::remove(f, ec);
+        }
+    } cleanup{{index, pathspec, message_file}};
+    std::string env = "GIT_INDEX_FILE=" + shell_quote(index.string());
+
+    {
+        std::ofstream spec(pathspec, std::ios::binary);
+        for (const auto& p : paths) spec << p << '\0';
+        std::ofstream msg(message_file, std::ios::binary);
+        msg << message << '\n';
+        if (!spec || !msg) throw std::runtime_error("Failed to write temporary files for the bundle");
+    }
+
+    std::string head, tree, commit, base;
+    if (!git_line("rev-parse --verify HEAD", head)) {
+        throw std::runtime_error("The repository has no commits to build on");
+    }
+    if (!run_git("read-tree HEAD", nullptr, env) ||
+        !run_git("add -A --pathspec-from-file=" + shell_quote(pathspec.string()) + " --pathspec-file-nul", nullptr, env)) {
+        throw std::runtime_error("Failed to stage changes for the bundle");
+    }
+    if (!git_line("write-tree", tree, env) ||
+        !git_line("commit-tree " + tree + " -p " + head + " -F " + shell_quote(message_file.string()), commit)) {
+        throw std::runtime_error("Failed to create the commit (is user.name/user.email set?)");
+    }
+
+    // Thin against what the remote already has; a full bundle otherwise
+    std::string range = BUNDLE_REF;
+    for (const char* ref : {"refs/remotes/origin/main", "refs/remotes/origin/HEAD"}) {
+        if (git_line("rev-parse --verify -q " + std::string(ref) + "^{commit}", base)) {
+            range += " ^" + base;
+            break;
+        }
+    }
+
+    if (!run_git(std::string("update-ref ") + BUNDLE_REF + " " + commit)) {
+        throw std::runtime_error("Failed to create " + std::string(BUNDLE_REF));
+    }
+    bool bundled = run_git("bundle create -q " + shell_quote(bundle_path) + " " + range);
+    run_git(std::string("update-ref -d ") + BUNDLE_REF);
+    if (!bundled) {
+        throw std::runtime_error("git bundle create failed");
+    }
+    return commit;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+// Struct for one path reported by git status, using porcelain-style codes
+struct StatusEntry {
+    char index_status = ' ';     // X column: ' ', 'M', 'A', 'D', 'R', 'T' or '?'
+    char worktree_status = ' ';  // Y column
+    std::string path;
+    std::string orig_path;       // rename source, empty otherwise
+};
+
+// Incremental parser for `git status --porcelain=v2 -z` output. Records
+// are decoded as bytes arrive; only a partial trailing record is buffered.
+class StatusParser {
+public:
+    void feed(const char* data, size_t len);
+    std::vector<StatusEntry>& entries() { return entries_; }
+
+private:
+    void record(const char* rec, size_t len);
+
+    std::string partial_;
+    bool expect_orig_ = false;
+    std::vector<StatusEntry> entries_;
+};
+
+// Repository access. With libgit2 compiled in (GITS_HAVE_LIBGIT2) everything
+// runs in-process; otherwise, or when libgit2 cannot open the repository, the
+// git command line is used.
+
+// Function to check that the current directory is inside a git repository
+bool repo_exists();
+
+// Function to check that the current directory is inside a work tree
+bool repo_is_inside_work_tree();
+
+// Function to look up a remote's URL; returns false if it is not configured
+bool repo_remote_url(const std::string& remote, std::string& url);
+
+// Function to list changed, deleted, renamed and untracked paths (untracked
+// directories are expanded), scanning the work tree on up to `threads` threads
+std::vector<StatusEntry> repo_status(unsigned threads);
+
+// Function to get the root of the current work tree, or empty outside one
+std::string repo_root();
+
+// Function to get the work tree status of just the given paths (relative to
+// the root) against the index: worktree_status is set, and untracked paths
+// are reported as "??". Paths without changes are left out.
+std::vector<StatusEntry> repo_worktree_status(const std::vector<std::string>& paths);
+
+// Function to list the ignored directories at or below dir (root-relative,
+// empty for the whole tree) of the work tree at root, root-relative with a
+// trailing slash. Directories holding tracked files are not ignored, and
+// nothing inside a listed directory is listed. Uses the git command line.
+std::set<std::string> repo_ignored_dirs(const std::string& root, const std::string& dir);
+
+// Function to commit the given paths' work tree state on top of HEAD without
+// touching the index or branch, and write that commit to a git bundle under
+// refs/gits/changes. The bundle leaves out history the remote-tracking branch
+// already has. Returns the commit id; throws std::runtime_error on failure.
+std::string repo_create_bundle(const std::vector<std::string>& paths, const std::string& message,
+                               const std::string& bundle_path);
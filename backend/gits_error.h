@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include "libgits.h"
+
+// Class for a failed operation; code() is the libgits error code and what()
+// is the message the CLI prints after "Error: "
+class GitsError : public std::runtime_error {
+public:
+    GitsError(gits_error code, const std::string& message) : std::runtime_error(message), code_(code) {}
+    gits_error code() const { return code_; }
+
+private:
+    gits_error code_;
+};
@@ -0,0 +1,198 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <nlohmann/json.hpp>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "change_tracker.h"
+#include "commands.h"
+#include "git_repo.h"
+#include "gitsd_client.h"
+#include "http_client.h"
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+namespace {
+
+// A client has this long to send its request
+const int REQUEST_TIMEOUT_SECONDS = 5;
+
+volatile std::sig_atomic_t stopping = 0;
+
+void handle_stop(int) {
+    stopping = 1;
+}
+
+bool send_line(int fd, const json& message) {
+    std::string line = message.dump() + "\n";
+    size_t sent = 0;
+    while (sent < line.size()) {
+        ssize_t n = ::send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Function to read the request line of a client, or an empty string
+std::string read_request(int fd) {
+    timeval timeout{REQUEST_TIMEOUT_SECONDS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string line;
+    char chunk[4096];
+    while (line.find('\n') == std::string::npos && line.size() < 1024 * 1024) {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return "";
+        line.append(chunk, static_cast<size_t>(n));
+    }
+    return line.substr(0, line.find('\n'));
+}
+
+// Function to run one schedule for a client. The status comes from the
+// tracker, so only paths written since the last schedule are checked.
+void serve_schedule(int fd, const json& request, ChangeTracker& tracker) {
+    set_notice_handler([fd](const std::string& line) { send_line(fd, {{"notice", line}}); });
+    try {
+        ScheduleOptions options;
+        options.repo_path = request.at("cwd").get<std::string>();
+        options.schedule_time = request.at("schedule_time").get<std::string>();
+        options.commit_message = request.value("message", "");
+        options.files = request.value("files", std::vector<std::string>());
+        options.mode = request.value("mode", "zip");
+        options.status = [&tracker](unsigned threads) { return tracker.status(repo_root(), threads); };
+
+        // Settings are read again for every schedule, so edits apply without a restart
+        Config config = load_config();
+        http_retry_restart();
+        ScheduleResult result = schedule_changes(config, options);
+        send_line(fd, {{"result", {{"job_id", result.job_id},
+                                   {"schedule_time", result.schedule_time},
+                                   {"cron_expression", result.cron_expression},
+                                   {"duplicate", result.duplicate}}}});
+    } catch (const GitsError& e) {
+        send_line(fd, {{"error", {{"code", e.code()}, {"message", e.what()}}}});
+    } catch (const json::exception& e) {
+        send_line(fd, {{"error", {{"code", GITS_ERR_INVALID}, {"message", std::string("Bad request: ") + e.what()}}}});
+    } catch (const std::exception& e) {
+        send_line(fd, {{"error", {{"code", GITS_ERR_INTERNAL}, {"message", e.what()}}}});
+    }
+    set_notice_handler(nullptr);
+}
+
+void serve_client(int fd, ChangeTracker& tracker) {
+    json request = json::parse(read_request(fd), nullptr, false);
+    if (request.is_discarded() || !request.is_object()) return;
+    std::string command = request.value("command", "");
+    if (command == "schedule") {
+        serve_schedule(fd, request, tracker);
+    } else {
+        send_line(fd, {{"error", {{"code", GITS_ERR_INVALID}, {"message", "unknown gitsd command: " + command}}}});
+    }
+}
+
+// Function to bind the socket, refusing to replace a live daemon's
+int listen_socket(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("socket path is too long: " + path);
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        ::close(fd);
+        throw std::runtime_error("gitsd is already running on " + path);
+    }
+    ::unlink(path.c_str());
+    mode_t old_mask = ::umask(077);
+    int rc = ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    ::umask(old_mask);
+    if (rc != 0 || ::listen(fd, 16) != 0) {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("cannot listen on " + path + ": " + error);
+    }
+    return fd;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        std::string arg = argv[1];
+        std::ostream& out = arg == "-h" || arg == "--help" ? std::cout : std::cerr;
+        out << "Usage: gitsd" << std::endl;
+        out << "Runs in the foreground, serving gits schedule for this user on " << gitsd_socket_path() << "." << std::endl;
+        out << "Stop it with SIGTERM or Ctrl-C." << std::endl;
+        return arg == "-h" || arg == "--help" ? 0 : 2;
+    }
+
+    std::string path = gitsd_socket_path();
+    int listen_fd;
+    try {
+        Config config = load_config();
+        http_init(config);
+        fs::create_directories(fs::path(path).parent_path());
+        listen_fd = listen_socket(path);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<ChangeTracker> tracker;
+    try {
+        tracker.reset(new ChangeTracker());
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        ::unlink(path.c_str());
+        return 1;
+    }
+
+    struct sigaction action{};
+    action.sa_handler = handle_stop;
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+    set_notice_handler(nullptr);
+    std::cout << "gitsd: listening on " << path << std::endl;
+
+    while (!stopping) {
+        pollfd fds[2] = {{listen_fd, POLLIN, 0}, {tracker->fd(), POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: poll: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            tracker->drain();
+        }
+        if (fds[0].revents & POLLIN) {
+            int client = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) continue;
+            serve_client(client, *tracker);
+            ::close(client);
+        }
+    }
+
+    ::close(listen_fd);
+    ::unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "gitsd_client.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include <nlohmann/json.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// macOS has no MSG_NOSIGNAL; a daemon dying mid-request is rare enough there
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+namespace {
+
+// Owning socket descriptor
+struct Socket {
+    int fd = -1;
+    ~Socket() { if (fd >= 0) ::close(fd); }
+};
+
+bool send_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}  // namespace
+
+std::string gitsd_socket_path() {
+    const char* home = std::getenv("HOME");
+    return (fs::path(home ? home : "") / ".gits" / "gitsd.sock").string();
+}
+
+bool gitsd_schedule(const ScheduleOptions& options, ScheduleResult& result) {
+    std::string path = gitsd_socket_path();
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    Socket sock;
+    sock.fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock.fd < 0) return false;
+    if (::connect(sock.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        // No daemon, or a socket left behind by one that died
+        return false;
+    }
+
+    json request = {
+        {"command", "schedule"},
+        {"cwd", options.repo_path.empty() ? fs::current_path().string() : fs::absolute(options.repo_path).string()},
+        {"schedule_time", options.schedule_time},
+        {"message", options.commit_message},
+        {"files", options.files},
+        {"mode", options.mode}
+    };
+    if (!send_all(sock.fd, request.dump() + "\n")) return false;
+
+    std::string buffer;
+    char chunk[4096];
+    for (;;) {
+        size_t newline;
+        while ((newline = buffer.find('\n')) != std::string::npos) {
+            json reply = json::parse(buffer.substr(0, newline), nullptr, false);
+            buffer.erase(0, newline + 1);
+            if (reply.is_discarded() || !reply.is_object()) {
+                throw GitsError(GITS_ERR_PROTOCOL, "gitsd sent an answer that could not be parsed");
+            }
+            if (reply.contains("notice")) {
+                notice(reply.value("notice", ""));
+            } else if (reply.contains("error")) {
+                const json& error = reply["error"];
+                throw GitsError(static_cast<gits_error>(error.value("code", static_cast<int>(GITS_ERR_INTERNAL))), error.value("message", ""));
+            } else if (reply.contains("result")) {
+                const json& r = reply["result"];
+                result.job_id = r.value("job_id", "");
+                result.schedule_time = r.value("schedule_time", "");
+                result.cron_expression = r.value("cron_expression", "");
+                result.duplicate = r.value("duplicate", false);
+                return true;
+            }
+        }
+        ssize_t n = ::recv(sock.fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            throw GitsError(GITS_ERR_INTERNAL, "gitsd closed the connection before answering");
+        }
+        buffer.append(chunk, static_cast<size_t>(n));
+    }
+}
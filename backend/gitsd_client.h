@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include "commands.h"
+
+// gitsd is an optional per-user daemon (gitsd.cpp) that keeps the status of
+// the repositories it has seen up to date with inotify and holds its HTTP
+// connections open. The CLI hands schedules to it over a Unix socket and
+// falls back to scheduling in-process when no daemon answers.
+//
+// The protocol is one JSON object per line. The client sends
+// {"command": "schedule", "cwd", "schedule_time", "message", "files", "mode"};
+// the daemon answers with any number of {"notice": line} objects and then
+// {"result": {"job_id", "schedule_time", "cron_expression", "duplicate"}} or
+// {"error": {"code", "message"}}.
+
+// Function to get the path of gitsd's socket, ~/.gits/gitsd.sock
+std::string gitsd_socket_path();
+
+// Function to hand a schedule to a running gitsd, from the current directory
+// unless options.repo_path is set. Returns false when no daemon is listening;
+// throws GitsError for failures the daemon reports. Notices are passed on
+// through notice().
+bool gitsd_schedule(const ScheduleOptions& options, ScheduleResult& result);
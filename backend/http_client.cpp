@@ -0,0 +1,416 @@
+#include "http_client.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "commands.h"
+#include "gits_error.h"
+#include "trace.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Cached addresses are trusted for this long before a real lookup is made again
+const long long DNS_CACHE_TTL_SECONDS = 300;
+
+// Retry backoff doubles from the base up to the cap; each delay is drawn from
+// the upper half of that window so concurrent clients spread out
+const std::chrono::milliseconds RETRY_BASE_DELAY(250);
+const std::chrono::milliseconds RETRY_MAX_DELAY(8000);
+const long long DEFAULT_RETRY_DEADLINE_SECONDS = 60;
+
+struct CachedAddress {
+    std::string ip;
+    long long stored_at = 0;
+};
+
+// Struct for the network time spent by one command
+struct NetworkStats {
+    unsigned requests = 0;
+    unsigned http2_requests = 0;
+    long connections = 0;
+    curl_off_t dns_us = 0;
+    curl_off_t connect_us = 0;
+    curl_off_t tls_us = 0;
+    curl_off_t total_us = 0;
+};
+
+struct HttpState {
+    CURLSH* share = nullptr;
+    std::mutex share_locks[CURL_LOCK_DATA_LAST];
+    std::mutex mutex;  // guards everything below
+    fs::path dns_cache_path;
+    std::map<std::string, CachedAddress> dns_cache;  // "host:port" -> address
+    bool dns_cache_dirty = false;
+    curl_slist* resolve = nullptr;                   // dns_cache as CURLOPT_RESOLVE entries
+    std::vector<curl_slist*> retired_resolve;        // may still be set on live handles
+    bool report = false;
+    NetworkStats stats;
+    std::chrono::seconds retry_window{DEFAULT_RETRY_DEADLINE_SECONDS};
+    std::mt19937 jitter{std::random_device{}()};
+};
+
+HttpState* state = nullptr;
+
+// The retry deadline belongs to the thread making the call, so calls running
+// side by side (libgits clients, gitsd connections) keep their own windows.
+// Unset until the thread's first restart or retry.
+thread_local std::chrono::steady_clock::time_point retry_deadline;
+
+std::chrono::steady_clock::time_point next_retry_deadline() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return std::chrono::steady_clock::now() + state->retry_window;
+}
+
+long long unix_now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void share_lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+    static_cast<HttpState*>(userptr)->share_locks[data].lock();
+}
+
+void share_unlock(CURL*, curl_lock_data data, void* userptr) {
+    static_cast<HttpState*>(userptr)->share_locks[data].unlock();
+}
+
+// Rebuild the CURLOPT_RESOLVE list from the cache; caller holds the mutex
+void rebuild_resolve_list() {
+    if (state->resolve) state->retired_resolve.push_back(state->resolve);
+    state->resolve = nullptr;
+    for (const auto& entry : state->dns_cache) {
+        const std::string& ip = entry.second.ip;
+        std::string line = entry.first + ":" + (ip.find(':') != std::string::npos ? "[" + ip + "]" : ip);
+        state->resolve = curl_slist_append(state->resolve, line.c_str());
+    }
+}
+
+// Each line of ~/.gits/dns-cache is "<host>:<port> <ip> <stored_at>"
+void load_dns_cache() {
+    std::ifstream in(state->dns_cache_path);
+    std::string line;
+    long long now = unix_now();
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string host_port;
+        CachedAddress address;
+        if (!(fields >> host_port >> address.ip >> address.stored_at)) continue;
+        if (now - address.stored_at >= DNS_CACHE_TTL_SECONDS) continue;
+        state->dns_cache[host_port] = address;
+    }
+    rebuild_resolve_list();
+}
+
+void save_dns_cache() {
+    std::error_code ec;
+    fs::create_directories(state->dns_cache_path.parent_path(), ec);
+    fs::path tmp = state->dns_cache_path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (const auto& entry : state->dns_cache) {
+            out << entry.first << " " << entry.second.ip << " " << entry.second.stored_at << "\n";
+        }
+        if (!out) return;
+    }
+    fs::rename(tmp, state->dns_cache_path, ec);
+}
+
+// Function to get "host:port" of the URL a handle last used
+std::string handle_host_port(CURL* curl) {
+    char* url = nullptr;
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+    if (!url) return "";
+    std::unique_ptr<CURLU, void(*)(CURLU*)> parsed(curl_url(), curl_url_cleanup);
+    if (curl_url_set(parsed.get(), CURLUPART_URL, url, 0) != CURLUE_OK) return "";
+    char* host = nullptr;
+    char* port = nullptr;
+    std::string result;
+    // IPv6 literals come back bracketed and need no lookup
+    if (curl_url_get(parsed.get(), CURLUPART_HOST, &host, 0) == CURLUE_OK && host[0] != '[' &&
+        curl_url_get(parsed.get(), CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) == CURLUE_OK) {
+        result = std::string(host) + ":" + port;
+    }
+    curl_free(host);
+    curl_free(port);
+    return result;
+}
+
+// Function to get the URL a handle last used, without its query (for
+// pre-signed URLs that is the signature), and the URL's path
+void handle_url_and_path(CURL* curl, std::string& url, std::string& path) {
+    char* effective = nullptr;
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective);
+    if (!effective) return;
+    std::unique_ptr<CURLU, void(*)(CURLU*)> parsed(curl_url(), curl_url_cleanup);
+    if (curl_url_set(parsed.get(), CURLUPART_URL, effective, 0) != CURLUE_OK) return;
+    curl_url_set(parsed.get(), CURLUPART_QUERY, nullptr, 0);
+    char* part = nullptr;
+    if (curl_url_get(parsed.get(), CURLUPART_URL, &part, 0) == CURLUE_OK) url = part;
+    curl_free(part);
+    part = nullptr;
+    if (curl_url_get(parsed.get(), CURLUPART_PATH, &part, 0) == CURLUE_OK) path = part;
+    curl_free(part);
+}
+
+// Function to add a finished request to the trace. curl reports each step as
+// time since the request started; "wait" runs from the connection being ready
+// until the first response byte, so it includes sending the body.
+void trace_http(CURL* curl) {
+    curl_off_t dns = 0, connect = 0, tls = 0, first_byte = 0, total = 0, sent = 0, received = 0;
+    long http_code = 0, connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &sent);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &received);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    std::string method = "HTTP";
+#if LIBCURL_VERSION_NUM >= 0x074800
+    char* effective_method = nullptr;
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_METHOD, &effective_method);
+    if (effective_method) method = effective_method;
+#endif
+    std::string url, path = "/";
+    handle_url_and_path(curl, url, path);
+
+    auto end = TraceClock::now();
+    auto start = end - std::chrono::microseconds(total);
+    auto at = [&](curl_off_t us) { return start + std::chrono::microseconds(us); };
+    std::vector<TraceInterval> steps;
+    curl_off_t ready = 0;
+    auto step = [&](const char* name, curl_off_t until) {
+        if (until > ready) {
+            steps.push_back({name, at(ready), at(until)});
+            ready = until;
+        }
+    };
+    step("dns", dns);
+    step("connect", connect);
+    step("tls", tls);
+    step("wait", first_byte);
+    step("receive", total);
+
+    trace_request(method + " " + path, start, end,
+                  {{"url", url}, {"status", std::to_string(http_code)}, {"new_connections", std::to_string(connects)},
+                   {"bytes_sent", std::to_string(sent)}, {"bytes_received", std::to_string(received)}},
+                  steps);
+}
+
+// Function to add a request's timing to the totals and remember the address it reached
+void record_request(CURL* curl) {
+    if (trace_enabled()) trace_http(curl);
+    curl_off_t dns = 0, connect = 0, tls = 0, total = 0;
+    long connects = 0, version = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version);
+
+    long used_proxy = 0;
+#if LIBCURL_VERSION_NUM >= 0x080700
+    curl_easy_getinfo(curl, CURLINFO_USED_PROXY, &used_proxy);
+#endif
+    char* ip = nullptr;
+    curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &ip);
+    std::string host_port = connects > 0 && !used_proxy && ip && *ip ? handle_host_port(curl) : "";
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    NetworkStats& stats = state->stats;
+    stats.requests++;
+    if (version == CURL_HTTP_VERSION_2_0) stats.http2_requests++;
+    stats.connections += connects;
+    stats.dns_us += dns;
+    if (connect > dns) stats.connect_us += connect - dns;
+    if (tls > connect) stats.tls_us += tls - connect;
+    stats.total_us += total;
+
+    if (!host_port.empty()) {
+        auto it = state->dns_cache.find(host_port);
+        // An unchanged address keeps its timestamp, so it still expires on schedule
+        if (it == state->dns_cache.end() || it->second.ip != ip) {
+            state->dns_cache[host_port] = CachedAddress{ip, unix_now()};
+            state->dns_cache_dirty = true;
+        }
+    }
+}
+
+void report_stats() {
+    const NetworkStats& stats = state->stats;
+    auto ms = [](curl_off_t us) { return us / 1000; };
+    std::cerr << "Network: " << stats.requests << " request(s), " << stats.http2_requests << " over HTTP/2, "
+              << stats.connections << " new connection(s); DNS " << ms(stats.dns_us) << " ms, connect "
+              << ms(stats.connect_us) << " ms, TLS " << ms(stats.tls_us) << " ms, total "
+              << ms(stats.total_us) << " ms" << std::endl;
+}
+
+void http_shutdown() {
+    if (!state) return;
+    if (state->report && state->stats.requests > 0) report_stats();
+    if (state->dns_cache_dirty && !state->dns_cache_path.empty()) save_dns_cache();
+    curl_share_cleanup(state->share);
+    curl_slist_free_all(state->resolve);
+    for (curl_slist* list : state->retired_resolve) curl_slist_free_all(list);
+    delete state;
+    state = nullptr;
+    curl_global_cleanup();
+}
+
+}  // namespace
+
+void http_init(const std::map<std::string, std::string>& config) {
+    long long retry_deadline = DEFAULT_RETRY_DEADLINE_SECONDS;
+    auto deadline_it = config.find("RETRY_DEADLINE");
+    if (deadline_it != config.end() && !deadline_it->second.empty()) {
+        try {
+            retry_deadline = std::stoll(deadline_it->second);
+        } catch (const std::exception&) {
+            throw GitsError(GITS_ERR_CONFIG, "RETRY_DEADLINE must be a number of seconds");
+        }
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    state = new HttpState();
+
+    auto timing_it = config.find("NETWORK_TIMING");
+    state->report = timing_it != config.end() && (timing_it->second == "1" || timing_it->second == "true");
+
+    state->retry_window = std::chrono::seconds(retry_deadline);
+    http_retry_restart();
+
+    state->share = curl_share_init();
+    curl_share_setopt(state->share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(state->share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(state->share, CURLSHOPT_USERDATA, state);
+    curl_share_setopt(state->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(state->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(state->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+    const char* home = std::getenv("HOME");
+    if (home && *home) {
+        state->dns_cache_path = fs::path(home) / ".gits" / "dns-cache";
+        load_dns_cache();
+    }
+    std::atexit(http_shutdown);
+}
+
+CURL* http_easy() {
+    CURL* curl = curl_easy_init();
+    if (!curl) return nullptr;
+    curl_easy_setopt(curl, CURLOPT_SHARE, state->share);
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->resolve) {
+        curl_easy_setopt(curl, CURLOPT_RESOLVE, state->resolve);
+    }
+    return curl;
+}
+
+CURLcode http_perform(CURL* curl) {
+    CURLcode res = curl_easy_perform(curl);
+    if (res == CURLE_COULDNT_CONNECT) {
+        // The cached address may be stale: evict it from the shared DNS cache and retry
+        std::string host_port = handle_host_port(curl);
+        std::unique_lock<std::mutex> lock(state->mutex);
+        if (!host_port.empty() && state->dns_cache.erase(host_port)) {
+            state->dns_cache_dirty = true;
+            rebuild_resolve_list();
+            lock.unlock();
+            std::string evict = "-" + host_port;
+            curl_slist* list = curl_slist_append(nullptr, evict.c_str());
+            curl_easy_setopt(curl, CURLOPT_RESOLVE, list);
+            res = curl_easy_perform(curl);
+            curl_easy_setopt(curl, CURLOPT_RESOLVE, nullptr);
+            curl_slist_free_all(list);
+        }
+    }
+    record_request(curl);
+    return res;
+}
+
+void http_retry_restart() {
+    retry_deadline = next_retry_deadline();
+}
+
+std::chrono::steady_clock::time_point http_retry_deadline() {
+    if (retry_deadline == std::chrono::steady_clock::time_point()) http_retry_restart();
+    return retry_deadline;
+}
+
+void http_retry_inherit(std::chrono::steady_clock::time_point deadline) {
+    retry_deadline = deadline;
+}
+
+void http_record(CURL* curl) {
+    record_request(curl);
+}
+
+bool http_retry_delay(CURL* curl, CURLcode res, int attempt, std::chrono::milliseconds& delay) {
+    std::string reason;
+    switch (res) {
+        case CURLE_OK: {
+            long http_code = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+            if (http_code != 409 && http_code != 429 && http_code != 500 && http_code != 502 && http_code != 503 && http_code != 504) {
+                return false;
+            }
+            reason = "HTTP " + std::to_string(http_code);
+            break;
+        }
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_HTTP2:
+        case CURLE_HTTP2_STREAM:
+            reason = curl_easy_strerror(res);
+            break;
+        default:
+            return false;
+    }
+
+    auto window = RETRY_BASE_DELAY * (1LL << std::min(attempt, 10));
+    if (window > RETRY_MAX_DELAY) window = RETRY_MAX_DELAY;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        std::uniform_int_distribution<long long> pick(window.count() / 2, window.count());
+        delay = std::chrono::milliseconds(pick(state->jitter));
+    }
+    curl_off_t retry_after = 0;
+    curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retry_after);
+    if (retry_after > 0) {
+        delay = std::max(delay, std::chrono::milliseconds(retry_after * 1000));
+    }
+    if (std::chrono::steady_clock::now() + delay > http_retry_deadline()) {
+        return false;
+    }
+    warning("Request failed (" + reason + "), retrying in " + std::to_string(delay.count()) + " ms");
+    return true;
+}
+
+bool http_retry(CURL* curl, CURLcode res, int attempt) {
+    std::chrono::milliseconds delay;
+    if (!http_retry_delay(curl, res, attempt, delay)) return false;
+    std::this_thread::sleep_for(delay);
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+
+#include <curl/curl.h>
+
+// Shared HTTP layer for every request a command makes. Easy handles are
+// attached to one curl share, so DNS answers, TLS sessions and open
+// connections carry over from one request to the next. HTTP/2 is negotiated
+// over TLS, and resolved addresses are kept in ~/.gits/dns-cache for the next
+// run.
+
+// Function to initialize libcurl and the shared state; reads NETWORK_TIMING
+// and RETRY_DEADLINE from the config. Cleanup runs automatically at exit.
+void http_init(const std::map<std::string, std::string>& config);
+
+// Function to create an easy handle attached to the shared state. Free it
+// with curl_easy_cleanup as usual; its connection stays open for reuse.
+CURL* http_easy();
+
+// Function to run a request on a handle from http_easy, recording its timing.
+// Retries once without the cached address if a cached host cannot be reached.
+CURLcode http_perform(CURL* curl);
+
+// Function to decide whether a finished request should be sent again. Network
+// errors and HTTP 409, 429, 500, 502, 503 and 504 are retried with jittered
+// exponential backoff, honouring Retry-After, until RETRY_DEADLINE seconds
+// (default 60) after the call began. Sleeps before returning true; the caller
+// must rewind any request body.
+bool http_retry(CURL* curl, CURLcode res, int attempt);
+
+// Function to make the same decision as http_retry without sleeping, for
+// transfers driven by a curl multi handle; delay is how long to wait
+bool http_retry_delay(CURL* curl, CURLcode res, int attempt, std::chrono::milliseconds& delay);
+
+// Function to record the timing of a request that finished on a curl multi
+// handle, as http_perform does for single requests
+void http_record(CURL* curl);
+
+// Function to start a new RETRY_DEADLINE window on the calling thread, for
+// each call of a long-lived client and for commands that keep making requests
+// for longer than one window
+void http_retry_restart();
+
+// Function to get the calling thread's retry deadline, so threads started for
+// the same call can share it through http_retry_inherit
+std::chrono::steady_clock::time_point http_retry_deadline();
+void http_retry_inherit(std::chrono::steady_clock::time_point deadline);
@@ -0,0 +1,226 @@
+#include "libgits.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "commands.h"
+#include "http_client.h"
+
+struct gits_client {
+    Config config;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+// libcurl and the shared connection state are set up once per process, from
+// the first client's NETWORK_TIMING and RETRY_DEADLINE
+std::once_flag http_once;
+
+char* copy_string(const std::string& value) {
+    char* copy = static_cast<char*>(std::malloc(value.size() + 1));
+    if (!copy) throw std::bad_alloc();
+    std::memcpy(copy, value.c_str(), value.size() + 1);
+    return copy;
+}
+
+void fill_job(const JobStatus& status, gits_job* job) {
+    job->job_id = copy_string(status.job_id);
+    job->schedule_time = copy_string(status.schedule_time);
+    job->status = copy_string(status.status);
+    job->json = copy_string(status.json);
+}
+
+void free_job(gits_job* job) {
+    std::free(job->job_id);
+    std::free(job->schedule_time);
+    std::free(job->status);
+    std::free(job->json);
+    *job = gits_job{};
+}
+
+// Function to run one call, turning exceptions into error codes
+template <typename F>
+gits_error guarded(F&& fn) {
+    try {
+        fn();
+        last_error.clear();
+        return GITS_OK;
+    } catch (const GitsError& e) {
+        last_error = e.what();
+        return e.code();
+    } catch (const std::bad_alloc&) {
+        last_error = "Out of memory";
+        return GITS_ERR_INTERNAL;
+    } catch (const std::exception& e) {
+        last_error = e.what();
+        return GITS_ERR_INTERNAL;
+    }
+}
+
+// Function to check the client and start a new retry window for this call
+void begin_call(gits_client* client) {
+    if (!client) {
+        throw GitsError(GITS_ERR_INVALID, "client is NULL");
+    }
+    http_retry_restart();
+}
+
+}  // namespace
+
+gits_client* gits_client_new(const char* config_path) {
+    gits_client* client = nullptr;
+    gits_error code = guarded([&] {
+        Config config = load_config(config_path ? config_path : "");
+        std::call_once(http_once, [&] {
+            http_init(config);
+            // Progress lines are for the CLI; callers get structured results
+            set_notice_handler(nullptr);
+        });
+        client = new gits_client{std::move(config)};
+    });
+    return code == GITS_OK ? client : nullptr;
+}
+
+void gits_client_free(gits_client* client) {
+    delete client;
+}
+
+gits_error gits_schedule(gits_client* client, const gits_schedule_options* options, gits_schedule_result* result) {
+    return guarded([&] {
+        begin_call(client);
+        if (!options || !options->schedule_time || !result) {
+            throw GitsError(GITS_ERR_INVALID, "options, options->schedule_time and result are required");
+        }
+        ScheduleOptions schedule;
+        schedule.repo_path = options->repo_path ? options->repo_path : "";
+        schedule.schedule_time = options->schedule_time;
+        schedule.commit_message = options->message ? options->message : "";
+        for (const char* const* file = options->files; file && *file; ++file) {
+            schedule.files.push_back(*file);
+        }
+        if (options->mode) schedule.mode = options->mode;
+
+        ScheduleResult scheduled = schedule_changes(client->config, schedule);
+        gits_schedule_result out{};
+        try {
+            out.job_id = copy_string(scheduled.job_id);
+            out.schedule_time = copy_string(scheduled.schedule_time);
+            out.cron_expression = copy_string(scheduled.cron_expression);
+        } catch (...) {
+            gits_schedule_result_free(&out);
+            throw;
+        }
+        out.duplicate = scheduled.duplicate ? 1 : 0;
+        *result = out;
+    });
+}
+
+void gits_schedule_result_free(gits_schedule_result* result) {
+    if (!result) return;
+    std::free(result->job_id);
+    std::free(result->schedule_time);
+    std::free(result->cron_expression);
+    *result = gits_schedule_result{};
+}
+
+gits_error gits_status(gits_client* client, gits_job* job) {
+    return guarded([&] {
+        begin_call(client);
+        if (!job) {
+            throw GitsError(GITS_ERR_INVALID, "job is NULL");
+        }
+        JobStatus status = latest_job_status(client->config);
+        gits_job out{};
+        try {
+            fill_job(status, &out);
+        } catch (...) {
+            free_job(&out);
+            throw;
+        }
+        *job = out;
+    });
+}
+
+void gits_job_free(gits_job* job) {
+    if (job) free_job(job);
+}
+
+gits_error gits_list_jobs(gits_client* client, const gits_list_options* options, gits_job_list* list) {
+    return guarded([&] {
+        begin_call(client);
+        if (!list) {
+            throw GitsError(GITS_ERR_INVALID, "list is NULL");
+        }
+        JobFilter filter;
+        if (options && options->status) filter.status = options->status;
+        if (options && options->since) {
+            filter.since = options->since;
+            local_to_utc(filter.since);
+        }
+        if (options && options->until) {
+            filter.until = options->until;
+            local_to_utc(filter.until);
+        }
+        std::vector<JobStatus> jobs;
+        list_jobs(client->config, filter, [&](const JobStatus& job) { jobs.push_back(job); });
+
+        gits_job_list out{};
+        out.jobs = static_cast<gits_job*>(std::calloc(jobs.empty() ? 1 : jobs.size(), sizeof(gits_job)));
+        if (!out.jobs) throw std::bad_alloc();
+        try {
+            for (const auto& job : jobs) {
+                fill_job(job, &out.jobs[out.count]);
+                out.count++;
+            }
+        } catch (...) {
+            gits_job_list_free(&out);
+            throw;
+        }
+        *list = out;
+    });
+}
+
+void gits_job_list_free(gits_job_list* list) {
+    if (!list) return;
+    for (size_t i = 0; i < list->count; ++i) {
+        free_job(&list->jobs[i]);
+    }
+    std::free(list->jobs);
+    *list = gits_job_list{};
+}
+
+gits_error gits_delete(gits_client* client, const char* job_id) {
+    return guarded([&] {
+        begin_call(client);
+        if (!job_id || !*job_id) {
+            throw GitsError(GITS_ERR_INVALID, "job_id is required");
+        }
+        delete_job(client->config, job_id);
+    });
+}
+
+const char* gits_last_error(void) {
+    return last_error.c_str();
+}
+
+const char* gits_error_string(gits_error code) {
+    switch (code) {
+        case GITS_OK: return "ok";
+        case GITS_ERR_INVALID: return "invalid argument";
+        case GITS_ERR_CONFIG: return "configuration error";
+        case GITS_ERR_REPO: return "repository error";
+        case GITS_ERR_NO_CHANGES: return "no changes";
+        case GITS_ERR_NETWORK: return "network error";
+        case GITS_ERR_HTTP: return "HTTP error";
+        case GITS_ERR_PROTOCOL: return "protocol error";
+        case GITS_ERR_IO: return "I/O error";
+        case GITS_ERR_INTERNAL: return "internal error";
+    }
+    return "unknown error";
+}
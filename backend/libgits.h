@@ -0,0 +1,116 @@
+#ifndef LIBGITS_H
+#define LIBGITS_H
+
+/*
+ * libgits: the gits commands as a C library, for editor plugins and CI hooks
+ * that would otherwise run the gits binary and parse its output.
+ *
+ * A client holds the settings of one config file. Every call returns a
+ * gits_error; on failure gits_last_error() describes it. Results are plain
+ * structs owned by the caller and released with the matching *_free function.
+ *
+ * Calls may run concurrently from several threads, on one client or several,
+ * and share DNS answers, TLS sessions and open connections. gits_schedule
+ * works inside the given repository's directory, so schedules run one at a
+ * time per process; status, list and delete calls do not wait for them.
+ * NETWORK_TIMING and RETRY_DEADLINE are read from the first client created.
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define GITS_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define GITS_API __attribute__((visibility("default")))
+#else
+#define GITS_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped when a struct or function changes incompatibly */
+#define GITS_API_VERSION 1
+
+typedef enum gits_error {
+    GITS_OK = 0,
+    GITS_ERR_INVALID = 1,     /* bad argument, e.g. a past or malformed time */
+    GITS_ERR_CONFIG = 2,      /* missing or invalid setting in the config file */
+    GITS_ERR_REPO = 3,        /* not a git repository, no usable origin, unknown file */
+    GITS_ERR_NO_CHANGES = 4,  /* nothing to schedule */
+    GITS_ERR_NETWORK = 5,     /* the request could not be completed */
+    GITS_ERR_HTTP = 6,        /* the backend answered with an error status */
+    GITS_ERR_PROTOCOL = 7,    /* the backend's answer could not be understood */
+    GITS_ERR_IO = 8,          /* a local file could not be read or written */
+    GITS_ERR_INTERNAL = 9
+} gits_error;
+
+typedef struct gits_client gits_client;
+
+/* Options of one schedule; NULL fields take the CLI's defaults */
+typedef struct gits_schedule_options {
+    const char* repo_path;      /* repository to schedule from; NULL: current directory */
+    const char* schedule_time;  /* local time, YYYY-MM-DDTHH:MM; required */
+    const char* message;        /* commit message */
+    const char* const* files;   /* NULL-terminated paths; NULL: every change */
+    const char* mode;           /* "zip" (default) or "bundle" */
+} gits_schedule_options;
+
+typedef struct gits_schedule_result {
+    char* job_id;           /* e.g. "gits-1751987700", as gits_delete takes it */
+    char* schedule_time;    /* UTC, as stored by the backend */
+    char* cron_expression;  /* the minute the job is due, e.g. "cron(0 15 17 7 ? 2025)" */
+    int duplicate;          /* nonzero when an earlier attempt scheduled the job */
+} gits_schedule_result;
+
+typedef struct gits_job {
+    char* job_id;
+    char* schedule_time;
+    char* status;
+    char* json;  /* the backend's full record, as a JSON object */
+} gits_job;
+
+typedef struct gits_job_list {
+    gits_job* jobs;
+    size_t count;
+} gits_job_list;
+
+/* Filters for gits_list_jobs; NULL fields do not filter */
+typedef struct gits_list_options {
+    const char* status;  /* e.g. "pending", "SUCCEEDED" */
+    const char* since;   /* local time, YYYY-MM-DDTHH:MM */
+    const char* until;
+} gits_list_options;
+
+/* Create a client from a gits config file; NULL reads ~/.gits/config.
+ * Returns NULL on failure. */
+GITS_API gits_client* gits_client_new(const char* config_path);
+GITS_API void gits_client_free(gits_client* client);
+
+/* Schedule the changes of a repository, as `gits schedule` does */
+GITS_API gits_error gits_schedule(gits_client* client, const gits_schedule_options* options, gits_schedule_result* result);
+GITS_API void gits_schedule_result_free(gits_schedule_result* result);
+
+/* Get the latest job, as `gits status` does, using the same status cache */
+GITS_API gits_error gits_status(gits_client* client, gits_job* job);
+GITS_API void gits_job_free(gits_job* job);
+
+/* List every job, newest first, as `gits status --all` does */
+GITS_API gits_error gits_list_jobs(gits_client* client, const gits_list_options* options, gits_job_list* list);
+GITS_API void gits_job_list_free(gits_job_list* list);
+
+/* Delete a scheduled job */
+GITS_API gits_error gits_delete(gits_client* client, const char* job_id);
+
+/* Message describing the calling thread's last failure; empty after success */
+GITS_API const char* gits_last_error(void);
+
+/* Short name of an error code */
+GITS_API const char* gits_error_string(gits_error code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
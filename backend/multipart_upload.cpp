@@ -0,0 +1,223 @@
+#include "multipart_upload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <curl/curl.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "commands.h"
+#include "http_client.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The meter is redrawn at most this often
+const std::chrono::milliseconds METER_INTERVAL(500);
+
+// Struct for one part and the state of its current attempt
+struct Part {
+    int number = 0;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    uint64_t read = 0;       // bytes handed to curl in this attempt
+    curl_off_t sent = 0;     // bytes curl reports sent in this attempt
+    int attempt = 0;
+    Clock::time_point not_before;
+    int fd = -1;
+    std::string url;
+    std::string response;
+    CURL* curl = nullptr;
+};
+
+size_t read_part(char* buffer, size_t size, size_t nitems, void* userdata) {
+    Part* part = static_cast<Part*>(userdata);
+    size_t want = static_cast<size_t>(std::min<uint64_t>(size * nitems, part->length - part->read));
+    if (want == 0) return 0;
+    ssize_t n = pread(part->fd, buffer, want, static_cast<off_t>(part->offset + part->read));
+    if (n < 0) return CURL_READFUNC_ABORT;
+    part->read += static_cast<uint64_t>(n);
+    return static_cast<size_t>(n);
+}
+
+// Curl may rewind a body to resend it on a new connection
+int seek_part(void* userdata, curl_off_t offset, int origin) {
+    Part* part = static_cast<Part*>(userdata);
+    if (origin != SEEK_SET || offset < 0 || static_cast<uint64_t>(offset) > part->length) return CURL_SEEKFUNC_FAIL;
+    part->read = static_cast<uint64_t>(offset);
+    return CURL_SEEKFUNC_OK;
+}
+
+size_t write_response(void* contents, size_t size, size_t nmemb, void* userdata) {
+    static_cast<std::string*>(userdata)->append(static_cast<char*>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+int part_progress(void* userdata, curl_off_t, curl_off_t, curl_off_t, curl_off_t ulnow) {
+    static_cast<Part*>(userdata)->sent = ulnow;
+    return 0;
+}
+
+std::string megabytes(double bytes) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << bytes / (1024 * 1024) << " MB";
+    return out.str();
+}
+
+// Struct for the throughput meter
+struct Meter {
+    uint64_t size = 0;
+    uint64_t done_before = 0;   // finished by an earlier run, not counted in the rate
+    uint64_t done_now = 0;      // finished parts of this run
+    size_t parts_done = 0;
+    size_t parts_total = 0;
+    Clock::time_point started = Clock::now();
+    Clock::time_point drawn;
+    bool live = notices_on_console() && isatty(fileno(stderr));
+
+    double rate(uint64_t in_flight) const {
+        double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+        return seconds > 0 ? (done_now + in_flight) / seconds : 0;
+    }
+
+    void draw(uint64_t in_flight) {
+        if (!live || Clock::now() - drawn < METER_INTERVAL) return;
+        drawn = Clock::now();
+        std::cerr << "\rUploading " << megabytes(done_before + done_now + in_flight) << " of " << megabytes(size)
+                  << " at " << megabytes(rate(in_flight)) << "/s (" << parts_done << " of " << parts_total << " parts)   " << std::flush;
+    }
+
+    void finish() {
+        if (live) std::cerr << "\r" << std::string(79, ' ') << "\r" << std::flush;
+        std::ostringstream line;
+        line << "Uploaded " << megabytes(done_now) << " in " << parts_done << " part(s) at " << megabytes(rate(0)) << "/s";
+        notice(line.str());
+    }
+};
+
+}  // namespace
+
+bool upload_parts(const std::string& path, uint64_t size, uint64_t part_size, const std::map<int, std::string>& urls, uint64_t done_bytes, const std::function<void(int, const std::string&)>& on_done) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        warning("Error: Failed to open " + path + " for upload");
+        return false;
+    }
+    std::vector<std::unique_ptr<Part>> parts;
+    std::deque<Part*> pending;
+    for (const auto& entry : urls) {
+        auto part = std::make_unique<Part>();
+        part->number = entry.first;
+        part->offset = static_cast<uint64_t>(entry.first - 1) * part_size;
+        part->length = std::min(part_size, size - std::min(size, part->offset));
+        part->fd = fd;
+        part->url = entry.second;
+        pending.push_back(part.get());
+        parts.push_back(std::move(part));
+    }
+
+    Meter meter;
+    meter.size = size;
+    meter.done_before = done_bytes;
+    meter.parts_total = parts.size();
+    CURLM* multi = curl_multi_init();
+    std::vector<Part*> active;
+    bool failed = false;
+
+    while ((!failed && !pending.empty()) || !active.empty()) {
+        // Start due parts up to the concurrency limit
+        auto now = Clock::now();
+        for (auto it = pending.begin(); !failed && it != pending.end() && active.size() < MULTIPART_CONCURRENCY;) {
+            Part* part = *it;
+            if (part->not_before > now) {
+                ++it;
+                continue;
+            }
+            it = pending.erase(it);
+            part->read = 0;
+            part->sent = 0;
+            part->response.clear();
+            part->curl = http_easy();
+            curl_easy_setopt(part->curl, CURLOPT_URL, part->url.c_str());
+            curl_easy_setopt(part->curl, CURLOPT_UPLOAD, 1L);
+            curl_easy_setopt(part->curl, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(part->length));
+            curl_easy_setopt(part->curl, CURLOPT_READFUNCTION, read_part);
+            curl_easy_setopt(part->curl, CURLOPT_READDATA, part);
+            curl_easy_setopt(part->curl, CURLOPT_SEEKFUNCTION, seek_part);
+            curl_easy_setopt(part->curl, CURLOPT_SEEKDATA, part);
+            curl_easy_setopt(part->curl, CURLOPT_WRITEFUNCTION, write_response);
+            curl_easy_setopt(part->curl, CURLOPT_WRITEDATA, &part->response);
+            curl_easy_setopt(part->curl, CURLOPT_XFERINFOFUNCTION, part_progress);
+            curl_easy_setopt(part->curl, CURLOPT_XFERINFODATA, part);
+            curl_easy_setopt(part->curl, CURLOPT_NOPROGRESS, 0L);
+            curl_easy_setopt(part->curl, CURLOPT_PRIVATE, part);
+            curl_multi_add_handle(multi, part->curl);
+            active.push_back(part);
+        }
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            char* private_data = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &private_data);
+            Part* part = reinterpret_cast<Part*>(private_data);
+            CURLcode res = msg->data.result;
+            long http_code = 0;
+            curl_easy_getinfo(part->curl, CURLINFO_RESPONSE_CODE, &http_code);
+            http_record(part->curl);
+            struct curl_header* etag = nullptr;
+            std::chrono::milliseconds delay;
+            if (res == CURLE_OK && http_code == 200 && curl_easy_header(part->curl, "ETag", 0, CURLH_HEADER, -1, &etag) == CURLHE_OK) {
+                on_done(part->number, etag->value);
+                meter.done_now += part->length;
+                meter.parts_done++;
+                // Steady progress keeps the retry window open on long uploads
+                http_retry_restart();
+            } else if (!failed && http_retry_delay(part->curl, res, part->attempt, delay)) {
+                part->attempt++;
+                part->not_before = Clock::now() + delay;
+                pending.push_back(part);
+            } else if (!failed) {
+                failed = true;
+                if (res != CURLE_OK) {
+                    warning("Error: Upload of part " + std::to_string(part->number) + " failed: " + curl_easy_strerror(res));
+                } else {
+                    warning("Error: Upload of part " + std::to_string(part->number) + " failed (HTTP " + std::to_string(http_code) + "). Response: " + part->response);
+                }
+            }
+            curl_multi_remove_handle(multi, part->curl);
+            curl_easy_cleanup(part->curl);
+            part->curl = nullptr;
+            active.erase(std::find(active.begin(), active.end(), part));
+        }
+
+        uint64_t in_flight = 0;
+        for (const Part* part : active) in_flight += static_cast<uint64_t>(part->sent);
+        meter.draw(in_flight);
+
+        if (!active.empty()) {
+            curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+        } else if (!failed && !pending.empty()) {
+            // Every remaining part is backing off
+            auto next = std::min_element(pending.begin(), pending.end(), [](const Part* a, const Part* b) { return a->not_before < b->not_before; });
+            std::this_thread::sleep_until((*next)->not_before);
+        }
+    }
+
+    curl_multi_cleanup(multi);
+    close(fd);
+    meter.finish();
+    return !failed;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+// Parallel upload of a file's parts to pre-signed S3 UploadPart URLs. The parts
+// share one curl multi handle, at most MULTIPART_CONCURRENCY at a time, and
+// each reads its byte range straight from the file. A failed part waits out
+// its backoff (http_retry_delay) without holding up the others.
+//
+// Progress is shown on stderr while the upload runs when stderr is a
+// terminal, followed by a one-line summary.
+
+constexpr unsigned MULTIPART_CONCURRENCY = 4;
+
+// Function to upload parts (part number -> URL) of the file at path. Part n
+// covers bytes [(n - 1) * part_size, min(n * part_size, size)). on_done is
+// called with each finished part and its ETag. done_bytes counts parts
+// finished by an earlier run, for the meter. Returns false once a part failed
+// for good; parts already in flight are finished first.
+bool upload_parts(const std::string& path, uint64_t size, uint64_t part_size, const std::map<int, std::string>& urls, uint64_t done_bytes, const std::function<void(int, const std::string&)>& on_done);
@@ -0,0 +1,181 @@
+#include "trace.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Timestamps in the trace count from process start
+const TraceClock::time_point trace_epoch = TraceClock::now();
+
+// Phases run on the main thread and nest, so they share one track. HTTP
+// requests can overlap (multipart parts), so each goes on the first of the
+// http tracks that is free, together with its breakdown.
+const int PHASE_TID = 1;
+const int HTTP_TID_BASE = 2;
+
+struct Span {
+    std::string name;
+    const char* category;  // "phase", "http" for a request, "http.step" for its breakdown
+    TraceClock::time_point start;
+    TraceClock::time_point end;
+    std::map<std::string, std::string> args;
+    int tid;
+};
+
+struct TraceState {
+    std::mutex mutex;
+    std::string path;
+    bool summary = false;
+    std::vector<Span> spans;
+    std::vector<TraceClock::time_point> http_lanes;  // end of the last request on each track
+};
+
+TraceState* state = nullptr;
+
+double us_since_epoch(TraceClock::time_point t) {
+    return std::chrono::duration<double, std::micro>(t - trace_epoch).count();
+}
+
+double ms_between(TraceClock::time_point start, TraceClock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Pick the first http track free at start and reserve it until end; caller holds the mutex
+int http_lane(TraceClock::time_point start, TraceClock::time_point end) {
+    auto& lanes = state->http_lanes;
+    for (size_t i = 0; i < lanes.size(); ++i) {
+        if (start >= lanes[i]) {
+            lanes[i] = end;
+            return HTTP_TID_BASE + static_cast<int>(i);
+        }
+    }
+    lanes.push_back(end);
+    return HTTP_TID_BASE + static_cast<int>(lanes.size() - 1);
+}
+
+void write_trace_file(TraceClock::time_point end) {
+    json events = json::array();
+    events.push_back({{"name", "process_name"}, {"ph", "M"}, {"pid", 1}, {"args", {{"name", "gits"}}}});
+    events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", PHASE_TID}, {"args", {{"name", "main"}}}});
+    for (size_t i = 0; i < state->http_lanes.size(); ++i) {
+        events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", HTTP_TID_BASE + static_cast<int>(i)},
+                          {"args", {{"name", "http " + std::to_string(i + 1)}}}});
+    }
+    events.push_back({{"name", "gits"}, {"cat", "phase"}, {"ph", "X"}, {"pid", 1}, {"tid", PHASE_TID},
+                      {"ts", 0}, {"dur", us_since_epoch(end)}});
+    for (const auto& span : state->spans) {
+        json event = {{"name", span.name}, {"cat", span.category}, {"ph", "X"}, {"pid", 1}, {"tid", span.tid},
+                      {"ts", us_since_epoch(span.start)}, {"dur", std::chrono::duration<double, std::micro>(span.end - span.start).count()}};
+        if (!span.args.empty()) event["args"] = span.args;
+        events.push_back(event);
+    }
+    json trace = {{"traceEvents", events}, {"displayTimeUnit", "ms"}};
+
+    std::ofstream out(state->path, std::ios::trunc);
+    out << trace.dump();
+    if (!out) {
+        std::cerr << "Error: Failed to write trace file " << state->path << std::endl;
+    }
+}
+
+// Phases are summed by name in the order they first ran; requests are
+// summed into one line with their timing breakdown
+void print_summary(TraceClock::time_point end) {
+    std::vector<std::pair<std::string, double>> phases;
+    std::vector<std::pair<std::string, double>> http_parts;
+    unsigned requests = 0;
+    double http_ms = 0;
+    auto add = [](std::vector<std::pair<std::string, double>>& totals, const std::string& name, double ms) {
+        for (auto& total : totals) {
+            if (total.first == name) {
+                total.second += ms;
+                return;
+            }
+        }
+        totals.emplace_back(name, ms);
+    };
+    for (const auto& span : state->spans) {
+        double ms = ms_between(span.start, span.end);
+        std::string category = span.category;
+        if (category == "phase") {
+            add(phases, span.name, ms);
+        } else if (category == "http") {
+            requests++;
+            http_ms += ms;
+        } else {
+            add(http_parts, span.name, ms);
+        }
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << "Trace: " << ms_between(trace_epoch, end) << " ms total" << std::endl;
+    for (const auto& phase : phases) {
+        out << "  " << std::left << std::setw(28) << phase.first << std::right << std::setw(10) << phase.second << " ms" << std::endl;
+    }
+    if (requests > 0) {
+        std::string label = "HTTP (" + std::to_string(requests) + " request" + (requests == 1 ? "" : "s") + ")";
+        out << "  " << std::left << std::setw(28) << label << std::right << std::setw(10) << http_ms << " ms:";
+        const char* separator = " ";
+        for (const auto& part : http_parts) {
+            out << separator << part.first << " " << part.second;
+            separator = ", ";
+        }
+        out << std::endl;
+    }
+    std::cerr << out.str();
+}
+
+void trace_shutdown() {
+    if (!state) return;
+    auto end = TraceClock::now();
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->path.empty()) write_trace_file(end);
+        if (state->summary) print_summary(end);
+    }
+    delete state;
+    state = nullptr;
+}
+
+}  // namespace
+
+void trace_init(const std::string& path, bool summary) {
+    if (state || (path.empty() && !summary)) return;
+    state = new TraceState();
+    state->path = path;
+    state->summary = summary;
+    std::atexit(trace_shutdown);
+}
+
+bool trace_enabled() {
+    return state != nullptr;
+}
+
+void trace_record(const std::string& name, TraceClock::time_point start, TraceClock::time_point end,
+                  const std::map<std::string, std::string>& args) {
+    if (!state) return;
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->spans.push_back(Span{name, "phase", start, end, args, PHASE_TID});
+}
+
+void trace_request(const std::string& name, TraceClock::time_point start, TraceClock::time_point end,
+                   const std::map<std::string, std::string>& args, const std::vector<TraceInterval>& breakdown) {
+    if (!state) return;
+    std::lock_guard<std::mutex> lock(state->mutex);
+    int tid = http_lane(start, end);
+    state->spans.push_back(Span{name, "http", start, end, args, tid});
+    for (const auto& step : breakdown) {
+        state->spans.push_back(Span{step.name, "http.step", step.start, step.end, {}, tid});
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// Per-phase tracing for one command. Spans are collected in memory while the
+// command runs and written at exit: as Chrome trace-event JSON (load it in
+// chrome://tracing or ui.perfetto.dev) and/or as a short summary on stderr.
+// Recording costs nothing until trace_init turns it on.
+
+using TraceClock = std::chrono::steady_clock;
+
+// Function to turn tracing on. path receives the trace file (empty for none);
+// summary prints time per phase and the HTTP breakdown to stderr.
+void trace_init(const std::string& path, bool summary);
+
+// Function to check whether spans are being recorded
+bool trace_enabled();
+
+// Function to record a finished phase span; args are shown in the trace viewer
+void trace_record(const std::string& name, TraceClock::time_point start, TraceClock::time_point end,
+                  const std::map<std::string, std::string>& args = {});
+
+// Struct for one step of an HTTP request (DNS, connect, TLS, ...)
+struct TraceInterval {
+    std::string name;
+    TraceClock::time_point start;
+    TraceClock::time_point end;
+};
+
+// Function to record an HTTP request on an http track of its own, with its
+// breakdown nested beneath it. Requests may overlap.
+void trace_request(const std::string& name, TraceClock::time_point start, TraceClock::time_point end,
+                   const std::map<std::string, std::string>& args, const std::vector<TraceInterval>& breakdown);
+
+// Class recording a phase span from construction to destruction
+class TraceSpan {
+public:
+    explicit TraceSpan(std::string name) : name_(std::move(name)), start_(TraceClock::now()) {}
+    ~TraceSpan() { trace_record(name_, start_, TraceClock::now()); }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    std::string name_;
+    TraceClock::time_point start_;
+};
+
+// Function to run fn inside a phase span and return its result
+template <typename F>
+auto trace_call(const std::string& name, F&& fn) {
+    TraceSpan span(name);
+    return fn();
+}
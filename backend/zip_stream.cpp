@@ -0,0 +1,425 @@
+#include "zip_stream.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace {
+
+const uint32_t LOCAL_HEADER_SIG = 0x04034b50;
+const uint32_t DESCRIPTOR_SIG = 0x08074b50;
+const uint32_t CENTRAL_HEADER_SIG = 0x02014b50;
+const uint32_t END_OF_CENTRAL_SIG = 0x06054b50;
+
+const uint16_t MADE_BY_UNIX = 3 << 8;
+// Bit 3: sizes and CRC follow the data; bit 11: names are UTF-8
+const uint16_t FLAGS = 0x0808;
+const uint64_t ZIP32_LIMIT = 0xFFFFFFFFull;
+
+void put16(std::string& out, uint16_t v) {
+    out.push_back(static_cast<char>(v & 0xFF));
+    out.push_back(static_cast<char>((v >> 8) & 0xFF));
+}
+
+void put32(std::string& out, uint32_t v) {
+    put16(out, static_cast<uint16_t>(v & 0xFFFF));
+    put16(out, static_cast<uint16_t>((v >> 16) & 0xFFFF));
+}
+
+// Convert a unix timestamp into the MS-DOS time/date pair used by ZIP headers
+void to_dos_time(time_t t, uint16_t& dos_time, uint16_t& dos_date) {
+    std::tm tm = {};
+    localtime_r(&t, &tm);
+    if (tm.tm_year < 80) {
+        tm.tm_year = 80;
+        tm.tm_mon = 0;
+        tm.tm_mday = 1;
+        tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    }
+    dos_time = static_cast<uint16_t>((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+    dos_date = static_cast<uint16_t>(((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+}
+
+// Spec version needed to extract: 6.3 for zstd, 2.0 otherwise
+uint16_t version_needed(Codec codec) {
+    return codec == Codec::Zstd ? 63 : 20;
+}
+
+}  // namespace
+
+// Fixed set of threads compressing queued files in submission order
+class ZipStream::Pool {
+public:
+    explicit Pool(unsigned threads) {
+        for (unsigned i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~Pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+    std::future<Compressed> submit(const std::string& path, const CodecPolicy& policy) {
+        std::packaged_task<Compressed()> task([path, &policy] { return compress_file(path, policy); });
+        auto result = task.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+        return result;
+    }
+
+private:
+    void run() {
+        for (;;) {
+            std::packaged_task<Compressed()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+                if (stop_) return;
+                task = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            task();  // exceptions are stored in the future
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::deque<std::packaged_task<Compressed()>> queue_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+ZipStream::ZipStream(unsigned threads) : in_buf_(CHUNK_SIZE) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (threads > 1) {
+        pool_.reset(new Pool(threads));
+    }
+}
+
+ZipStream::~ZipStream() {
+    if (file_) fclose(file_);
+}
+
+void ZipStream::set_codec_policy(const CodecPolicy& policy) {
+    policy_ = policy;
+    if (!policy_.zstd_dictionary.empty() && policy_.mode != "store" && policy_.mode != "deflate") {
+        Entry e;
+        e.name = ZSTD_DICTIONARY_ENTRY;
+        e.data = policy_.zstd_dictionary;
+        e.force_store = true;
+        entries_.insert(entries_.begin(), std::move(e));
+    }
+}
+
+void ZipStream::add_file(const std::string& path) {
+    Entry e;
+    e.name = path;
+    e.path = path;
+    e.from_file = true;
+    entries_.push_back(std::move(e));
+}
+
+void ZipStream::add_buffer(const std::string& name, const std::string& data) {
+    Entry e;
+    e.name = name;
+    e.data = data;
+    entries_.push_back(std::move(e));
+}
+
+size_t ZipStream::read(char* out, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        if (pending_pos_ == pending_.size()) {
+            pending_.clear();
+            pending_pos_ = 0;
+            if (state_ == State::Done) break;
+            refill();
+            continue;
+        }
+        size_t n = std::min(len - written, pending_.size() - pending_pos_);
+        std::memcpy(out + written, pending_.data() + pending_pos_, n);
+        pending_pos_ += n;
+        written += n;
+    }
+    return written;
+}
+
+void ZipStream::emit(const void* data, size_t len) {
+    pending_.append(static_cast<const char*>(data), len);
+    offset_ += len;
+}
+
+void ZipStream::refill() {
+    switch (state_) {
+        case State::Header:
+            if (current_ == entries_.size()) {
+                write_central();
+                state_ = State::Done;
+            } else {
+                begin_entry(entries_[current_]);
+            }
+            break;
+        case State::Data:
+            pump_data(entries_[current_]);
+            break;
+        case State::Descriptor:
+            write_descriptor(entries_[current_]);
+            ++current_;
+            state_ = State::Header;
+            break;
+        case State::Done:
+            break;
+    }
+}
+
+// Read and compress a whole file in one go (runs on a pool thread)
+ZipStream::Compressed ZipStream::compress_file(const std::string& path, const CodecPolicy& policy) {
+    Compressed c;
+    c.mtime = std::time(nullptr);
+    std::unique_ptr<FILE, int (*)(FILE*)> file(fopen(path.c_str(), "rb"), fclose);
+    if (!file) {
+        throw std::runtime_error("Failed to open file for zip: " + path);
+    }
+    struct stat st;
+    if (fstat(fileno(file.get()), &st) == 0) {
+        c.mtime = st.st_mtime;
+        c.mode = static_cast<uint32_t>(st.st_mode);
+    }
+
+    std::string raw;
+    std::vector<char> buf(CHUNK_SIZE);
+    size_t n;
+    while ((n = fread(buf.data(), 1, buf.size(), file.get())) > 0) {
+        raw.append(buf.data(), n);
+    }
+    if (ferror(file.get())) {
+        throw std::runtime_error("Failed to read file for zip: " + path);
+    }
+    const auto* bytes = reinterpret_cast<const unsigned char*>(raw.data());
+    c.crc = crc32(0, bytes, static_cast<uInt>(raw.size()));
+    c.uncompressed_size = raw.size();
+    c.codec = choose_codec(policy, bytes, std::min(raw.size(), CHUNK_SIZE));
+
+    try {
+        make_compressor(c.codec, policy)->update(bytes, raw.size(), true, c.data);
+    } catch (const std::exception& ex) {
+        throw std::runtime_error("Failed to compress " + path + ": " + ex.what());
+    }
+    return c;
+}
+
+// Hand upcoming small files to the pool, in order, while the in-flight
+// budget allows. A file over the budget waits until earlier ones drain.
+void ZipStream::dispatch_ahead() {
+    if (!pool_) return;
+    while (next_dispatch_ < entries_.size()) {
+        Entry& e = entries_[next_dispatch_];
+        struct stat st;
+        if (e.from_file && stat(e.path.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+            static_cast<uint64_t>(st.st_size) <= PARALLEL_MAX_SIZE) {
+            uint64_t size = static_cast<uint64_t>(st.st_size);
+            if (in_flight_bytes_ > 0 && in_flight_bytes_ + size > IN_FLIGHT_LIMIT) break;
+            e.source_size = size;
+            in_flight_bytes_ += size;
+            e.job = pool_->submit(e.path, policy_);
+        }
+        ++next_dispatch_;
+    }
+}
+
+void ZipStream::begin_entry(Entry& e) {
+    dispatch_ahead();
+    if (e.job.valid()) {
+        Compressed c = e.job.get();
+        in_flight_bytes_ -= e.source_size;
+        dispatch_ahead();
+        e.codec = c.codec;
+        e.crc = c.crc;
+        e.uncompressed_size = c.uncompressed_size;
+        e.compressed_size = c.data.size();
+        e.mode = c.mode;
+        to_dos_time(c.mtime, e.dos_time, e.dos_date);
+        write_header(e);
+        emit(c.data.data(), c.data.size());
+        state_ = State::Descriptor;
+        return;
+    }
+
+    time_t mtime = std::time(nullptr);
+    if (e.from_file) {
+        file_ = fopen(e.path.c_str(), "rb");
+        if (!file_) {
+            throw std::runtime_error("Failed to open file for zip: " + e.path);
+        }
+        struct stat st;
+        if (fstat(fileno(file_), &st) == 0) {
+            mtime = st.st_mtime;
+            e.mode = static_cast<uint32_t>(st.st_mode);
+        }
+    }
+    to_dos_time(mtime, e.dos_time, e.dos_date);
+    data_pos_ = 0;
+
+    sample_len_ = read_input(e, sample_eof_);
+    sample_pending_ = true;
+    e.codec = e.force_store ? Codec::Store : choose_codec(policy_, in_buf_.data(), sample_len_);
+    try {
+        compressor_ = make_compressor(e.codec, policy_);
+    } catch (const std::exception& ex) {
+        throw std::runtime_error("Failed to compress " + e.name + ": " + ex.what());
+    }
+    write_header(e);
+    state_ = State::Data;
+}
+
+void ZipStream::write_header(Entry& e) {
+    if (offset_ > ZIP32_LIMIT) {
+        throw std::runtime_error("Archive exceeds the 4 GiB ZIP limit");
+    }
+    e.header_offset = offset_;
+
+    std::string header;
+    put32(header, LOCAL_HEADER_SIG);
+    put16(header, version_needed(e.codec));
+    put16(header, FLAGS);
+    put16(header, static_cast<uint16_t>(e.codec));
+    put16(header, e.dos_time);
+    put16(header, e.dos_date);
+    put32(header, 0);  // crc, sizes: written in the data descriptor
+    put32(header, 0);
+    put32(header, 0);
+    put16(header, static_cast<uint16_t>(e.name.size()));
+    put16(header, 0);
+    header += e.name;
+    emit(header.data(), header.size());
+}
+
+// Read the next chunk of the current entry into in_buf_
+size_t ZipStream::read_input(Entry& e, bool& eof) {
+    size_t n = 0;
+    if (e.from_file) {
+        n = fread(in_buf_.data(), 1, in_buf_.size(), file_);
+        if (n < in_buf_.size()) {
+            if (ferror(file_)) {
+                throw std::runtime_error("Failed to read file for zip: " + e.path);
+            }
+            eof = true;
+        } else {
+            eof = false;
+        }
+    } else {
+        n = std::min(in_buf_.size(), e.data.size() - data_pos_);
+        std::memcpy(in_buf_.data(), e.data.data() + data_pos_, n);
+        data_pos_ += n;
+        eof = data_pos_ == e.data.size();
+    }
+    return n;
+}
+
+void ZipStream::pump_data(Entry& e) {
+    size_t n;
+    bool eof;
+    if (sample_pending_) {
+        n = sample_len_;
+        eof = sample_eof_;
+        sample_pending_ = false;
+    } else {
+        n = read_input(e, eof);
+    }
+
+    e.crc = crc32(e.crc, in_buf_.data(), static_cast<uInt>(n));
+    e.uncompressed_size += n;
+
+    size_t before = pending_.size();
+    try {
+        compressor_->update(in_buf_.data(), n, eof, pending_);
+    } catch (const std::exception& ex) {
+        throw std::runtime_error("Failed to compress " + e.name + ": " + ex.what());
+    }
+    size_t have = pending_.size() - before;
+    offset_ += have;
+    e.compressed_size += have;
+
+    if (eof) {
+        compressor_.reset();
+        if (file_) {
+            fclose(file_);
+            file_ = nullptr;
+        }
+        state_ = State::Descriptor;
+    }
+}
+
+void ZipStream::write_descriptor(Entry& e) {
+    if (e.compressed_size > ZIP32_LIMIT || e.uncompressed_size > ZIP32_LIMIT) {
+        throw std::runtime_error("File exceeds the 4 GiB ZIP limit: " + e.name);
+    }
+    std::string desc;
+    put32(desc, DESCRIPTOR_SIG);
+    put32(desc, e.crc);
+    put32(desc, static_cast<uint32_t>(e.compressed_size));
+    put32(desc, static_cast<uint32_t>(e.uncompressed_size));
+    emit(desc.data(), desc.size());
+}
+
+void ZipStream::write_central() {
+    if (entries_.size() > 0xFFFF) {
+        throw std::runtime_error("Too many files for a single ZIP archive");
+    }
+    uint64_t central_offset = offset_;
+    std::string central;
+    for (const auto& e : entries_) {
+        put32(central, CENTRAL_HEADER_SIG);
+        put16(central, MADE_BY_UNIX | version_needed(e.codec));
+        put16(central, version_needed(e.codec));
+        put16(central, FLAGS);
+        put16(central, static_cast<uint16_t>(e.codec));
+        put16(central, e.dos_time);
+        put16(central, e.dos_date);
+        put32(central, e.crc);
+        put32(central, static_cast<uint32_t>(e.compressed_size));
+        put32(central, static_cast<uint32_t>(e.uncompressed_size));
+        put16(central, static_cast<uint16_t>(e.name.size()));
+        put16(central, 0);  // extra field length
+        put16(central, 0);  // comment length
+        put16(central, 0);  // disk number
+        put16(central, 0);  // internal attributes
+        put32(central, e.mode << 16);
+        put32(central, static_cast<uint32_t>(e.header_offset));
+        central += e.name;
+    }
+    if (central_offset + central.size() > ZIP32_LIMIT) {
+        throw std::runtime_error("Archive exceeds the 4 GiB ZIP limit");
+    }
+    emit(central.data(), central.size());
+
+    std::string end;
+    put32(end, END_OF_CENTRAL_SIG);
+    put16(end, 0);
+    put16(end, 0);
+    put16(end, static_cast<uint16_t>(entries_.size()));
+    put16(end, static_cast<uint16_t>(entries_.size()));
+    put32(end, static_cast<uint32_t>(central.size()));
+    put32(end, static_cast<uint32_t>(central_offset));
+    put16(end, 0);
+    emit(end.data(), end.size());
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "codec.h"
+
+// Pull-based ZIP writer. Entries are read, deflated and emitted in fixed-size
+// chunks on demand, so memory stays bounded by the chunk size plus one central
+// directory record per entry, whatever the size of the archived files.
+//
+// Each entry is stored, deflated or zstd-compressed according to the codec
+// policy, judged from its first chunk.
+//
+// Files up to PARALLEL_MAX_SIZE are compressed ahead of the writer on a worker
+// pool, bounded by IN_FLIGHT_LIMIT bytes of source data, and emitted in
+// queue order. Larger files are streamed on the calling thread.
+class ZipStream {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr uint64_t PARALLEL_MAX_SIZE = 8 * 1024 * 1024;
+    static constexpr uint64_t IN_FLIGHT_LIMIT = 128 * 1024 * 1024;
+
+    // threads: compression workers; 0 means one per core, 1 disables the pool
+    explicit ZipStream(unsigned threads = 0);
+    ~ZipStream();
+    ZipStream(const ZipStream&) = delete;
+    ZipStream& operator=(const ZipStream&) = delete;
+
+    // Set the codec policy; call before queueing entries. A zstd dictionary
+    // is shipped as a stored ZSTD_DICTIONARY_ENTRY at the front of the archive.
+    void set_codec_policy(const CodecPolicy& policy);
+
+    // Queue a file from disk, archived under its relative path. All entries
+    // must be queued before the first read().
+    void add_file(const std::string& path);
+    // Queue an in-memory entry (e.g. the deletion manifest)
+    void add_buffer(const std::string& name, const std::string& data);
+
+    // Copy up to len bytes of archive output into out. Returns 0 once the
+    // archive is complete. Throws std::runtime_error on I/O failures.
+    size_t read(char* out, size_t len);
+
+    bool done() const { return state_ == State::Done; }
+    uint64_t bytes_out() const { return offset_; }
+
+private:
+    class Pool;
+
+    // An entry compressed in one piece by a worker
+    struct Compressed {
+        Codec codec = Codec::Deflate;
+        std::string data;
+        uint32_t crc = 0;
+        uint64_t uncompressed_size = 0;
+        uint32_t mode = 0100644;
+        time_t mtime = 0;
+    };
+
+    struct Entry {
+        std::string name;
+        std::string path;
+        std::string data;
+        bool from_file = false;
+        bool force_store = false;
+        Codec codec = Codec::Deflate;
+        uint32_t crc = 0;
+        uint64_t compressed_size = 0;
+        uint64_t uncompressed_size = 0;
+        uint64_t header_offset = 0;
+        uint32_t mode = 0100644;
+        uint16_t dos_time = 0;
+        uint16_t dos_date = 0;
+        uint64_t source_size = 0;
+        std::future<Compressed> job;
+    };
+
+    enum class State { Header, Data, Descriptor, Done };
+
+    static Compressed compress_file(const std::string& path, const CodecPolicy& policy);
+
+    void dispatch_ahead();
+    void refill();
+    void begin_entry(Entry& e);
+    void write_header(Entry& e);
+    size_t read_input(Entry& e, bool& eof);
+    void pump_data(Entry& e);
+    void write_descriptor(Entry& e);
+    void write_central();
+    void emit(const void* data, size_t len);
+
+    std::vector<Entry> entries_;
+    size_t current_ = 0;
+    State state_ = State::Header;
+
+    std::string pending_;
+    size_t pending_pos_ = 0;
+    uint64_t offset_ = 0;
+
+    CodecPolicy policy_;
+    FILE* file_ = nullptr;
+    size_t data_pos_ = 0;
+    std::unique_ptr<Compressor> compressor_;
+    std::vector<unsigned char> in_buf_;
+    // First chunk of the current entry, read early to choose its codec
+    size_t sample_len_ = 0;
+    bool sample_eof_ = false;
+    bool sample_pending_ = false;
+
+    size_t next_dispatch_ = 0;
+    uint64_t in_flight_bytes_ = 0;
+    // Declared last so workers are joined before the entries they feed go away
+    std::unique_ptr<Pool> pool_;
+};
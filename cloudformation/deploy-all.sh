@@ -123,6 +123,7 @@ deploy_stack "gits-lambdas" "lambdas.yaml" "--capabilities CAPABILITY_IAM" "Proj
 # Update Lambda functions in case they were already created 
 echo "Updating Lambda functions..."
 aws lambda update-function-code --function-name gits-schedule --image-uri $IMAGE_URI_SCHEDULE --region $REGION --no-cli-pager
+aws lambda update-function-code --function-name gits-dispatch --image-uri $IMAGE_URI_SCHEDULE --region $REGION --no-cli-pager
 aws lambda update-function-code --function-name gits-delete --image-uri $IMAGE_URI_DELETE --region $REGION --no-cli-pager
 aws lambda update-function-code --function-name gits-status --image-uri $IMAGE_URI_STATUS --region $REGION --no-cli-pager
 aws lambda update-function-code --function-name gits-codebuildlens --image-uri $IMAGE_URI_CODEBUILD_LENS --region $REGION --no-cli-pager
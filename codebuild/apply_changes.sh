@@ -0,0 +1,76 @@
+#!/bin/sh
+# Apply one changeset of a build's job list to the checked-out repository.
+#
+# Usage: apply_changes.sh <jobs.json> <index>
+#
+# jobs.json is {"jobs": [...]}, each entry with s3_path, changes_format,
+# commit_message, github_display_name and github_email. A bundle brings its
+# own commit; the files of a zip are committed with the entry's message and
+# author. BLOB_STORE and CODEBUILD_SRC_DIR come from the build environment.
+
+JOBS_FILE=$1
+INDEX=$2
+field() {
+  jq -r ".jobs[$INDEX].$1 // empty" "$JOBS_FILE"
+}
+S3_PATH=$(field s3_path)
+CHANGES_FORMAT=$(field changes_format)
+echo "Applying changeset $INDEX ($(field job_id)): $S3_PATH"
+
+# Downloading the changeset from S3: changed files as a zip, or (CHANGES_FORMAT=bundle) a git bundle of the commit
+if [ "$CHANGES_FORMAT" = "bundle" ]; then
+  aws s3 cp --quiet "$S3_PATH" changes.bundle || exit 1
+else
+  aws s3 cp --quiet "$S3_PATH" changes.zip || exit 1
+fi
+
+# Bundle: fast-forward to the user's commit, or replay it if main has moved on since
+if [ -f changes.bundle ]; then
+  git bundle verify -q changes.bundle || exit 1
+  git fetch -q changes.bundle refs/gits/changes || exit 1
+  rm changes.bundle
+  if git merge-base --is-ancestor HEAD FETCH_HEAD; then
+    git merge -q --ff-only FETCH_HEAD || exit 1
+  else
+    echo "main has moved since the bundle was made; replaying its commits"
+    git cherry-pick "$(git merge-base HEAD FETCH_HEAD)..FETCH_HEAD" || exit 1
+  fi
+fi
+
+# Zip: entries may be stored, deflated or zstd-compressed (ZIP method 93)
+if [ -f changes.zip ]; then
+  python3 "$CODEBUILD_SRC_DIR/codebuild/extract_changes.py" changes.zip || exit 1
+  rm changes.zip
+fi
+
+# Fetch large files stored by content hash, verifying each against its sha256
+for MANIFEST_FILE in .gits-manifest-*.json; do
+  [ -e "$MANIFEST_FILE" ] || continue
+  jq -r '.blobs[]? | "\(.sha256) \(.mode) \(.path)"' "$MANIFEST_FILE" | while read -r SHA MODE FILE_PATH; do
+    [ -z "$FILE_PATH" ] && continue
+    mkdir -p "$(dirname "$FILE_PATH")"
+    aws s3 cp --quiet "$BLOB_STORE/$SHA" "$FILE_PATH" || exit 1
+    echo "$SHA  $FILE_PATH" | sha256sum -c --quiet - || exit 1
+    chmod "$MODE" "$FILE_PATH"
+  done || exit 1
+done
+
+# Apply deletions from any manifest(s) if present
+for MANIFEST_FILE in .gits-manifest-*.json; do
+  [ -e "$MANIFEST_FILE" ] || continue
+  echo "Found manifest: $MANIFEST_FILE"
+  jq -r '.deleted[]? // empty' "$MANIFEST_FILE" 2>/dev/null | while IFS= read -r path; do
+    [ -z "$path" ] && continue
+    git rm -q --ignore-unmatch -- "$path" || true
+  done
+  rm -f "$MANIFEST_FILE"
+done
+
+# Commit as the job's author
+AUTHOR_NAME=$(field github_display_name)
+AUTHOR_EMAIL=$(field github_email)
+[ -n "$AUTHOR_NAME" ] && export GIT_AUTHOR_NAME="$AUTHOR_NAME" GIT_COMMITTER_NAME="$AUTHOR_NAME"
+[ -n "$AUTHOR_EMAIL" ] && export GIT_AUTHOR_EMAIL="$AUTHOR_EMAIL" GIT_COMMITTER_EMAIL="$AUTHOR_EMAIL"
+MSG=$(field commit_message)
+git add .
+git commit -m "${MSG:-Applied changes using gits}" || echo "No changes to commit"
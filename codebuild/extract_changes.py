@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+Extract a gits changeset zip into the current directory.
+
+Handles every method the CLI writes: store (0) and deflate (8) through
+zipfile, and zstd (93) through the zstandard module, using the dictionary
+shipped as .gits-zstd-dict when present. CRCs and unix modes are checked
+and restored like `unzip` does.
+
+Usage: extract_changes.py <changes.zip>
+"""
+
+import os
+import struct
+import sys
+import zipfile
+import zlib
+
+ZSTD = 93
+DICTIONARY_ENTRY = ".gits-zstd-dict"
+LOCAL_HEADER = struct.Struct("<IHHHHHIIIHH")
+
+
+def safe_path(name):
+    path = os.path.normpath(name)
+    if os.path.isabs(path) or path == ".." or path.startswith(".." + os.sep):
+        sys.exit(f"Refusing to extract outside the work tree: {name}")
+    return path
+
+
+def raw_entry(archive_file, info):
+    archive_file.seek(info.header_offset)
+    fields = LOCAL_HEADER.unpack(archive_file.read(LOCAL_HEADER.size))
+    name_len, extra_len = fields[9], fields[10]
+    archive_file.seek(info.header_offset + LOCAL_HEADER.size + name_len + extra_len)
+    return archive_file.read(info.compress_size)
+
+
+def zstd_decompressor(archive, archive_file):
+    import zstandard
+
+    try:
+        info = archive.getinfo(DICTIONARY_ENTRY)
+    except KeyError:
+        return zstandard.ZstdDecompressor()
+    dictionary = zstandard.ZstdCompressionDict(raw_entry(archive_file, info))
+    return zstandard.ZstdDecompressor(dict_data=dictionary)
+
+
+def iter_entries(archive_file):
+    """Yield (ZipInfo, bytes) for every entry, checking each CRC."""
+    with zipfile.ZipFile(archive_file) as archive:
+        zstd = None
+        for info in archive.infolist():
+            if info.filename == DICTIONARY_ENTRY:
+                continue
+            if info.is_dir():
+                yield info, b""
+                continue
+            if info.compress_type == ZSTD:
+                if zstd is None:
+                    zstd = zstd_decompressor(archive, archive_file)
+                data = zstd.decompressobj().decompress(raw_entry(archive_file, info))
+            else:
+                data = archive.read(info)
+            if zlib.crc32(data) != info.CRC or len(data) != info.file_size:
+                sys.exit(f"Corrupt entry in changeset: {info.filename}")
+            yield info, data
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__.strip().splitlines()[-1])
+
+    with open(sys.argv[1], "rb") as archive_file:
+        for info, data in iter_entries(archive_file):
+            path = safe_path(info.filename)
+            if info.is_dir():
+                os.makedirs(path, exist_ok=True)
+                continue
+            parent = os.path.dirname(path)
+            if parent:
+                os.makedirs(parent, exist_ok=True)
+            if os.path.islink(path):
+                os.unlink(path)
+            with open(path, "wb") as out:
+                out.write(data)
+            mode = (info.external_attr >> 16) & 0o777
+            if mode:
+                os.chmod(path, mode)
+            print(f"  inflating: {info.filename}")
+
+
+if __name__ == "__main__":
+    main()
@@ -11,6 +11,8 @@
 #include <iostream>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 #include <chrono>
 
 using namespace aws::lambda_runtime;
@@ -67,18 +69,21 @@ invocation_response lambda_handler(invocation_request const& request, CodeBuildC
         auto build = batch_outcome.GetResult().GetBuilds()[0];
         auto env_vars = build.GetEnvironment().GetEnvironmentVariables();
 
-        // Extract user_id
+        // Extract user_id, and the jobs of builds started by the dispatcher
+        // (several when it coalesced them)
         std::string user_id;
+        std::string job_keys;
         for (const auto& var : env_vars) {
             if (var.GetName() == "USER_ID") {
                 user_id = var.GetValue();
-                break;
+            } else if (var.GetName() == "JOB_KEYS") {
+                job_keys = var.GetValue();
             }
         }
 
         std::cout << "Extracted user_id: " << user_id << std::endl;
 
-        if (user_id.empty()) {
+        if (user_id.empty() && job_keys.empty()) {
             std::cerr << "USER_ID not found in build environment variables" << std::endl;
             return invocation_response::success(create_response(400, "USER_ID not found").View().WriteCompact(), "application/json");
         }
@@ -89,50 +94,87 @@ invocation_response lambda_handler(invocation_request const& request, CodeBuildC
             return invocation_response::success(create_response(500, "Configuration error").View().WriteCompact(), "application/json");
         }
 
-        // Query for the most recent item
-        std::cout << "Querying DynamoDB for user_id: " << user_id << std::endl;
-        QueryRequest query_request;
-        query_request.SetTableName(table_name);
-        Aws::String key_condition = "user_id = :user_id";
-        query_request.SetKeyConditionExpression(key_condition);
-        AttributeValue user_id_attr;
-        user_id_attr.SetS(user_id);
-        query_request.AddExpressionAttributeValues(":user_id", user_id_attr);
-        query_request.SetScanIndexForward(false);
-        query_request.SetLimit(1);
-
-        auto query_outcome = dynamodb_client.Query(query_request);
-        if (!query_outcome.IsSuccess() || query_outcome.GetResult().GetItems().empty()) {
-            std::cerr << "No item found for user " << user_id << std::endl;
-            return invocation_response::success(create_response(404, "No item found").View().WriteCompact(), "application/json");
+        // Table keys (user_id, added_at) of the jobs this build ran
+        std::vector<std::pair<std::string, std::string>> jobs;
+        if (!job_keys.empty()) {
+            JsonValue keys_json(job_keys);
+            if (!keys_json.WasParseSuccessful()) {
+                std::cerr << "JOB_KEYS is not valid JSON" << std::endl;
+                return invocation_response::success(create_response(400, "Invalid JOB_KEYS").View().WriteCompact(), "application/json");
+            }
+            auto keys = keys_json.View().AsArray();
+            for (size_t i = 0; i < keys.GetLength(); ++i) {
+                jobs.emplace_back(keys[i].GetString("user_id"), keys[i].GetString("added_at"));
+            }
+        } else {
+            // Builds from per-job rules only name the user: theirs is the most recent item
+            std::cout << "Querying DynamoDB for user_id: " << user_id << std::endl;
+            QueryRequest query_request;
+            query_request.SetTableName(table_name);
+            Aws::String key_condition = "user_id = :user_id";
+            query_request.SetKeyConditionExpression(key_condition);
+            AttributeValue user_id_attr;
+            user_id_attr.SetS(user_id);
+            query_request.AddExpressionAttributeValues(":user_id", user_id_attr);
+            query_request.SetScanIndexForward(false);
+            query_request.SetLimit(1);
+
+            auto query_outcome = dynamodb_client.Query(query_request);
+            if (!query_outcome.IsSuccess() || query_outcome.GetResult().GetItems().empty()) {
+                std::cerr << "No item found for user " << user_id << std::endl;
+                return invocation_response::success(create_response(404, "No item found").View().WriteCompact(), "application/json");
+            }
+
+            auto item = query_outcome.GetResult().GetItems()[0];
+            jobs.emplace_back(user_id, item.at("added_at").GetN());
         }
 
-        auto item = query_outcome.GetResult().GetItems()[0];
-        std::string added_at = item.at("added_at").GetN();
-
-        // Update the status
-        std::cout << "Updating status for user " << user_id << " to " << build_status << std::endl;
-        UpdateItemRequest update_request;
-        update_request.SetTableName(table_name);
-        AttributeValue pk_user_id;
-        pk_user_id.SetS(user_id);
-        AttributeValue sk_added_at;
-        sk_added_at.SetN(added_at);
-        update_request.AddKey("user_id", pk_user_id);
-        update_request.AddKey("added_at", sk_added_at);
-        update_request.SetUpdateExpression("SET #s = :val");
-        update_request.AddExpressionAttributeNames("#s", "status");
-        AttributeValue status_attr;
-        status_attr.SetS(build_status);
-        update_request.AddExpressionAttributeValues(":val", status_attr);
-
-        auto update_outcome = dynamodb_client.UpdateItem(update_request);
-        if (!update_outcome.IsSuccess()) {
-            std::cerr << "Error updating DynamoDB: " << update_outcome.GetError().GetMessage() << std::endl;
+        // Update the status of each job
+        size_t updated = 0;
+        for (const auto& job : jobs) {
+            std::cout << "Updating status for user " << job.first << ", added_at " << job.second << " to " << build_status << std::endl;
+            UpdateItemRequest update_request;
+            update_request.SetTableName(table_name);
+            AttributeValue pk_user_id;
+            pk_user_id.SetS(job.first);
+            AttributeValue sk_added_at;
+            sk_added_at.SetN(job.second);
+            update_request.AddKey("user_id", pk_user_id);
+            update_request.AddKey("added_at", sk_added_at);
+            // The version feeds the status endpoint's ETag. Jobs of the
+            // dispatcher also get the build id, which takes them out of its
+            // dispatching bucket should it have failed to record it.
+            if (job_keys.empty()) {
+                update_request.SetUpdateExpression("SET #s = :val ADD #v :one");
+            } else {
+                update_request.SetUpdateExpression("SET #s = :val, build_id = :build_id REMOVE due_bucket ADD #v :one");
+                AttributeValue build_id_attr;
+                build_id_attr.SetS(build_id);
+                update_request.AddExpressionAttributeValues(":build_id", build_id_attr);
+            }
+            // A job deleted meanwhile stays deleted
+            update_request.SetConditionExpression("attribute_exists(user_id)");
+            update_request.AddExpressionAttributeNames("#s", "status");
+            update_request.AddExpressionAttributeNames("#v", "version");
+            AttributeValue status_attr;
+            status_attr.SetS(build_status);
+            update_request.AddExpressionAttributeValues(":val", status_attr);
+            AttributeValue one_attr;
+            one_attr.SetN("1");
+            update_request.AddExpressionAttributeValues(":one", one_attr);
+
+            auto update_outcome = dynamodb_client.UpdateItem(update_request);
+            if (!update_outcome.IsSuccess()) {
+                std::cerr << "Error updating DynamoDB: " << update_outcome.GetError().GetMessage() << std::endl;
+                continue;
+            }
+            ++updated;
+        }
+        if (updated == 0) {
             return invocation_response::success(create_response(500, "Internal error").View().WriteCompact(), "application/json");
         }
 
-        std::cout << "Successfully updated status for user " << user_id << std::endl;
+        std::cout << "Successfully updated status of " << updated << " of " << jobs.size() << " job(s)" << std::endl;
         return invocation_response::success(create_response(200, "Success").View().WriteCompact(), "application/json");
 
     } catch (const std::exception& e) {
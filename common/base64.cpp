@@ -0,0 +1,314 @@
+#include "base64.h"
+
+#include <cstdint>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GITS_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Character -> 6-bit value, 0xff for characters outside the alphabet
+struct DecodeTable {
+    uint8_t value[256];
+    DecodeTable() {
+        for (auto& v : value) v = 0xff;
+        for (uint8_t i = 0; i < 64; ++i) value[static_cast<uint8_t>(ALPHABET[i])] = i;
+    }
+};
+
+const DecodeTable DECODE;
+
+// Encodes whole 3-byte groups and the padded tail
+size_t encode_scalar(const unsigned char* in, size_t n, char* out) {
+    char* start = out;
+    size_t i = 0;
+    for (; i + 3 <= n; i += 3) {
+        uint32_t v = (uint32_t(in[i]) << 16) | (uint32_t(in[i + 1]) << 8) | in[i + 2];
+        *out++ = ALPHABET[v >> 18];
+        *out++ = ALPHABET[(v >> 12) & 63];
+        *out++ = ALPHABET[(v >> 6) & 63];
+        *out++ = ALPHABET[v & 63];
+    }
+    if (i < n) {
+        uint32_t v = uint32_t(in[i]) << 16;
+        if (i + 1 < n) v |= uint32_t(in[i + 1]) << 8;
+        *out++ = ALPHABET[v >> 18];
+        *out++ = ALPHABET[(v >> 12) & 63];
+        *out++ = i + 1 < n ? ALPHABET[(v >> 6) & 63] : '=';
+        *out++ = '=';
+    }
+    return out - start;
+}
+
+// Decodes 4-character groups; only the last may carry padding
+bool decode_scalar(const char* in, size_t n, unsigned char* out, size_t& out_len) {
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(in);
+    unsigned char* start = out;
+    for (size_t i = 0; i < n; i += 4) {
+        uint8_t a = DECODE.value[s[i]], b = DECODE.value[s[i + 1]];
+        uint8_t c = DECODE.value[s[i + 2]], d = DECODE.value[s[i + 3]];
+        if (((a | b | c | d) & 0xc0) == 0) {
+            uint32_t v = (uint32_t(a) << 18) | (uint32_t(b) << 12) | (uint32_t(c) << 6) | d;
+            *out++ = static_cast<unsigned char>(v >> 16);
+            *out++ = static_cast<unsigned char>(v >> 8);
+            *out++ = static_cast<unsigned char>(v);
+            continue;
+        }
+        // "xx==" or "xxx=" ends the input
+        if (i + 4 != n || (a | b) & 0xc0 || s[i + 3] != '=') return false;
+        *out++ = static_cast<unsigned char>((a << 2) | (b >> 4));
+        if (s[i + 2] != '=') {
+            if (c & 0xc0) return false;
+            *out++ = static_cast<unsigned char>((b << 4) | (c >> 2));
+        }
+    }
+    out_len = out - start;
+    return true;
+}
+
+#ifdef GITS_BASE64_X86
+
+// The vector loops follow Wojciech Mula's and Alfred Klomp's base64 work:
+// a shuffle spreads 3 bytes over 4 lanes, two multiplies move each 6-bit
+// field into place, and a 16-entry shuffle table maps values to characters
+// (and back, with a second pair of tables flagging invalid characters).
+
+__attribute__((target("ssse3")))
+__m128i enc_reshuffle(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+__attribute__((target("ssse3")))
+__m128i enc_translate(__m128i in) {
+    const __m128i lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                      '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i index = _mm_subs_epu8(in, _mm_set1_epi8(51));
+    const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), in);
+    index = _mm_or_si128(index, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(in, _mm_shuffle_epi8(lut, index));
+}
+
+// 12 bytes in, 16 characters out; reads 16 bytes
+__attribute__((target("ssse3")))
+size_t encode_ssse3(const unsigned char* in, size_t n, char* out) {
+    size_t i = 0, o = 0;
+    for (; n - i >= 16; i += 12, o += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), enc_translate(enc_reshuffle(v)));
+    }
+    return o + encode_scalar(in + i, n - i, out + o);
+}
+
+__attribute__((target("avx2")))
+__m256i enc_reshuffle_avx2(__m256i in) {
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    in = _mm256_shuffle_epi8(in, shuffle);
+    const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(t1, t3);
+}
+
+__attribute__((target("avx2")))
+__m256i enc_translate_avx2(__m256i in) {
+    const __m256i lut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                         '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                         'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                         '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m256i index = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+    const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), in);
+    index = _mm256_or_si256(index, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(in, _mm256_shuffle_epi8(lut, index));
+}
+
+// 24 bytes in (12 per 128-bit lane), 32 characters out; reads 28 bytes
+__attribute__((target("avx2")))
+size_t encode_avx2(const unsigned char* in, size_t n, char* out) {
+    size_t i = 0, o = 0;
+    for (; n - i >= 28; i += 24, o += 32) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o), enc_translate_avx2(enc_reshuffle_avx2(v)));
+    }
+    return o + encode_ssse3(in + i, n - i, out + o);
+}
+
+// Lookup tables for decoding. An input byte is valid when the entries for
+// its low and high nibble share no bit; the roll table holds the offset
+// from each character range to its value.
+#define GITS_DEC_LUT_LO 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+#define GITS_DEC_LUT_HI 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+#define GITS_DEC_LUT_ROLL 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+
+// 16 characters to 6-bit values; false if any is outside the alphabet
+__attribute__((target("ssse3")))
+bool dec_translate(__m128i& v) {
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+    const __m128i lo_nibbles = _mm_and_si128(v, mask_2f);
+    const __m128i hi = _mm_shuffle_epi8(_mm_setr_epi8(GITS_DEC_LUT_HI), hi_nibbles);
+    const __m128i lo = _mm_shuffle_epi8(_mm_setr_epi8(GITS_DEC_LUT_LO), lo_nibbles);
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0) return false;
+    const __m128i eq_2f = _mm_cmpeq_epi8(v, mask_2f);
+    v = _mm_add_epi8(v, _mm_shuffle_epi8(_mm_setr_epi8(GITS_DEC_LUT_ROLL), _mm_add_epi8(eq_2f, hi_nibbles)));
+    return true;
+}
+
+// Packs 4 6-bit values per 32-bit lane into 3 bytes, 12 bytes at the bottom
+__attribute__((target("ssse3")))
+__m128i dec_reshuffle(__m128i v) {
+    const __m128i ab_bc = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+    const __m128i out = _mm_madd_epi16(ab_bc, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(out, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+// 16 characters in, 12 bytes out; writes 16 bytes, so it stops while at
+// least 32 characters are left. Padding and invalid characters end the
+// loop and the scalar decoder takes over (and rejects the latter).
+__attribute__((target("ssse3")))
+bool decode_ssse3(const char* in, size_t n, unsigned char* out, size_t& out_len) {
+    size_t i = 0, o = 0;
+    for (; n - i >= 32; i += 16, o += 12) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        if (!dec_translate(v)) break;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), dec_reshuffle(v));
+    }
+    size_t tail = 0;
+    if (!decode_scalar(in + i, n - i, out + o, tail)) return false;
+    out_len = o + tail;
+    return true;
+}
+
+__attribute__((target("avx2")))
+bool dec_translate_avx2(__m256i& v) {
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_2f);
+    const __m256i lo_nibbles = _mm256_and_si256(v, mask_2f);
+    const __m256i hi = _mm256_shuffle_epi8(_mm256_setr_epi8(GITS_DEC_LUT_HI, GITS_DEC_LUT_HI), hi_nibbles);
+    const __m256i lo = _mm256_shuffle_epi8(_mm256_setr_epi8(GITS_DEC_LUT_LO, GITS_DEC_LUT_LO), lo_nibbles);
+    if (!_mm256_testz_si256(lo, hi)) return false;
+    const __m256i eq_2f = _mm256_cmpeq_epi8(v, mask_2f);
+    const __m256i roll = _mm256_setr_epi8(GITS_DEC_LUT_ROLL, GITS_DEC_LUT_ROLL);
+    v = _mm256_add_epi8(v, _mm256_shuffle_epi8(roll, _mm256_add_epi8(eq_2f, hi_nibbles)));
+    return true;
+}
+
+__attribute__((target("avx2")))
+__m256i dec_reshuffle_avx2(__m256i v) {
+    const __m256i ab_bc = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+    __m256i out = _mm256_madd_epi16(ab_bc, _mm256_set1_epi32(0x00011000));
+    out = _mm256_shuffle_epi8(out, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    // Close the gap between the two lanes' 12 bytes
+    return _mm256_permutevar8x32_epi32(out, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+
+// 32 characters in, 24 bytes out; writes 32 bytes
+__attribute__((target("avx2")))
+bool decode_avx2(const char* in, size_t n, unsigned char* out, size_t& out_len) {
+    size_t i = 0, o = 0;
+    for (; n - i >= 48; i += 32, o += 24) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        if (!dec_translate_avx2(v)) break;
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o), dec_reshuffle_avx2(v));
+    }
+    size_t tail = 0;
+    if (!decode_ssse3(in + i, n - i, out + o, tail)) return false;
+    out_len = o + tail;
+    return true;
+}
+
+#undef GITS_DEC_LUT_LO
+#undef GITS_DEC_LUT_HI
+#undef GITS_DEC_LUT_ROLL
+
+#endif
+
+bool supported(Base64Impl impl) {
+#ifdef GITS_BASE64_X86
+    switch (impl) {
+        case Base64Impl::Avx2: return __builtin_cpu_supports("avx2");
+        case Base64Impl::Ssse3: return __builtin_cpu_supports("ssse3");
+        case Base64Impl::Scalar: return true;
+    }
+    return false;
+#else
+    return impl == Base64Impl::Scalar;
+#endif
+}
+
+Base64Impl& selected() {
+    static Base64Impl impl = base64_best();
+    return impl;
+}
+
+}  // namespace
+
+size_t base64_encode(const unsigned char* in, size_t n, char* out) {
+    switch (selected()) {
+#ifdef GITS_BASE64_X86
+        case Base64Impl::Avx2: return encode_avx2(in, n, out);
+        case Base64Impl::Ssse3: return encode_ssse3(in, n, out);
+#endif
+        default: return encode_scalar(in, n, out);
+    }
+}
+
+bool base64_decode(const char* in, size_t n, unsigned char* out, size_t& out_len) {
+    if (n % 4 != 0) return false;
+    switch (selected()) {
+#ifdef GITS_BASE64_X86
+        case Base64Impl::Avx2: return decode_avx2(in, n, out, out_len);
+        case Base64Impl::Ssse3: return decode_ssse3(in, n, out, out_len);
+#endif
+        default: return decode_scalar(in, n, out, out_len);
+    }
+}
+
+Base64Impl base64_best() {
+    if (supported(Base64Impl::Avx2)) return Base64Impl::Avx2;
+    if (supported(Base64Impl::Ssse3)) return Base64Impl::Ssse3;
+    return Base64Impl::Scalar;
+}
+
+Base64Impl base64_current() {
+    return selected();
+}
+
+bool base64_use(Base64Impl impl) {
+    if (!supported(impl)) return false;
+    selected() = impl;
+    return true;
+}
+
+const char* base64_name(Base64Impl impl) {
+    switch (impl) {
+        case Base64Impl::Avx2: return "avx2";
+        case Base64Impl::Ssse3: return "ssse3";
+        case Base64Impl::Scalar: return "scalar";
+    }
+    return "scalar";
+}
+
+std::string sha256_checksum(const std::string& hex) {
+    std::vector<unsigned char> digest(hex.size() / 2);
+    for (size_t i = 0; i < digest.size(); ++i) {
+        digest[i] = static_cast<unsigned char>(std::stoi(hex.substr(2 * i, 2), nullptr, 16));
+    }
+    std::string out(base64_encoded_size(digest.size()), '\0');
+    out.resize(base64_encode(digest.data(), digest.size(), &out[0]));
+    return out;
+}
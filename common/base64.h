@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Base64 (RFC 4648, standard alphabet, '=' padding, no line breaks) shared by
+// the gits CLI and the schedule lambda. Both sides compile base64.cpp into
+// their own targets. The AVX2 or SSSE3 loop is picked at runtime from what the
+// CPU supports, with a scalar loop for other CPUs and for the tails.
+
+enum class Base64Impl { Scalar, Ssse3, Avx2 };
+
+// Function to get the length of the encoding of n bytes, padding included
+inline size_t base64_encoded_size(size_t n) {
+    return (n + 2) / 3 * 4;
+}
+
+// Function to get the most bytes n characters of base64 can decode to
+inline size_t base64_decoded_max_size(size_t n) {
+    return n / 4 * 3;
+}
+
+// Function to encode n bytes into out, which must hold base64_encoded_size(n)
+// characters. Returns the number of characters written; out is not
+// null-terminated.
+size_t base64_encode(const unsigned char* in, size_t n, char* out);
+
+// Function to decode n characters into out, which must hold
+// base64_decoded_max_size(n) bytes. Returns false for input that is not
+// padded base64; out_len is the number of bytes written otherwise. out may
+// be in itself, decoding in place: no write gets ahead of the input read.
+bool base64_decode(const char* in, size_t n, unsigned char* out, size_t& out_len);
+
+// Function to get the fastest implementation this CPU supports
+Base64Impl base64_best();
+
+// Function to get the implementation in use (base64_best() unless changed)
+Base64Impl base64_current();
+
+// Function to switch implementation, for benchmarks and tests. Returns false,
+// changing nothing, when the CPU does not support it. Not thread-safe.
+bool base64_use(Base64Impl impl);
+
+// Function to name an implementation: "scalar", "ssse3" or "avx2"
+const char* base64_name(Base64Impl impl);
+
+// Function to get the x-amz-checksum-sha256 value (base64 of the raw digest)
+// for a hex SHA-256, which the CLI sends with a blob and the schedule lambda
+// signs into the blob's upload URL
+std::string sha256_checksum(const std::string& hex);
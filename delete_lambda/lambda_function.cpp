@@ -6,6 +6,7 @@
 #include <aws/eventbridge/model/RemoveTargetsRequest.h>
 #include <aws/eventbridge/model/DeleteRuleRequest.h>
 #include <aws/dynamodb/DynamoDBClient.h>
+#include <aws/dynamodb/DynamoDBErrors.h>
 #include <aws/dynamodb/model/QueryRequest.h>
 #include <aws/dynamodb/model/DeleteItemRequest.h>
 #include <aws/dynamodb/model/AttributeValue.h>
@@ -120,41 +121,55 @@ invocation_response lambda_handler(invocation_request const& request, EventBridg
                 return invocation_response::success(create_response(400, error_body).View().WriteCompact(), "application/json");
             }
 
-            // Only if pending, remove the CodeBuild target job (EventBridge rule)
-            std::cout << "Deleting EventBridge rule: " << job_id << std::endl;
-            try {
-                // First remove targets
-                RemoveTargetsRequest remove_targets_request;
-                remove_targets_request.SetRule(job_id);
-                remove_targets_request.SetIds({"Target1"});
-                remove_targets_request.SetForce(true);
-                auto remove_outcome = events_client.RemoveTargets(remove_targets_request);
-                if (!remove_outcome.IsSuccess()) {
-                    std::cerr << "Warning: Failed to remove targets: " << remove_outcome.GetError().GetMessage() << std::endl;
-                }
+            // A job the dispatcher has started is past unscheduling, even
+            // before its build reports a status
+            if (item.count("dispatched_at")) {
+                std::cerr << "Cannot unschedule a job that is not pending. Dispatched at: " << item.at("dispatched_at").GetN() << std::endl;
+                JsonValue error_body;
+                error_body.WithString("error", "Cannot unschedule a job that is not pending");
+                return invocation_response::success(create_response(400, error_body).View().WriteCompact(), "application/json");
+            }
 
-                // Then delete the rule
-                DeleteRuleRequest delete_rule_request;
-                delete_rule_request.SetName(job_id);
-                delete_rule_request.SetForce(true);
-                auto delete_outcome = events_client.DeleteRule(delete_rule_request);
-                if (!delete_outcome.IsSuccess()) {
-                    if (delete_outcome.GetError().GetErrorType() == EventBridgeErrors::RESOURCE_NOT_FOUND) {
-                        std::cerr << "Rule " << job_id << " not found" << std::endl;
+            // Jobs waiting for the dispatcher are just the item. Jobs scheduled
+            // before it each have an EventBridge rule targeting CodeBuild,
+            // which goes first.
+            bool queued = item.count("due_bucket") > 0;
+            if (!queued) {
+                std::cout << "Deleting EventBridge rule: " << job_id << std::endl;
+                try {
+                    // First remove targets
+                    RemoveTargetsRequest remove_targets_request;
+                    remove_targets_request.SetRule(job_id);
+                    remove_targets_request.SetIds({"Target1"});
+                    remove_targets_request.SetForce(true);
+                    auto remove_outcome = events_client.RemoveTargets(remove_targets_request);
+                    if (!remove_outcome.IsSuccess()) {
+                        std::cerr << "Warning: Failed to remove targets: " << remove_outcome.GetError().GetMessage() << std::endl;
+                    }
+
+                    // Then delete the rule
+                    DeleteRuleRequest delete_rule_request;
+                    delete_rule_request.SetName(job_id);
+                    delete_rule_request.SetForce(true);
+                    auto delete_outcome = events_client.DeleteRule(delete_rule_request);
+                    if (!delete_outcome.IsSuccess()) {
+                        if (delete_outcome.GetError().GetErrorType() == EventBridgeErrors::RESOURCE_NOT_FOUND) {
+                            std::cerr << "Rule " << job_id << " not found" << std::endl;
+                        } else {
+                            std::cerr << "Failed to delete EventBridge rule: " << delete_outcome.GetError().GetMessage() << std::endl;
+                            JsonValue error_body;
+                            error_body.WithString("error", "Failed to delete EventBridge rule: " + delete_outcome.GetError().GetMessage());
+                            return invocation_response::success(create_response(500, error_body).View().WriteCompact(), "application/json");
+                        }
                     } else {
-                        std::cerr << "Failed to delete EventBridge rule: " << delete_outcome.GetError().GetMessage() << std::endl;
-                        JsonValue error_body;
-                        error_body.WithString("error", "Failed to delete EventBridge rule: " + delete_outcome.GetError().GetMessage());
-                        return invocation_response::success(create_response(500, error_body).View().WriteCompact(), "application/json");
+                        std::cout << "Deleted EventBridge rule: " << job_id << std::endl;
                     }
-                } else {
-                    std::cout << "Deleted EventBridge rule: " << job_id << std::endl;
+                } catch (const std::exception& e) {
+                    std::cerr << "Error deleting rule: " << e.what() << std::endl;
+                    JsonValue error_body;
+                    error_body.WithString("error", std::string("Error deleting rule: ") + e.what());
+                    return invocation_response::success(create_response(500, error_body).View().WriteCompact(), "application/json");
                 }
-            } catch (const std::exception& e) {
-                std::cerr << "Error deleting rule: " << e.what() << std::endl;
-                JsonValue error_body;
-                error_body.WithString("error", std::string("Error deleting rule: ") + e.what());
-                return invocation_response::success(create_response(500, error_body).View().WriteCompact(), "application/json");
             }
 
             // Delete the item from DynamoDB
@@ -167,8 +182,18 @@ invocation_response lambda_handler(invocation_request const& request, EventBridg
             sk_added_at.SetN(added_at);
             delete_request.AddKey("user_id", pk_user_id);
             delete_request.AddKey("added_at", sk_added_at);
+            // Only while the dispatcher has not claimed it
+            if (queued) {
+                delete_request.SetConditionExpression("attribute_exists(due_bucket) AND attribute_not_exists(dispatched_at)");
+            }
 
             auto delete_outcome = dynamodb_client.DeleteItem(delete_request);
+            if (!delete_outcome.IsSuccess() && delete_outcome.GetError().GetErrorType() == DynamoDBErrors::CONDITIONAL_CHECK_FAILED) {
+                std::cerr << "Cannot unschedule a job that is not pending: dispatched meanwhile" << std::endl;
+                JsonValue error_body;
+                error_body.WithString("error", "Cannot unschedule a job that is not pending");
+                return invocation_response::success(create_response(400, error_body).View().WriteCompact(), "application/json");
+            }
             if (!delete_outcome.IsSuccess()) {
                 std::cerr << "Failed to delete DynamoDB item: " << delete_outcome.GetError().GetMessage() << std::endl;
                 JsonValue error_body;
@@ -177,6 +202,23 @@ invocation_response lambda_handler(invocation_request const& request, EventBridg
             }
 
             std::cout << "Deleted DynamoDB item: user_id=" << user_id << ", job_id=" << job_id << std::endl;
+
+            // Release the idempotency claim so the same changes can be scheduled again
+            if (item.count("idempotency_key")) {
+                DeleteItemRequest claim_request;
+                claim_request.SetTableName(table_name);
+                AttributeValue claim_pk;
+                claim_pk.SetS("idempotency#" + user_id + "#" + item.at("idempotency_key").GetS());
+                AttributeValue claim_sk;
+                claim_sk.SetN("0");
+                claim_request.AddKey("user_id", claim_pk);
+                claim_request.AddKey("added_at", claim_sk);
+                auto claim_outcome = dynamodb_client.DeleteItem(claim_request);
+                if (!claim_outcome.IsSuccess()) {
+                    // Log error but don't fail; the claim expires on its own
+                    std::cerr << "Failed to release idempotency key: " << claim_outcome.GetError().GetMessage() << std::endl;
+                }
+            }
         } catch (const std::exception& e) {
             std::cerr << "Error deleting DB item: " << e.what() << std::endl;
             JsonValue error_body;
@@ -2,22 +2,54 @@
 #include <aws/core/Aws.h>
 #include <aws/core/utils/json/JsonSerializer.h>
 #include <aws/core/utils/memory/stl/SimpleStringStream.h>
+#include <aws/core/utils/stream/PreallocatedStreamBuf.h>
 #include <aws/core/utils/DateTime.h>
-#include <aws/core/utils/base64/Base64.h>
+#include <aws/core/utils/HashingUtils.h>
 #include <aws/s3/S3Client.h>
 #include <aws/s3/model/PutObjectRequest.h>
+#include <aws/s3/model/HeadObjectRequest.h>
+#include <aws/s3/model/DeleteObjectRequest.h>
+#include <aws/s3/model/CreateMultipartUploadRequest.h>
+#include <aws/s3/model/ListPartsRequest.h>
+#include <aws/s3/model/CompleteMultipartUploadRequest.h>
+#include <aws/s3/S3Errors.h>
+#include <aws/core/http/URI.h>
+#include <aws/core/http/HttpTypes.h>
+#include <aws/core/http/HttpResponse.h>
 #include <aws/eventbridge/EventBridgeClient.h>
-#include <aws/eventbridge/model/PutRuleRequest.h>
-#include <aws/eventbridge/model/PutTargetsRequest.h>
+#include <aws/eventbridge/model/ListRulesRequest.h>
+#include <aws/eventbridge/model/RemoveTargetsRequest.h>
+#include <aws/eventbridge/model/DeleteRuleRequest.h>
 #include <aws/dynamodb/DynamoDBClient.h>
+#include <aws/dynamodb/DynamoDBErrors.h>
 #include <aws/dynamodb/model/PutItemRequest.h>
+#include <aws/dynamodb/model/BatchWriteItemRequest.h>
+#include <aws/dynamodb/model/DeleteItemRequest.h>
+#include <aws/dynamodb/model/GetItemRequest.h>
+#include <aws/dynamodb/model/QueryRequest.h>
+#include <aws/dynamodb/model/UpdateItemRequest.h>
 #include <aws/dynamodb/model/AttributeValue.h>
+#include <aws/codebuild/CodeBuildClient.h>
+#include <aws/codebuild/CodeBuildErrors.h>
+#include <aws/codebuild/model/StartBuildRequest.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <chrono>
 #include <ctime>
 #include <iomanip>
+#include <map>
+#include <set>
 #include <sstream>
+#include <string_view>
+#include <future>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+#include "base64.h"
 
 using namespace aws::lambda_runtime;
 using namespace Aws::Utils::Json;
@@ -30,7 +62,7 @@ using namespace Aws::DynamoDB::Model;
 
 Aws::Utils::DateTime parse_iso8601(const std::string& ts) {
     std::string ts_utc = ts;
-    if (ts.back() == 'Z') {
+    if (!ts.empty() && ts.back() == 'Z') {
         ts_utc = ts.substr(0, ts.size() - 1) + "+0000";
     }
     return Aws::Utils::DateTime(ts_utc.c_str(), Aws::Utils::DateFormat::ISO_8601);
@@ -50,7 +82,1334 @@ JsonValue create_response(int status, const JsonValue& body) {
     return response;
 }
 
-invocation_response lambda_handler(invocation_request const& request, S3Client& s3_client, EventBridgeClient& events_client, DynamoDBClient& dynamodb_client) {
+invocation_response error_response(int status, const std::string& message) {
+    JsonValue error_body;
+    error_body.WithString("error", message);
+    return invocation_response::success(create_response(status, error_body).View().WriteCompact(), "application/json");
+}
+
+// Pre-signed PUT URLs stay valid long enough for a slow upload to start
+const uint64_t UPLOAD_URL_EXPIRY_SECONDS = 15 * 60;
+
+// Changes are stored under changes-<epoch>/<user>/<file>, <user> being the
+// hex SHA-256 of the user_id, so a key is only valid for the user it was
+// issued to
+std::string user_key_dir(const std::string& user_id) {
+    return std::string(Aws::Utils::HashingUtils::HexEncode(Aws::Utils::HashingUtils::CalculateSHA256(user_id)));
+}
+
+std::string changes_key(const std::string& user_id, const std::string& zip_filename) {
+    auto now_tt = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    return "changes-" + std::to_string(now_tt) + "/" + user_key_dir(user_id) + "/" + zip_filename;
+}
+
+// Keys handed to clients always look like changes-<epoch>/<user>/<file>;
+// anything else could point a build at an arbitrary object in the bucket, or
+// at another user's changes
+bool is_changes_key(const std::string& key, const std::string& user_id) {
+    if (key.rfind("changes-", 0) != 0 || key.find("..") != std::string::npos) return false;
+    size_t dir = key.find('/');
+    std::string user_dir = "/" + user_key_dir(user_id) + "/";
+    return dir != std::string::npos && key.compare(dir, user_dir.size(), user_dir) == 0 && key.size() > dir + user_dir.size();
+}
+
+invocation_response handle_upload_url(JsonView view, S3Client& s3_client) {
+    std::string user_id = view.GetString("user_id");
+    std::string zip_filename = view.GetString("zip_filename");
+    if (user_id.empty() || zip_filename.empty() || zip_filename.find('/') != std::string::npos) {
+        std::cerr << "Error: user_id and a plain zip_filename are required" << std::endl;
+        return error_response(400, "user_id and a plain zip_filename are required");
+    }
+
+    std::string bucket = getenv("AWS_BUCKET_NAME") ? getenv("AWS_BUCKET_NAME") : "";
+    std::string key = changes_key(user_id, zip_filename);
+    std::string url = s3_client.GeneratePresignedUrl(bucket, key, Aws::Http::HttpMethod::HTTP_PUT, UPLOAD_URL_EXPIRY_SECONDS);
+    if (url.empty()) {
+        std::cerr << "Error: Failed to pre-sign upload URL for key: " << key << std::endl;
+        return error_response(500, "Failed to pre-sign upload URL");
+    }
+    std::cout << "Pre-signed upload URL issued: user_id=" << user_id << ", key=" << key << std::endl;
+
+    JsonValue body;
+    body.WithString("upload_url", url);
+    body.WithString("s3_key", key);
+    body.WithInt64("expires_in", static_cast<long long>(UPLOAD_URL_EXPIRY_SECONDS));
+    return invocation_response::success(create_response(200, body).View().WriteCompact(), "application/json");
+}
+
+// Large changesets go to S3 in parts over pre-signed UploadPart URLs. Parts are
+// at least 8 MiB (S3 needs 5 MiB) and at most 1000 per upload, which keeps
+// the list of URLs well inside a Lambda response.
+const long long MULTIPART_MIN_PART_SIZE = 8LL * 1024 * 1024;
+const long long MULTIPART_MAX_PARTS = 1000;
+const long long MAX_CHANGES_SIZE = 5LL * 1024 * 1024 * 1024;
+// Part URLs outlive slow connections; an interrupted client asks for new ones
+const long long PART_URL_EXPIRY_SECONDS = 60 * 60;
+
+// Function to pre-sign an UploadPart request. The S3 presigner takes no query
+// parameters, so the object URL it yields is signed again with partNumber and
+// uploadId added.
+std::string presign_part(S3Client& s3_client, const std::string& bucket, const std::string& key, const std::string& upload_id, int part_number) {
+    std::string object_url = s3_client.GeneratePresignedUrl(bucket, key, Aws::Http::HttpMethod::HTTP_PUT, PART_URL_EXPIRY_SECONDS);
+    if (object_url.empty()) return "";
+    Aws::Http::URI uri(object_url.substr(0, object_url.find('?')));
+    uri.AddQueryStringParameter("partNumber", std::to_string(part_number));
+    uri.AddQueryStringParameter("uploadId", upload_id);
+    return s3_client.Aws::Client::AWSClient::GeneratePresignedUrl(uri, Aws::Http::HttpMethod::HTTP_PUT, PART_URL_EXPIRY_SECONDS);
+}
+
+// Function to add {part_number, url} entries for the given parts to body
+bool add_part_urls(JsonValue& body, S3Client& s3_client, const std::string& bucket, const std::string& key, const std::string& upload_id, const std::vector<int>& part_numbers) {
+    Aws::Utils::Array<JsonValue> urls(part_numbers.size());
+    for (size_t i = 0; i < part_numbers.size(); ++i) {
+        std::string url = presign_part(s3_client, bucket, key, upload_id, part_numbers[i]);
+        if (url.empty()) return false;
+        urls[i] = JsonValue().WithInteger("part_number", part_numbers[i]).WithString("url", url);
+    }
+    body.WithArray("part_urls", urls);
+    return true;
+}
+
+// Actions: start (size, zip_filename) creates the upload and returns the part
+// size and every part URL; resume (upload_id, s3_key, part_numbers) returns the
+// parts S3 already holds and URLs for the requested ones it lacks; complete
+// (upload_id, s3_key, parts) assembles the object.
+invocation_response handle_multipart(JsonView view, S3Client& s3_client) {
+    std::string user_id = view.GetString("user_id");
+    std::string action = view.GetString("action");
+    std::string bucket = getenv("AWS_BUCKET_NAME") ? getenv("AWS_BUCKET_NAME") : "";
+    if (user_id.empty()) {
+        std::cerr << "Error: user_id is required" << std::endl;
+        return error_response(400, "user_id is required");
+    }
+
+    if (action == "start") {
+        std::string zip_filename = view.GetString("zip_filename");
+        long long size = view.GetInt64("size");
+        if (zip_filename.empty() || zip_filename.find('/') != std::string::npos || size <= 0 || size > MAX_CHANGES_SIZE) {
+            std::cerr << "Error: a plain zip_filename and a size up to " << MAX_CHANGES_SIZE << " bytes are required" << std::endl;
+            return error_response(400, "A plain zip_filename and a size up to " + std::to_string(MAX_CHANGES_SIZE) + " bytes are required");
+        }
+        long long part_size = std::max(MULTIPART_MIN_PART_SIZE, (size + MULTIPART_MAX_PARTS - 1) / MULTIPART_MAX_PARTS);
+        int part_count = static_cast<int>((size + part_size - 1) / part_size);
+        std::string key = changes_key(user_id, zip_filename);
+
+        CreateMultipartUploadRequest create_request;
+        create_request.SetBucket(bucket);
+        create_request.SetKey(key);
+        auto outcome = s3_client.CreateMultipartUpload(create_request);
+        if (!outcome.IsSuccess()) {
+            std::cerr << "Error: Failed to start multipart upload: " << outcome.GetError().GetMessage() << std::endl;
+            return error_response(500, "Failed to start multipart upload: " + outcome.GetError().GetMessage());
+        }
+        std::string upload_id = outcome.GetResult().GetUploadId();
+        std::vector<int> part_numbers(part_count);
+        for (int i = 0; i < part_count; ++i) part_numbers[i] = i + 1;
+
+        JsonValue body;
+        body.WithString("upload_id", upload_id);
+        body.WithString("s3_key", key);
+        body.WithInt64("part_size", part_size);
+        if (!add_part_urls(body, s3_client, bucket, key, upload_id, part_numbers)) {
+            return error_response(500, "Failed to pre-sign part URLs");
+        }
+        std::cout << "Multipart upload started: user_id=" << user_id << ", key=" << key << ", parts=" << part_count << std::endl;
+        return invocation_response::success(create_response(200, body).View().WriteCompact(), "application/json");
+    }
+
+    std::string upload_id = view.GetString("upload_id");
+    std::string key = view.GetString("s3_key");
+    if (upload_id.empty() || !is_changes_key(key, user_id)) {
+        std::cerr << "Error: upload_id and a valid s3_key are required" << std::endl;
+        return error_response(400, "upload_id and a valid s3_key are required");
+    }
+
+    if (action == "resume") {
+        JsonValue body;
+        Aws::Vector<JsonValue> parts;
+        std::set<int> uploaded;
+        ListPartsRequest list_request;
+        list_request.SetBucket(bucket);
+        list_request.SetKey(key);
+        list_request.SetUploadId(upload_id);
+        for (;;) {
+            auto outcome = s3_client.ListParts(list_request);
+            if (!outcome.IsSuccess()) {
+                if (outcome.GetError().GetErrorType() == S3Errors::NO_SUCH_UPLOAD) {
+                    return error_response(404, "Upload not found: " + upload_id);
+                }
+                std::cerr << "Error: Failed to list parts: " << outcome.GetError().GetMessage() << std::endl;
+                return error_response(500, "Failed to list parts: " + outcome.GetError().GetMessage());
+            }
+            for (const auto& part : outcome.GetResult().GetParts()) {
+                uploaded.insert(part.GetPartNumber());
+                parts.push_back(JsonValue().WithInteger("part_number", part.GetPartNumber()).WithString("etag", part.GetETag()).WithInt64("size", part.GetSize()));
+            }
+            if (!outcome.GetResult().GetIsTruncated()) break;
+            list_request.SetPartNumberMarker(outcome.GetResult().GetNextPartNumberMarker());
+        }
+        std::vector<int> missing;
+        auto requested = view.GetArray("part_numbers");
+        for (size_t i = 0; i < requested.GetLength() && missing.size() < static_cast<size_t>(MULTIPART_MAX_PARTS); ++i) {
+            int part_number = requested[i].AsInteger();
+            if (part_number >= 1 && part_number <= MULTIPART_MAX_PARTS && !uploaded.count(part_number)) missing.push_back(part_number);
+        }
+        body.WithArray("parts", Aws::Utils::Array<JsonValue>(parts.data(), parts.size()));
+        if (!add_part_urls(body, s3_client, bucket, key, upload_id, missing)) {
+            return error_response(500, "Failed to pre-sign part URLs");
+        }
+        std::cout << "Multipart upload resumed: key=" << key << ", uploaded=" << parts.size() << ", missing=" << missing.size() << std::endl;
+        return invocation_response::success(create_response(200, body).View().WriteCompact(), "application/json");
+    }
+
+    if (action == "complete") {
+        auto parts_json = view.GetArray("parts");
+        Aws::Vector<CompletedPart> parts;
+        for (size_t i = 0; i < parts_json.GetLength(); ++i) {
+            parts.push_back(CompletedPart().WithPartNumber(parts_json[i].GetInteger("part_number")).WithETag(parts_json[i].GetString("etag")));
+        }
+        if (parts.empty() || parts.size() > static_cast<size_t>(MULTIPART_MAX_PARTS)) {
+            return error_response(400, "1-" + std::to_string(MULTIPART_MAX_PARTS) + " parts are required");
+        }
+        std::sort(parts.begin(), parts.end(), [](const CompletedPart& a, const CompletedPart& b) { return a.GetPartNumber() < b.GetPartNumber(); });
+        CompleteMultipartUploadRequest complete_request;
+        complete_request.SetBucket(bucket);
+        complete_request.SetKey(key);
+        complete_request.SetUploadId(upload_id);
+        complete_request.SetMultipartUpload(CompletedMultipartUpload().WithParts(parts));
+        auto outcome = s3_client.CompleteMultipartUpload(complete_request);
+        if (!outcome.IsSuccess()) {
+            std::cerr << "Error: Failed to complete multipart upload: " << outcome.GetError().GetMessage() << std::endl;
+            int status = outcome.GetError().GetErrorType() == S3Errors::NO_SUCH_UPLOAD ? 404 : 400;
+            return error_response(status, "Failed to complete multipart upload: " + outcome.GetError().GetMessage());
+        }
+        std::cout << "Multipart upload completed: key=" << key << ", parts=" << parts.size() << std::endl;
+        JsonValue body;
+        body.WithString("s3_key", key);
+        return invocation_response::success(create_response(200, body).View().WriteCompact(), "application/json");
+    }
+
+    return error_response(400, "action must be start, resume or complete");
+}
+
+// Content-addressed blobs live under blobs/<sha256> in the artifact bucket
+const size_t MAX_BLOB_CHECK = 1000;
+const size_t BLOB_CHECK_CONCURRENCY = 32;
+
+bool is_sha256_hex(const std::string& s) {
+    return s.size() == 64 && std::all_of(s.begin(), s.end(), [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+}
+
+invocation_response handle_blob_check(JsonView view, S3Client& s3_client) {
+    std::string user_id = view.GetString("user_id");
+    auto hashes_json = view.GetArray("hashes");
+    if (user_id.empty() || hashes_json.GetLength() == 0 || hashes_json.GetLength() > MAX_BLOB_CHECK) {
+        std::cerr << "Error: user_id and 1-" << MAX_BLOB_CHECK << " hashes are required" << std::endl;
+        return error_response(400, "user_id and 1-" + std::to_string(MAX_BLOB_CHECK) + " hashes are required");
+    }
+    std::vector<std::string> hashes;
+    for (size_t i = 0; i < hashes_json.GetLength(); ++i) {
+        std::string hash = hashes_json[i].AsString();
+        if (!is_sha256_hex(hash)) {
+            std::cerr << "Error: Invalid blob hash: " << hash << std::endl;
+            return error_response(400, "Invalid blob hash: " + hash);
+        }
+        hashes.push_back(hash);
+    }
+
+    std::string bucket = getenv("AWS_BUCKET_NAME") ? getenv("AWS_BUCKET_NAME") : "";
+    JsonValue missing;
+    size_t missing_count = 0;
+    // HeadObject calls run in bounded waves so a large check stays within the timeout
+    for (size_t start = 0; start < hashes.size(); start += BLOB_CHECK_CONCURRENCY) {
+        size_t end = std::min(hashes.size(), start + BLOB_CHECK_CONCURRENCY);
+        std::vector<std::future<Aws::S3::Model::HeadObjectOutcome>> pending;
+        for (size_t i = start; i < end; ++i) {
+            HeadObjectRequest head_request;
+            head_request.SetBucket(bucket);
+            head_request.SetKey("blobs/" + hashes[i]);
+            pending.push_back(s3_client.HeadObjectCallable(head_request));
+        }
+        for (size_t i = start; i < end; ++i) {
+            auto outcome = pending[i - start].get();
+            if (outcome.IsSuccess()) continue;
+            if (outcome.GetError().GetResponseCode() != Aws::Http::HttpResponseCode::NOT_FOUND) {
+                std::cerr << "Error: Failed to check blob " << hashes[i] << ": " << outcome.GetError().GetMessage() << std::endl;
+                return error_response(500, "Failed to check blob: " + outcome.GetError().GetMessage());
+            }
+            // The checksum header is signed, so the URL only stores bytes that hash to the key
+            Aws::Http::HeaderValueCollection headers;
+            headers.emplace("x-amz-checksum-sha256", sha256_checksum(hashes[i]));
+            std::string url = s3_client.GeneratePresignedUrl(bucket, "blobs/" + hashes[i], Aws::Http::HttpMethod::HTTP_PUT, headers, UPLOAD_URL_EXPIRY_SECONDS);
+            missing.WithString(hashes[i], url);
+            ++missing_count;
+        }
+    }
+    std::cout << "Blob check: user_id=" << user_id << ", checked=" << hashes.size() << ", missing=" << missing_count << std::endl;
+
+    JsonValue body;
+    body.WithObject("missing", missing);
+    // Tells the client to send x-amz-checksum-sha256 with each blob
+    body.WithBool("checksum_sha256", true);
+    return invocation_response::success(create_response(200, body).View().WriteCompact(), "application/json");
+}
+
+// Struct for one job to schedule, from /schedule or one entry of /schedule/batch
+struct ScheduleJob {
+    std::string schedule_time;
+    std::string repo_url;
+    std::string zip_filename;
+    std::string zip_b64;    // decoded in place before upload
+    std::string_view changes;  // inline changes: inside zip_b64 or the multipart request body
+    std::string uploaded_key;
+    std::string github_username;
+    std::string github_display_name;
+    std::string github_email;
+    std::string commit_message;
+    std::string user_id;
+    std::string changes_format;
+    std::string idempotency_key;
+    Aws::Utils::DateTime dt;
+    std::string key;        // S3 key of the changes once stored
+    std::string job_id;     // gits-<epoch>[-<n>], unique per user
+    std::string added_at;   // DynamoDB sort key
+    std::string due_bucket; // dispatcher index key, see job_due_bucket
+    bool stored = false;    // changes stored by this request, removed if it fails
+};
+
+// Clients send a hash; anything short and URL-safe is accepted
+bool is_idempotency_key(const std::string& key) {
+    return key.size() <= 128 && std::all_of(key.begin(), key.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_'; });
+}
+
+// Batch entries fall back to the top-level value, so shared fields are sent once
+std::string job_field(JsonView job, JsonView shared, const char* name) {
+    if (job.ValueExists(name)) return job.GetString(name);
+    return shared.ValueExists(name) ? shared.GetString(name) : "";
+}
+
+// Function to read and validate a job; returns an error message or ""
+std::string parse_job(JsonView job_view, JsonView shared, ScheduleJob& job) {
+    job.schedule_time = job_field(job_view, shared, "schedule_time");
+    job.repo_url = job_field(job_view, shared, "repo_url");
+    job.zip_filename = job_field(job_view, shared, "zip_filename");
+    job.zip_b64 = job_field(job_view, shared, "zip_base64");
+    job.uploaded_key = job_field(job_view, shared, "s3_key");
+    job.github_username = job_field(job_view, shared, "github_username");
+    job.github_display_name = job_field(job_view, shared, "github_display_name");
+    job.github_email = job_field(job_view, shared, "github_email");
+    job.commit_message = job_field(job_view, shared, "commit_message");
+    job.user_id = job_field(job_view, shared, "user_id");
+    // zip: changed files to apply on the build side; bundle: a git bundle holding the commit
+    job.changes_format = job_field(job_view, shared, "format");
+    if (job.changes_format.empty()) job.changes_format = "zip";
+    if (job.changes_format != "zip" && job.changes_format != "bundle") {
+        return "format must be zip or bundle";
+    }
+    if (!job.uploaded_key.empty() && !is_changes_key(job.uploaded_key, job.user_id)) {
+        return "Invalid s3_key";
+    }
+    job.idempotency_key = job_field(job_view, shared, "idempotency_key");
+    if (!job.idempotency_key.empty() && !is_idempotency_key(job.idempotency_key)) {
+        return "Invalid idempotency_key";
+    }
+    // DateTime does not throw: a time it cannot read is only flagged, and its
+    // Millis() would put the job in the current minute
+    if (job.schedule_time.empty()) {
+        return "Invalid schedule_time";
+    }
+    job.dt = parse_iso8601(job.schedule_time);
+    if (!job.dt.WasParseSuccessful()) {
+        return "Invalid schedule_time";
+    }
+    return "";
+}
+
+// Function to decode base64 text (inline changes, base64 request bodies) in
+// place, so a 6 MB request needs no second buffer; returns false if it is not
+// valid base64
+bool decode_base64(std::string& text) {
+    size_t n = 0;
+    if (!base64_decode(text.data(), text.size(), reinterpret_cast<unsigned char*>(&text[0]), n)) {
+        return false;
+    }
+    text.resize(n);
+    return true;
+}
+
+// Function to read a request header; API Gateway passes them with the client's capitalization
+std::string event_header(JsonView event, const std::string& name) {
+    JsonView headers = event.GetObject("headers");
+    if (!headers.IsObject()) return "";
+    for (const auto& header : headers.GetAllObjects()) {
+        const auto& key = header.first;
+        if (key.size() == name.size() && std::equal(key.begin(), key.end(), name.begin(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            })) {
+            return header.second.AsString();
+        }
+    }
+    return "";
+}
+
+// Function to split a multipart/form-data body into views of its parts by
+// name; returns false if the body does not follow the boundary of content_type
+bool parse_multipart(const std::string& content_type, std::string_view body, std::map<std::string, std::string_view>& parts) {
+    size_t at = content_type.find("boundary=");
+    if (at == std::string::npos) return false;
+    std::string boundary = content_type.substr(at + 9, content_type.find(';', at) - at - 9);
+    if (boundary.size() >= 2 && boundary.front() == '"' && boundary.back() == '"') {
+        boundary = boundary.substr(1, boundary.size() - 2);
+    }
+    if (boundary.empty()) return false;
+    const std::string delimiter = "--" + boundary;
+
+    size_t pos = body.find(delimiter);
+    if (pos == std::string::npos) return false;
+    pos += delimiter.size();
+    while (body.compare(pos, 2, "--") != 0) {
+        if (body.compare(pos, 2, "\r\n") != 0) return false;
+        size_t headers_end = body.find("\r\n\r\n", pos);
+        if (headers_end == std::string::npos) return false;
+        size_t next = body.find("\r\n" + delimiter, headers_end + 4);
+        if (next == std::string::npos) return false;
+        std::string_view headers = body.substr(pos + 2, headers_end - pos - 2);
+        size_t name_at = headers.find("name=\"");
+        if (name_at == std::string::npos) return false;
+        std::string name(headers.substr(name_at + 6, headers.find('"', name_at + 6) - name_at - 6));
+        parts[name] = body.substr(headers_end + 4, next - headers_end - 4);
+        pos = next + 2 + delimiter.size();
+    }
+    return true;
+}
+
+// Stream reading bytes where they already are, so PutObject sends the decoded
+// changes without copying them into a StringStream. The bytes must outlive
+// the request; the SDK only reads through the buffer.
+class BufferStream : public Aws::IOStream {
+public:
+    explicit BufferStream(std::string_view bytes)
+        : Aws::IOStream(nullptr), buffer_(reinterpret_cast<unsigned char*>(const_cast<char*>(bytes.data())), bytes.size()) {
+        rdbuf(&buffer_);
+    }
+
+private:
+    Aws::Utils::Stream::PreallocatedStreamBuf buffer_;
+};
+
+PutObjectRequest changes_put_request(const std::string& bucket, const std::string& key, std::string_view bytes) {
+    PutObjectRequest put_request;
+    put_request.SetBucket(bucket);
+    put_request.SetKey(key);
+    put_request.SetContentLength(static_cast<long long>(bytes.size()));
+    put_request.SetBody(Aws::MakeShared<BufferStream>("", bytes));
+    return put_request;
+}
+
+HeadObjectRequest changes_head_request(const std::string& bucket, const std::string& key) {
+    HeadObjectRequest head_request;
+    head_request.SetBucket(bucket);
+    head_request.SetKey(key);
+    return head_request;
+}
+
+// Jobs wait for the dispatcher in a sparse index keyed by due_bucket,
+// "<epoch minute>#<shard>". A busy minute is spread over DISPATCH_SHARDS
+// partitions so tens of thousands of jobs do not land on one hot key. While
+// its build is being started a job sits in "dispatching#<shard>", and the
+// attribute is removed once the build id is recorded, so the index only ever
+// holds pending jobs.
+const char* const DUE_INDEX = "due_bucket-index";
+const int DISPATCH_SHARDS = 16;
+
+std::string due_bucket(const std::string& prefix, int shard) {
+    std::ostringstream ss;
+    ss << prefix << "#" << std::setw(2) << std::setfill('0') << shard;
+    return ss.str();
+}
+
+std::string due_bucket(long long minute, int shard) {
+    return due_bucket(std::to_string(minute), shard);
+}
+
+int bucket_shard(const std::string& bucket) {
+    return std::stoi(bucket.substr(bucket.find('#') + 1));
+}
+
+// Function to pick a job's bucket. A schedule_time already past goes into the
+// current minute, so the job runs now instead of never.
+std::string job_due_bucket(const ScheduleJob& job, std::time_t now_tt) {
+    long long minute = std::max<long long>(job.dt.Millis() / 1000 / 60, now_tt / 60);
+    return due_bucket(minute, static_cast<int>(std::hash<std::string>()(job.user_id + "#" + job.added_at) % DISPATCH_SHARDS));
+}
+
+// The job item carries everything its build needs, so the dispatcher starts
+// it from the index alone
+Aws::Map<Aws::String, AttributeValue> job_item(const ScheduleJob& job, const std::string& bucket) {
+    Aws::Map<Aws::String, AttributeValue> item;
+    item["user_id"].SetS(job.user_id);
+    item["job_id"].SetS(job.job_id);
+    item["schedule_time"].SetS(job.schedule_time);
+    item["status"].SetS("pending");
+    item["version"].SetN("1");
+    item["added_at"].SetN(job.added_at);
+    item["due_bucket"].SetS(job.due_bucket);
+    item["s3_path"].SetS("s3://" + bucket + "/" + job.key);
+    item["changes_format"].SetS(job.changes_format);
+    item["repo_url"].SetS(job.repo_url);
+    item["github_username"].SetS(job.github_username);
+    item["github_display_name"].SetS(job.github_display_name);
+    item["github_email"].SetS(job.github_email);
+    item["commit_message"].SetS(job.commit_message);
+    if (!job.idempotency_key.empty()) {
+        item["idempotency_key"].SetS(job.idempotency_key);
+    }
+    return item;
+}
+
+// Function to remove the changes a failed job stored, so it leaves no orphan
+// object behind. A pre-uploaded object is the client's and stays.
+void rollback_job(ScheduleJob& job, const std::string& bucket, S3Client& s3_client) {
+    if (!job.stored) return;
+    DeleteObjectRequest delete_request;
+    delete_request.SetBucket(bucket);
+    delete_request.SetKey(job.key);
+    auto outcome = s3_client.DeleteObject(delete_request);
+    if (!outcome.IsSuccess()) {
+        std::cerr << "Failed to delete changes " << job.key << ": " << outcome.GetError().GetMessage() << std::endl;
+    } else {
+        std::cout << "Rolled back job: " << job.job_id << std::endl;
+    }
+    job.stored = false;
+}
+
+// A retried request carries the idempotency key of the first attempt. The first
+// request to arrive claims the key with a conditional write, and later ones get
+// its result back instead of scheduling a second job. Claims live next to the
+// jobs under user_id "idempotency#<user>#<key>" and expire through the table
+// TTL. A claim left by a request that died mid-way is taken over once stale.
+const long long IDEMPOTENCY_TTL_SECONDS = 24 * 60 * 60;
+const long long CLAIM_STALE_SECONDS = 15 * 60;
+
+Aws::Map<Aws::String, AttributeValue> claim_key(const ScheduleJob& job) {
+    Aws::Map<Aws::String, AttributeValue> key;
+    key["user_id"].SetS("idempotency#" + job.user_id + "#" + job.idempotency_key);
+    key["added_at"].SetN("0");
+    return key;
+}
+
+PutItemRequest claim_request(const std::string& table_name, const ScheduleJob& job, std::time_t now_tt) {
+    auto item = claim_key(job);
+    item["status"].SetS("claimed");
+    item["job_id"].SetS(job.job_id);
+    item["claimed_at"].SetN(std::to_string(now_tt));
+    item["expires_at"].SetN(std::to_string(now_tt + IDEMPOTENCY_TTL_SECONDS));
+    AttributeValue claimed;
+    claimed.SetS("claimed");
+    AttributeValue stale_before;
+    stale_before.SetN(std::to_string(now_tt - CLAIM_STALE_SECONDS));
+
+    PutItemRequest request;
+    request.SetTableName(table_name);
+    request.SetItem(item);
+    request.SetConditionExpression("attribute_not_exists(user_id) OR (#status = :claimed AND claimed_at < :stale_before)");
+    request.AddExpressionAttributeNames("#status", "status");
+    request.AddExpressionAttributeValues(":claimed", claimed);
+    request.AddExpressionAttributeValues(":stale_before", stale_before);
+    return request;
+}
+
+// Function to build the finished claim, which later duplicates are answered from
+Aws::Map<Aws::String, AttributeValue> claim_done_item(const ScheduleJob& job, const std::string& bucket, std::time_t now_tt) {
+    auto item = claim_key(job);
+    item["status"].SetS("scheduled");
+    item["job_id"].SetS(job.job_id);
+    item["cron_expression"].SetS(cron_expression(job.dt));
+    item["s3_path"].SetS("s3://" + bucket + "/" + job.key);
+    item["expires_at"].SetN(std::to_string(now_tt + IDEMPOTENCY_TTL_SECONDS));
+    return item;
+}
+
+enum class Claim { Acquired, Duplicate, InProgress, Failed };
+
+// Function to interpret a claim write. When the key belongs to a finished
+// request, original is filled with that request's response body.
+Claim claim_result(const PutItemOutcome& outcome, DynamoDBClient& dynamodb_client, const std::string& table_name, const ScheduleJob& job, JsonValue& original) {
+    if (outcome.IsSuccess()) return Claim::Acquired;
+    if (outcome.GetError().GetErrorType() != DynamoDBErrors::CONDITIONAL_CHECK_FAILED) {
+        std::cerr << "Failed to claim idempotency key: " << outcome.GetError().GetMessage() << std::endl;
+        return Claim::Failed;
+    }
+    GetItemRequest get_request;
+    get_request.SetTableName(table_name);
+    get_request.SetKey(claim_key(job));
+    get_request.SetConsistentRead(true);
+    auto get_outcome = dynamodb_client.GetItem(get_request);
+    if (!get_outcome.IsSuccess()) {
+        std::cerr << "Failed to read idempotency claim: " << get_outcome.GetError().GetMessage() << std::endl;
+        return Claim::Failed;
+    }
+    const auto& item = get_outcome.GetResult().GetItem();
+    auto status = item.find("status");
+    if (status == item.end() || status->second.GetS() != "scheduled") return Claim::InProgress;
+    original.WithString("message", "Scheduled");
+    original.WithBool("duplicate", true);
+    for (const char* field : {"job_id", "cron_expression", "s3_path"}) {
+        auto value = item.find(field);
+        original.WithString(field, value == item.end() ? "" : value->second.GetS());
+    }
+    // Claims written before job_id named the job rule_name
+    auto legacy = item.find("rule_name");
+    if (legacy != item.end()) original.WithString("job_id", legacy->second.GetS());
+    original.WithString("rule_name", original.View().GetString("job_id"));
+    return Claim::Duplicate;
+}
+
+// Function to give up a claim after a failure, so a retry can schedule the job
+void release_claim(DynamoDBClient& dynamodb_client, const std::string& table_name, const ScheduleJob& job) {
+    DeleteItemRequest delete_request;
+    delete_request.SetTableName(table_name);
+    delete_request.SetKey(claim_key(job));
+    auto outcome = dynamodb_client.DeleteItem(delete_request);
+    if (!outcome.IsSuccess()) {
+        std::cerr << "Failed to release idempotency key: " << outcome.GetError().GetMessage() << std::endl;
+    }
+}
+
+// Batches are bounded so every AWS call fits comfortably in the Lambda timeout
+const size_t MAX_BATCH_JOBS = 100;
+const size_t BATCH_CONCURRENCY = 16;
+const size_t BATCH_WRITE_LIMIT = 25;  // DynamoDB BatchWriteItem maximum
+const int BATCH_WRITE_ATTEMPTS = 5;
+
+// Jobs of one batch share a second, so the sort key gets a per-job fraction
+// (<epoch>.001, ...) that stays unique and orders after a plain <epoch>.
+// Single requests that find their second taken use the fractions after
+// MAX_BATCH_JOBS, see SAME_SECOND_ATTEMPTS.
+const size_t SAME_SECOND_ATTEMPTS = 50;
+
+std::string batch_added_at(std::time_t now_tt, size_t index) {
+    std::ostringstream ss;
+    ss << now_tt << "." << std::setw(3) << std::setfill('0') << index + 1;
+    return ss.str();
+}
+
+// Function to write items with BatchWriteItem, retrying unprocessed items with
+// backoff; returns the job_ids of job items that could not be written
+std::set<std::string> write_job_items(DynamoDBClient& dynamodb_client, const std::string& table_name, std::vector<Aws::Map<Aws::String, AttributeValue>> items) {
+    std::set<std::string> failed;
+    for (size_t start = 0; start < items.size(); start += BATCH_WRITE_LIMIT) {
+        size_t end = std::min(items.size(), start + BATCH_WRITE_LIMIT);
+        Aws::Vector<WriteRequest> writes;
+        for (size_t i = start; i < end; ++i) {
+            writes.push_back(WriteRequest().WithPutRequest(PutRequest().WithItem(items[i])));
+        }
+        for (int attempt = 0; !writes.empty(); ++attempt) {
+            if (attempt == BATCH_WRITE_ATTEMPTS) {
+                std::cerr << "Failed to write " << writes.size() << " item(s) to DynamoDB: retries exhausted" << std::endl;
+                break;
+            }
+            if (attempt > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50 << attempt));
+            }
+            BatchWriteItemRequest batch_request;
+            batch_request.AddRequestItems(table_name, writes);
+            auto outcome = dynamodb_client.BatchWriteItem(batch_request);
+            if (!outcome.IsSuccess()) {
+                std::cerr << "Failed to write to DynamoDB: " << outcome.GetError().GetMessage() << std::endl;
+                if (!outcome.GetError().ShouldRetry()) break;
+                continue;
+            }
+            const auto& unprocessed = outcome.GetResult().GetUnprocessedItems();
+            auto it = unprocessed.find(table_name);
+            writes = it == unprocessed.end() ? Aws::Vector<WriteRequest>() : it->second;
+        }
+        for (const auto& write : writes) {
+            const auto& item = write.GetPutRequest().GetItem();
+            auto job_id = item.find("job_id");
+            if (job_id != item.end()) failed.insert(job_id->second.GetS());
+        }
+    }
+    return failed;
+}
+
+invocation_response handle_batch(JsonView view, S3Client& s3_client, DynamoDBClient& dynamodb_client) {
+    auto jobs_json = view.GetArray("jobs");
+    size_t count = jobs_json.GetLength();
+    if (count == 0 || count > MAX_BATCH_JOBS) {
+        std::cerr << "Error: A batch needs 1-" << MAX_BATCH_JOBS << " jobs" << std::endl;
+        return error_response(400, "A batch needs 1-" + std::to_string(MAX_BATCH_JOBS) + " jobs");
+    }
+    std::string table_name = getenv("DYNAMODB_TABLE") ? getenv("DYNAMODB_TABLE") : "";
+    if (table_name.empty()) {
+        std::cerr << "Error: DYNAMODB_TABLE is not set" << std::endl;
+        return error_response(500, "DYNAMODB_TABLE is not set");
+    }
+
+    std::string bucket = getenv("AWS_BUCKET_NAME") ? getenv("AWS_BUCKET_NAME") : "";
+    auto now_tt = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::vector<ScheduleJob> jobs(count);
+    std::vector<std::string> errors(count);
+    for (size_t i = 0; i < count; ++i) {
+        errors[i] = parse_job(jobs_json[i], view, jobs[i]);
+        jobs[i].job_id = "gits-" + std::to_string(now_tt) + "-" + std::to_string(i + 1);
+        jobs[i].added_at = batch_added_at(now_tt, i);
+    }
+    std::cout << "Batch received: jobs=" << count << std::endl;
+
+    // Idempotency claims, so a retried batch only schedules the jobs that did not go through
+    std::vector<bool> claimed(count, false);
+    std::vector<JsonValue> duplicates(count);
+    std::vector<bool> duplicate(count, false);
+    for (size_t start = 0; start < count; start += BATCH_CONCURRENCY) {
+        size_t end = std::min(count, start + BATCH_CONCURRENCY);
+        std::vector<PutItemRequest> claim_requests(end - start);
+        std::vector<std::future<PutItemOutcome>> claims(end - start);
+        for (size_t i = start; i < end; ++i) {
+            if (!errors[i].empty() || jobs[i].idempotency_key.empty()) continue;
+            claim_requests[i - start] = claim_request(table_name, jobs[i], now_tt);
+            claims[i - start] = dynamodb_client.PutItemCallable(claim_requests[i - start]);
+        }
+        for (size_t i = start; i < end; ++i) {
+            if (!claims[i - start].valid()) continue;
+            switch (claim_result(claims[i - start].get(), dynamodb_client, table_name, jobs[i], duplicates[i])) {
+            case Claim::Acquired: claimed[i] = true; break;
+            case Claim::Duplicate: duplicate[i] = true; break;
+            case Claim::InProgress: errors[i] = "A request with this idempotency key is in progress"; break;
+            case Claim::Failed: errors[i] = "Failed to claim idempotency key"; break;
+            }
+        }
+    }
+
+    // Changesets: inline ones are stored, pre-uploaded ones checked, in bounded waves.
+    // Requests outlive their futures because the SDK may run them by reference.
+    for (size_t start = 0; start < count; start += BATCH_CONCURRENCY) {
+        size_t end = std::min(count, start + BATCH_CONCURRENCY);
+        std::vector<HeadObjectRequest> head_requests(end - start);
+        std::vector<PutObjectRequest> put_requests(end - start);
+        std::vector<std::future<HeadObjectOutcome>> heads(end - start);
+        std::vector<std::future<PutObjectOutcome>> puts(end - start);
+        for (size_t i = start; i < end; ++i) {
+            if (!errors[i].empty() || duplicate[i]) continue;
+            ScheduleJob& job = jobs[i];
+            if (!job.uploaded_key.empty()) {
+                job.key = job.uploaded_key;
+                head_requests[i - start] = changes_head_request(bucket, job.key);
+                heads[i - start] = s3_client.HeadObjectCallable(head_requests[i - start]);
+                continue;
+            }
+            if (!decode_base64(job.zip_b64)) {
+                errors[i] = "zip_base64 is not valid base64";
+                continue;
+            }
+            job.changes = job.zip_b64;
+            job.key = changes_key(job.user_id, std::to_string(i + 1) + "-" + job.zip_filename);
+            put_requests[i - start] = changes_put_request(bucket, job.key, job.changes);
+            puts[i - start] = s3_client.PutObjectCallable(put_requests[i - start]);
+        }
+        for (size_t i = start; i < end; ++i) {
+            if (heads[i - start].valid() && !heads[i - start].get().IsSuccess()) {
+                errors[i] = "Uploaded changes not found: " + jobs[i].key;
+            }
+            if (puts[i - start].valid()) {
+                auto outcome = puts[i - start].get();
+                if (!outcome.IsSuccess()) errors[i] = "Failed to upload to S3: " + outcome.GetError().GetMessage();
+                else jobs[i].stored = true;
+            }
+        }
+    }
+
+    // DynamoDB: the job items schedule the jobs, so they go first; jobs whose
+    // item could not be written fail and lose their changes
+    std::vector<Aws::Map<Aws::String, AttributeValue>> items;
+    for (size_t i = 0; i < count; ++i) {
+        if (!errors[i].empty() || duplicate[i]) continue;
+        jobs[i].due_bucket = job_due_bucket(jobs[i], now_tt);
+        items.push_back(job_item(jobs[i], bucket));
+    }
+    if (!items.empty()) {
+        std::cout << "Writing " << items.size() << " job(s) to DynamoDB table: " << table_name << std::endl;
+        auto unwritten = write_job_items(dynamodb_client, table_name, std::move(items));
+        for (size_t i = 0; i < count; ++i) {
+            if (unwritten.count(jobs[i].job_id)) errors[i] = "Failed to schedule job";
+        }
+    }
+
+    // Finished claims for the jobs that went through; failed jobs give their claim back
+    std::vector<Aws::Map<Aws::String, AttributeValue>> claims_done;
+    for (size_t i = 0; i < count; ++i) {
+        if (!errors[i].empty()) {
+            rollback_job(jobs[i], bucket, s3_client);
+            if (claimed[i]) release_claim(dynamodb_client, table_name, jobs[i]);
+        } else if (claimed[i]) {
+            claims_done.push_back(claim_done_item(jobs[i], bucket, now_tt));
+        }
+    }
+    if (!claims_done.empty()) {
+        write_job_items(dynamodb_client, table_name, std::move(claims_done));
+    }
+
+    std::vector<JsonValue> results;
+    size_t scheduled = 0;
+    for (size_t i = 0; i < count; ++i) {
+        JsonValue result;
+        if (duplicate[i]) {
+            ++scheduled;
+            result = duplicates[i];
+            result.WithString("status", "scheduled");
+        } else if (errors[i].empty()) {
+            ++scheduled;
+            result.WithString("status", "scheduled");
+            result.WithString("job_id", jobs[i].job_id);
+            result.WithString("rule_name", jobs[i].job_id);  // the job_id, for clients that predate it
+            result.WithString("cron_expression", cron_expression(jobs[i].dt));
+            result.WithString("s3_path", "s3://" + bucket + "/" + jobs[i].key);
+        } else {
+            std::cerr << "Error: Batch job " << i << ": " << errors[i] << std::endl;
+            result.WithString("status", "failed");
+            result.WithString("error", errors[i]);
+        }
+        result.WithInteger("index", static_cast<int>(i));
+        results.push_back(result);
+    }
+    std::cout << "Batch completed: scheduled=" << scheduled << ", failed=" << count - scheduled << std::endl;
+
+    JsonValue body;
+    body.WithArray("results", Aws::Utils::Array<JsonValue>(results.data(), results.size()));
+    body.WithInteger("scheduled", static_cast<int>(scheduled));
+    body.WithInteger("failed", static_cast<int>(count - scheduled));
+    return invocation_response::success(create_response(200, body).View().WriteCompact(), "application/json");
+}
+
+// The dispatcher runs every minute from an EventBridge schedule and starts the
+// builds of due jobs. It reads every bucket from its watermark, the oldest
+// minute it has not drained yet, to the current minute, and then moves the
+// watermark up to the first minute it could not finish: a failed query, or
+// pages and jobs left when the run ran out of time. Jobs of minutes missed by
+// an outage, throttling or a short run are found by a later run. The first
+// run, without a watermark, looks back DISPATCH_LOOKBACK_MINUTES; a run
+// invoked by hand with {"source": "aws.events", "detail": {"lookback_minutes": N}}
+// also reads at least the last N minutes.
+const long long DISPATCH_LOOKBACK_MINUTES = 15;
+const char* const DISPATCH_WATERMARK = "dispatch#watermark";
+const size_t DISPATCH_CONCURRENCY = 64;
+const long long DISPATCH_MAX_ATTEMPTS = 5;
+const long long DISPATCH_RESERVE_MS = 10 * 1000;  // left to finish the calls in flight
+
+// A claimed job moves to the dispatching bucket of its shard until its build
+// id is recorded, by the dispatcher or by codebuildlens once the build
+// reports. A job still there after DISPATCH_RECLAIM_SECONDS was stranded by a
+// run that died or failed to record it, and goes back to the current minute.
+// The wait is long enough for a build queued behind others to report first.
+const char* const DISPATCHING = "dispatching";
+const long long DISPATCH_RECLAIM_SECONDS = 30 * 60;
+
+// Jobs of one user due the same minute for the same repository are coalesced
+// into one build, which clones once, commits each changeset in scheduled order
+// and pushes once. The build pushes with its first job's credentials, so jobs
+// of different users never share one. Groups are capped so a build stays
+// well within its timeout and one bad changeset fails few others.
+const size_t DISPATCH_MAX_GROUP = 25;
+
+// Jobs scheduled before the dispatcher each had a one-shot rule, which
+// EventBridge keeps after it fires. The dispatcher removes a few spent ones
+// per run; pending ones still fire on their own.
+const char* const TARGET_ID = "Target1";
+const long long LEGACY_RULE_GRACE_SECONDS = 60 * 60;
+const int LEGACY_SWEEP_LIMIT = 20;
+
+std::string item_string(const Aws::Map<Aws::String, AttributeValue>& item, const char* name) {
+    auto it = item.find(name);
+    return it == item.end() ? "" : it->second.GetS();
+}
+
+// Function to start an update of a job item by its table key
+UpdateItemRequest job_update(const std::string& table_name, const Aws::Map<Aws::String, AttributeValue>& item, const std::string& expression) {
+    UpdateItemRequest request;
+    request.SetTableName(table_name);
+    request.AddKey("user_id", item.at("user_id"));
+    request.AddKey("added_at", item.at("added_at"));
+    request.SetUpdateExpression(expression);
+    return request;
+}
+
+void add_value(UpdateItemRequest& request, const char* name, const std::string& value, bool number = false) {
+    AttributeValue attr;
+    if (number) attr.SetN(value);
+    else attr.SetS(value);
+    request.AddExpressionAttributeValues(name, attr);
+}
+
+// Function to name a build's manifest after its first job, whose table key no
+// other build shares
+std::string build_manifest_key(const Aws::Map<Aws::String, AttributeValue>& first) {
+    return "builds/" + std::string(first.at("added_at").GetN()) + "-" + std::to_string(std::hash<std::string>()(item_string(first, "user_id"))) + ".json";
+}
+
+// The changesets of a coalesced build, in the order they are committed
+PutObjectRequest build_manifest_request(const std::vector<Aws::Map<Aws::String, AttributeValue>>& due, const std::vector<size_t>& members, const std::string& bucket, const std::string& key) {
+    std::vector<JsonValue> entries;
+    for (size_t i : members) {
+        JsonValue entry;
+        for (const char* field : {"job_id", "s3_path", "changes_format", "commit_message", "github_display_name", "github_email"}) {
+            entry.WithString(field, item_string(due[i], field));
+        }
+        entries.push_back(entry);
+    }
+    auto body = Aws::MakeShared<Aws::StringStream>("");
+    *body << JsonValue().WithArray("jobs", Aws::Utils::Array<JsonValue>(entries.data(), entries.size())).View().WriteCompact();
+    PutObjectRequest put_request;
+    put_request.SetBucket(bucket);
+    put_request.SetKey(key);
+    put_request.SetContentType("application/json");
+    put_request.SetBody(body);
+    return put_request;
+}
+
+// The build gets the environment the per-job rules used to pass, from its first
+// job. JOB_KEYS names every job, for codebuildlens; a coalesced build reads its
+// changesets from JOBS_PATH instead of S3_PATH and COMMIT_MESSAGE.
+Aws::CodeBuild::Model::StartBuildRequest job_build_request(const std::vector<Aws::Map<Aws::String, AttributeValue>>& due, const std::vector<size_t>& members, const std::string& project, const std::string& bucket, const std::string& manifest_key) {
+    const auto& item = due[members[0]];
+    Aws::CodeBuild::Model::StartBuildRequest request;
+    request.SetProjectName(project);
+    auto add_env = [&](const char* name, const std::string& value) {
+        request.AddEnvironmentVariablesOverride(Aws::CodeBuild::Model::EnvironmentVariable()
+            .WithName(name).WithValue(value).WithType(Aws::CodeBuild::Model::EnvironmentVariableType::PLAINTEXT));
+    };
+    if (manifest_key.empty()) {
+        add_env("S3_PATH", item_string(item, "s3_path"));
+        add_env("CHANGES_FORMAT", item_string(item, "changes_format"));
+        add_env("COMMIT_MESSAGE", item_string(item, "commit_message"));
+    } else {
+        add_env("JOBS_PATH", "s3://" + bucket + "/" + manifest_key);
+    }
+    add_env("BLOB_STORE", "s3://" + bucket + "/blobs");
+    add_env("REPO_URL", item_string(item, "repo_url"));
+    add_env("GITHUB_USERNAME", item_string(item, "github_username"));
+    add_env("GITHUB_DISPLAY_NAME", item_string(item, "github_display_name"));
+    add_env("GITHUB_EMAIL", item_string(item, "github_email"));
+    add_env("USER_ID", item_string(item, "user_id"));
+    std::vector<JsonValue> keys;
+    for (size_t i : members) {
+        keys.push_back(JsonValue().WithString("user_id", item_string(due[i], "user_id")).WithString("added_at", due[i].at("added_at").GetN()));
+    }
+    add_env("JOB_KEYS", JsonValue().AsArray(Aws::Utils::Array<JsonValue>(keys.data(), keys.size())).View().WriteCompact());
+    return request;
+}
+
+// Function to delete spent legacy rules, gits-<epoch>[-<n>] with a cron for a
+// minute long past; returns how many were deleted. Pending rules can fill
+// whole pages, so it pages on until LEGACY_SWEEP_LIMIT are deleted, the list
+// ends or the run is out of time.
+template <typename OutOfTime>
+int sweep_legacy_rules(EventBridgeClient& events_client, std::time_t now_tt, OutOfTime out_of_time) {
+    int swept = 0;
+    std::string next_token;
+    do {
+        ListRulesRequest list_request;
+        list_request.SetNamePrefix("gits-");
+        list_request.SetLimit(100);
+        if (!next_token.empty()) list_request.SetNextToken(next_token);
+        auto list_outcome = events_client.ListRules(list_request);
+        if (!list_outcome.IsSuccess()) {
+            std::cerr << "Failed to list legacy rules: " << list_outcome.GetError().GetMessage() << std::endl;
+            break;
+        }
+        next_token = list_outcome.GetResult().GetNextToken();
+        for (const auto& rule : list_outcome.GetResult().GetRules()) {
+            if (swept == LEGACY_SWEEP_LIMIT) break;
+            const std::string name = rule.GetName();
+            if (name.find_first_not_of("0123456789-", 5) != std::string::npos) continue;
+            std::tm tm {};
+            if (std::sscanf(rule.GetScheduleExpression().c_str(), "cron(%d %d %d %d ? %d)", &tm.tm_min, &tm.tm_hour, &tm.tm_mday, &tm.tm_mon, &tm.tm_year) != 5) continue;
+            tm.tm_mon -= 1;
+            tm.tm_year -= 1900;
+            if (now_tt - timegm(&tm) < LEGACY_RULE_GRACE_SECONDS) continue;
+
+            RemoveTargetsRequest remove_request;
+            remove_request.SetRule(name);
+            remove_request.SetIds({TARGET_ID});
+            remove_request.SetForce(true);
+            auto remove_outcome = events_client.RemoveTargets(remove_request);
+            if (!remove_outcome.IsSuccess()) {
+                std::cerr << "Failed to remove targets of " << name << ": " << remove_outcome.GetError().GetMessage() << std::endl;
+                continue;
+            }
+            DeleteRuleRequest delete_request;
+            delete_request.SetName(name);
+            delete_request.SetForce(true);
+            auto delete_outcome = events_client.DeleteRule(delete_request);
+            if (!delete_outcome.IsSuccess()) {
+                std::cerr << "Failed to delete rule " << name << ": " << delete_outcome.GetError().GetMessage() << std::endl;
+                continue;
+            }
+            ++swept;
+        }
+    } while (!next_token.empty() && swept < LEGACY_SWEEP_LIMIT && !out_of_time());
+    return swept;
+}
+
+// Function to put jobs stranded in the dispatching buckets back into the
+// current minute; returns how many were. Every shard is paged through unless
+// the run is out of time, which leaves the rest for the next run.
+template <typename OutOfTime>
+size_t reclaim_stranded_jobs(DynamoDBClient& dynamodb_client, const std::string& table_name, std::time_t now_tt, OutOfTime out_of_time) {
+    std::vector<std::pair<int, Aws::Map<Aws::String, AttributeValue>>> pending;
+    for (int shard = 0; shard < DISPATCH_SHARDS; ++shard) {
+        pending.emplace_back(shard, Aws::Map<Aws::String, AttributeValue>());
+    }
+    std::vector<UpdateItemRequest> reclaim_requests;
+    while (!pending.empty() && !out_of_time()) {
+        std::vector<QueryRequest> query_requests(pending.size());
+        std::vector<std::future<QueryOutcome>> queries(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            QueryRequest& query = query_requests[i];
+            query.SetTableName(table_name);
+            query.SetIndexName(DUE_INDEX);
+            query.SetKeyConditionExpression("due_bucket = :bucket");
+            query.SetFilterExpression("dispatched_at < :cutoff");
+            AttributeValue bucket_attr;
+            bucket_attr.SetS(due_bucket(DISPATCHING, pending[i].first));
+            query.AddExpressionAttributeValues(":bucket", bucket_attr);
+            AttributeValue cutoff_attr;
+            cutoff_attr.SetN(std::to_string(now_tt - DISPATCH_RECLAIM_SECONDS));
+            query.AddExpressionAttributeValues(":cutoff", cutoff_attr);
+            if (!pending[i].second.empty()) query.SetExclusiveStartKey(pending[i].second);
+            queries[i] = dynamodb_client.QueryCallable(query);
+        }
+        std::vector<std::pair<int, Aws::Map<Aws::String, AttributeValue>>> next_pages;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            int shard = pending[i].first;
+            auto outcome = queries[i].get();
+            if (!outcome.IsSuccess()) {
+                std::cerr << "Failed to query " << due_bucket(DISPATCHING, shard) << ": " << outcome.GetError().GetMessage() << std::endl;
+                continue;
+            }
+            for (const auto& item : outcome.GetResult().GetItems()) {
+                // Unless its build was recorded or it was reclaimed meanwhile
+                UpdateItemRequest update = job_update(table_name, item, "SET due_bucket = :bucket REMOVE dispatched_at ADD dispatch_attempts :one");
+                update.SetConditionExpression("due_bucket = :claim AND dispatched_at = :seen");
+                add_value(update, ":bucket", due_bucket(now_tt / 60, shard));
+                add_value(update, ":claim", due_bucket(DISPATCHING, shard));
+                add_value(update, ":seen", item.at("dispatched_at").GetN(), true);
+                add_value(update, ":one", "1", true);
+                reclaim_requests.push_back(std::move(update));
+            }
+            if (!outcome.GetResult().GetLastEvaluatedKey().empty()) {
+                next_pages.emplace_back(shard, outcome.GetResult().GetLastEvaluatedKey());
+            }
+        }
+        pending.swap(next_pages);
+    }
+    std::vector<std::future<UpdateItemOutcome>> reclaims;
+    for (const auto& update : reclaim_requests) reclaims.push_back(dynamodb_client.UpdateItemCallable(update));
+    size_t reclaimed = 0;
+    for (size_t r = 0; r < reclaims.size(); ++r) {
+        auto outcome = reclaims[r].get();
+        const auto& key = reclaim_requests[r].GetKey();
+        if (outcome.IsSuccess()) {
+            ++reclaimed;
+            std::cout << "Reclaimed stranded job: user_id=" << key.at("user_id").GetS() << ", added_at=" << key.at("added_at").GetN() << std::endl;
+        } else if (outcome.GetError().GetErrorType() != DynamoDBErrors::CONDITIONAL_CHECK_FAILED) {
+            std::cerr << "Failed to reclaim job: user_id=" << key.at("user_id").GetS() << ", added_at=" << key.at("added_at").GetN() << ": " << outcome.GetError().GetMessage() << std::endl;
+        }
+    }
+    return reclaimed;
+}
+
+// The watermark is an item next to the jobs, like the idempotency claims
+Aws::Map<Aws::String, AttributeValue> watermark_key() {
+    Aws::Map<Aws::String, AttributeValue> key;
+    key["user_id"].SetS(DISPATCH_WATERMARK);
+    key["added_at"].SetN("0");
+    return key;
+}
+
+// Function to read the dispatcher's watermark minute; -1 if there is none yet
+// or it cannot be read
+long long read_dispatch_watermark(DynamoDBClient& dynamodb_client, const std::string& table_name) {
+    GetItemRequest get_request;
+    get_request.SetTableName(table_name);
+    get_request.SetKey(watermark_key());
+    get_request.SetConsistentRead(true);
+    auto outcome = dynamodb_client.GetItem(get_request);
+    if (!outcome.IsSuccess()) {
+        std::cerr << "Failed to read dispatch watermark: " << outcome.GetError().GetMessage() << std::endl;
+        return -1;
+    }
+    auto minute = outcome.GetResult().GetItem().find("minute");
+    return minute == outcome.GetResult().GetItem().end() ? -1 : std::stoll(minute->second.GetN());
+}
+
+// Function to store the watermark. Overlapping runs each store the minute their
+// own scan reached, so the last writer's view is a complete one.
+void write_dispatch_watermark(DynamoDBClient& dynamodb_client, const std::string& table_name, long long minute) {
+    auto item = watermark_key();
+    item["minute"].SetN(std::to_string(minute));
+    PutItemRequest put_request;
+    put_request.SetTableName(table_name);
+    put_request.SetItem(item);
+    auto outcome = dynamodb_client.PutItem(put_request);
+    if (!outcome.IsSuccess()) {
+        std::cerr << "Failed to store dispatch watermark: " << outcome.GetError().GetMessage() << std::endl;
+    }
+}
+
+long long bucket_minute(const std::string& bucket) {
+    return std::stoll(bucket.substr(0, bucket.find('#')));
+}
+
+// Function to run the dispatcher: put stranded jobs back, query every due
+// bucket from the watermark on, claim each job by moving it to its
+// dispatching bucket under a condition (so an overlapping run cannot start it
+// twice), start one build per user, repository and minute, and record the
+// build id on its jobs. Builds refused for capacity go back to the current
+// minute; other failures count against DISPATCH_MAX_ATTEMPTS before the jobs
+// are FAILED. Updates after the claim require the item to exist, so a job
+// deleted meanwhile is not recreated.
+invocation_response handle_dispatch(invocation_request const& request, JsonView event, S3Client& s3_client, EventBridgeClient& events_client, DynamoDBClient& dynamodb_client, Aws::CodeBuild::CodeBuildClient& codebuild_client) {
+    std::string table_name = getenv("DYNAMODB_TABLE") ? getenv("DYNAMODB_TABLE") : "";
+    std::string project = getenv("AWS_CODEBUILD_PROJECT_NAME") ? getenv("AWS_CODEBUILD_PROJECT_NAME") : "";
+    std::string bucket = getenv("AWS_BUCKET_NAME") ? getenv("AWS_BUCKET_NAME") : "";
+    if (table_name.empty() || project.empty()) {
+        std::cerr << "Error: DYNAMODB_TABLE and AWS_CODEBUILD_PROJECT_NAME must be set" << std::endl;
+        return invocation_response::failure("DYNAMODB_TABLE and AWS_CODEBUILD_PROJECT_NAME must be set", "ConfigError");
+    }
+    auto now_tt = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    long long now_minute = now_tt / 60;
+    long long watermark = read_dispatch_watermark(dynamodb_client, table_name);
+    long long from_minute = watermark < 0 ? now_minute - DISPATCH_LOOKBACK_MINUTES : std::min(watermark, now_minute);
+    if (event.KeyExists("detail") && event.GetObject("detail").KeyExists("lookback_minutes")) {
+        from_minute = std::min(from_minute, now_minute - std::max<long long>(0, event.GetObject("detail").GetInt64("lookback_minutes")));
+    }
+    auto out_of_time = [&]() { return request.get_time_remaining().count() < DISPATCH_RESERVE_MS; };
+
+    size_t reclaimed = reclaim_stranded_jobs(dynamodb_client, table_name, now_tt, out_of_time);
+
+    // The oldest minute this run leaves jobs in; the current minute is read
+    // again by the next run in any case, since jobs keep arriving in it
+    long long undrained = now_minute;
+
+    // Due jobs, page by page across every bucket of the window in bounded waves
+    std::vector<std::pair<std::string, Aws::Map<Aws::String, AttributeValue>>> pending;
+    for (long long minute = from_minute; minute <= now_minute; ++minute) {
+        for (int shard = 0; shard < DISPATCH_SHARDS; ++shard) {
+            pending.emplace_back(due_bucket(minute, shard), Aws::Map<Aws::String, AttributeValue>());
+        }
+    }
+    std::vector<Aws::Map<Aws::String, AttributeValue>> due;
+    size_t query_failures = 0;
+    while (!pending.empty() && !out_of_time()) {
+        size_t wave = std::min(pending.size(), DISPATCH_CONCURRENCY);
+        std::vector<QueryRequest> query_requests(wave);
+        std::vector<std::future<QueryOutcome>> queries(wave);
+        for (size_t i = 0; i < wave; ++i) {
+            QueryRequest& query = query_requests[i];
+            query.SetTableName(table_name);
+            query.SetIndexName(DUE_INDEX);
+            query.SetKeyConditionExpression("due_bucket = :bucket");
+            AttributeValue bucket_attr;
+            bucket_attr.SetS(pending[i].first);
+            query.AddExpressionAttributeValues(":bucket", bucket_attr);
+            if (!pending[i].second.empty()) query.SetExclusiveStartKey(pending[i].second);
+            queries[i] = dynamodb_client.QueryCallable(query);
+        }
+        std::vector<std::pair<std::string, Aws::Map<Aws::String, AttributeValue>>> next_pages;
+        for (size_t i = 0; i < wave; ++i) {
+            auto outcome = queries[i].get();
+            if (!outcome.IsSuccess()) {
+                std::cerr << "Failed to query " << pending[i].first << ": " << outcome.GetError().GetMessage() << std::endl;
+                ++query_failures;
+                undrained = std::min(undrained, bucket_minute(pending[i].first));
+                continue;
+            }
+            for (const auto& item : outcome.GetResult().GetItems()) due.push_back(item);
+            if (!outcome.GetResult().GetLastEvaluatedKey().empty()) {
+                next_pages.emplace_back(pending[i].first, outcome.GetResult().GetLastEvaluatedKey());
+            }
+        }
+        pending.erase(pending.begin(), pending.begin() + wave);
+        pending.insert(pending.end(), next_pages.begin(), next_pages.end());
+    }
+    // Buckets or pages not read before the deadline
+    for (const auto& page : pending) undrained = std::min(undrained, bucket_minute(page.first));
+    // Scheduled order, oldest first, so a run cut short starts the jobs that
+    // waited longest and a build commits its changesets in the order they were
+    // scheduled
+    std::sort(due.begin(), due.end(), [](const auto& a, const auto& b) {
+        if (item_string(a, "schedule_time") != item_string(b, "schedule_time")) return item_string(a, "schedule_time") < item_string(b, "schedule_time");
+        return std::stod(a.at("added_at").GetN()) < std::stod(b.at("added_at").GetN());
+    });
+    std::cout << "Dispatch: buckets=" << (now_minute - from_minute + 1) * DISPATCH_SHARDS << ", due=" << due.size() << ", query_failures=" << query_failures << std::endl;
+
+    // Jobs of one user for the same repository and minute share one build
+    std::vector<std::vector<size_t>> groups;
+    std::map<std::string, size_t> open_groups;
+    for (size_t i = 0; i < due.size(); ++i) {
+        std::string job_bucket = item_string(due[i], "due_bucket");
+        std::string group_key = item_string(due[i], "user_id") + "\n" + item_string(due[i], "repo_url") + "\n" + job_bucket.substr(0, job_bucket.find('#'));
+        auto it = open_groups.find(group_key);
+        if (it == open_groups.end() || groups[it->second].size() == DISPATCH_MAX_GROUP) {
+            it = open_groups.insert_or_assign(group_key, groups.size()).first;
+            groups.emplace_back();
+        }
+        groups[it->second].push_back(i);
+    }
+
+    // A job whose build did not start goes back to the current minute, on its
+    // own shard; refusals for capacity do not count as an attempt
+    size_t started = 0, builds_started = 0, requeued = 0, failed = 0;
+    auto not_started = [&](const Aws::Map<Aws::String, AttributeValue>& item, bool capacity, const std::string& message) {
+        long long attempts = item.count("dispatch_attempts") ? std::stoll(item.at("dispatch_attempts").GetN()) : 0;
+        UpdateItemRequest update;
+        if (capacity || attempts + 1 < DISPATCH_MAX_ATTEMPTS) {
+            ++requeued;
+            update = job_update(table_name, item, capacity ? "SET due_bucket = :bucket REMOVE dispatched_at"
+                                                           : "SET due_bucket = :bucket REMOVE dispatched_at ADD dispatch_attempts :one");
+            add_value(update, ":bucket", due_bucket(now_minute, bucket_shard(item_string(item, "due_bucket"))));
+            if (!capacity) add_value(update, ":one", "1", true);
+        } else {
+            ++failed;
+            update = job_update(table_name, item, "SET #s = :failed, dispatch_error = :error REMOVE due_bucket ADD #v :one, dispatch_attempts :one");
+            update.AddExpressionAttributeNames("#s", "status");
+            update.AddExpressionAttributeNames("#v", "version");
+            add_value(update, ":failed", "FAILED");
+            add_value(update, ":error", message);
+            add_value(update, ":one", "1", true);
+        }
+        update.SetConditionExpression("attribute_exists(user_id)");
+        return update;
+    };
+
+    std::vector<bool> claimed(due.size(), false);
+    size_t first = 0;
+    while (first < groups.size() && !out_of_time()) {
+        // A wave of whole groups, about DISPATCH_CONCURRENCY jobs
+        size_t last = first;
+        std::vector<size_t> wave;
+        while (last < groups.size() && (wave.empty() || wave.size() + groups[last].size() <= DISPATCH_CONCURRENCY)) {
+            wave.insert(wave.end(), groups[last].begin(), groups[last].end());
+            ++last;
+        }
+
+        std::vector<UpdateItemRequest> claim_requests(wave.size());
+        std::vector<std::future<UpdateItemOutcome>> claims(wave.size());
+        for (size_t w = 0; w < wave.size(); ++w) {
+            const auto& item = due[wave[w]];
+            claim_requests[w] = job_update(table_name, item, "SET due_bucket = :claim, dispatched_at = :now");
+            claim_requests[w].SetConditionExpression("due_bucket = :bucket");
+            add_value(claim_requests[w], ":claim", due_bucket(DISPATCHING, bucket_shard(item_string(item, "due_bucket"))));
+            add_value(claim_requests[w], ":now", std::to_string(now_tt), true);
+            add_value(claim_requests[w], ":bucket", item_string(item, "due_bucket"));
+            claims[w] = dynamodb_client.UpdateItemCallable(claim_requests[w]);
+        }
+        for (size_t w = 0; w < wave.size(); ++w) {
+            auto outcome = claims[w].get();
+            if (outcome.IsSuccess()) {
+                claimed[wave[w]] = true;
+            } else if (outcome.GetError().GetErrorType() != DynamoDBErrors::CONDITIONAL_CHECK_FAILED) {
+                std::cerr << "Failed to claim job " << item_string(due[wave[w]], "job_id") << ": " << outcome.GetError().GetMessage() << std::endl;
+                undrained = std::min(undrained, bucket_minute(item_string(due[wave[w]], "due_bucket")));
+            }
+            // Otherwise taken by an overlapping run, or unscheduled meanwhile
+        }
+
+        // The claimed jobs of each group; builds of several jobs read their
+        // list from a manifest stored next to the changes
+        std::vector<std::vector<size_t>> members;
+        for (size_t g = first; g < last; ++g) {
+            std::vector<size_t> group;
+            for (size_t i : groups[g]) {
+                if (claimed[i]) group.push_back(i);
+            }
+            if (!group.empty()) members.push_back(std::move(group));
+        }
+        std::vector<std::string> manifest_keys(members.size());
+        std::vector<PutObjectRequest> manifest_requests(members.size());
+        std::vector<std::future<PutObjectOutcome>> manifests(members.size());
+        for (size_t b = 0; b < members.size(); ++b) {
+            if (members[b].size() < 2) continue;
+            manifest_keys[b] = build_manifest_key(due[members[b][0]]);
+            manifest_requests[b] = build_manifest_request(due, members[b], bucket, manifest_keys[b]);
+            manifests[b] = s3_client.PutObjectCallable(manifest_requests[b]);
+        }
+        std::vector<Aws::CodeBuild::Model::StartBuildRequest> build_requests(members.size());
+        std::vector<std::future<Aws::CodeBuild::Model::StartBuildOutcome>> builds(members.size());
+        std::vector<std::string> manifest_errors(members.size());
+        for (size_t b = 0; b < members.size(); ++b) {
+            if (manifests[b].valid()) {
+                auto outcome = manifests[b].get();
+                if (!outcome.IsSuccess()) {
+                    manifest_errors[b] = outcome.GetError().GetMessage();
+                    std::cerr << "Failed to store build manifest " << manifest_keys[b] << ": " << manifest_errors[b] << std::endl;
+                    continue;
+                }
+            }
+            build_requests[b] = job_build_request(due, members[b], project, bucket, manifest_keys[b]);
+            builds[b] = codebuild_client.StartBuildCallable(build_requests[b]);
+        }
+
+        std::vector<UpdateItemRequest> result_requests;
+        result_requests.reserve(wave.size());
+        for (size_t b = 0; b < members.size(); ++b) {
+            if (!builds[b].valid()) {
+                // The manifest could not be stored: retried next minute
+                for (size_t i : members[b]) result_requests.push_back(not_started(due[i], true, manifest_errors[b]));
+                continue;
+            }
+            auto outcome = builds[b].get();
+            if (outcome.IsSuccess()) {
+                ++builds_started;
+                const auto build_id = outcome.GetResult().GetBuild().GetId();
+                std::cout << "Build started: build_id=" << build_id << ", jobs=" << members[b].size() << ", repo_url=" << item_string(due[members[b][0]], "repo_url") << std::endl;
+                for (size_t i : members[b]) {
+                    ++started;
+                    result_requests.push_back(job_update(table_name, due[i], "SET build_id = :build_id REMOVE due_bucket"));
+                    result_requests.back().SetConditionExpression("attribute_exists(user_id)");
+                    add_value(result_requests.back(), ":build_id", build_id);
+                }
+                continue;
+            }
+            const auto& error = outcome.GetError();
+            bool capacity = error.ShouldRetry() || error.GetErrorType() == Aws::CodeBuild::CodeBuildErrors::ACCOUNT_LIMIT_EXCEEDED;
+            std::cerr << "Failed to start build for " << members[b].size() << " job(s) of " << item_string(due[members[b][0]], "repo_url") << ": " << error.GetMessage() << std::endl;
+            for (size_t i : members[b]) result_requests.push_back(not_started(due[i], capacity, error.GetMessage()));
+        }
+        std::vector<std::future<UpdateItemOutcome>> results;
+        for (const auto& update : result_requests) results.push_back(dynamodb_client.UpdateItemCallable(update));
+        for (size_t r = 0; r < results.size(); ++r) {
+            auto outcome = results[r].get();
+            // A job deleted meanwhile stays deleted
+            if (!outcome.IsSuccess() && outcome.GetError().GetErrorType() != DynamoDBErrors::CONDITIONAL_CHECK_FAILED) {
+                const auto& key = result_requests[r].GetKey();
+                std::cerr << "Failed to record dispatch: user_id=" << key.at("user_id").GetS() << ", added_at=" << key.at("added_at").GetN() << ": " << outcome.GetError().GetMessage() << std::endl;
+            }
+        }
+        first = last;
+    }
+    // Jobs found but not claimed before the deadline
+    for (; first < groups.size(); ++first) {
+        for (size_t i : groups[first]) undrained = std::min(undrained, bucket_minute(item_string(due[i], "due_bucket")));
+    }
+    write_dispatch_watermark(dynamodb_client, table_name, undrained);
+
+    int swept = out_of_time() ? 0 : sweep_legacy_rules(events_client, now_tt, out_of_time);
+    std::cout << "Dispatch: reclaimed=" << reclaimed << ", due=" << due.size() << ", started=" << started << ", builds=" << builds_started << ", requeued=" << requeued << ", failed=" << failed << ", swept=" << swept << ", watermark=" << undrained << std::endl;
+
+    JsonValue body;
+    body.WithInt64("reclaimed", static_cast<long long>(reclaimed));
+    body.WithInt64("due", static_cast<long long>(due.size()));
+    body.WithInt64("started", static_cast<long long>(started));
+    body.WithInt64("builds", static_cast<long long>(builds_started));
+    body.WithInt64("requeued", static_cast<long long>(requeued));
+    body.WithInt64("failed", static_cast<long long>(failed));
+    body.WithInteger("swept", swept);
+    body.WithInt64("watermark", undrained);
+    return invocation_response::success(body.View().WriteCompact(), "application/json");
+}
+
+invocation_response lambda_handler(invocation_request const& request, S3Client& s3_client, EventBridgeClient& events_client, DynamoDBClient& dynamodb_client, Aws::CodeBuild::CodeBuildClient& codebuild_client) {
     try {
         std::cout << "Lambda handler started" << std::endl;
         JsonValue event_json(request.payload);
@@ -60,17 +1419,44 @@ invocation_response lambda_handler(invocation_request const& request, S3Client&
         }
         std::cout << "Event JSON parsed successfully" << std::endl;
 
+        // The every-minute schedule, rather than API Gateway
+        if (event_json.View().GetString("source") == "aws.events") {
+            return handle_dispatch(request, event_json.View(), s3_client, events_client, dynamodb_client, codebuild_client);
+        }
+
+        // A request holds up to 6 MB of changes, so every copy of the body is
+        // dropped as soon as the next one exists, and the changes are decoded
+        // in place and sent to S3 from where they end up
         std::string body_raw = event_json.View().GetString("body");
         bool is_base64 = event_json.View().GetBool("isBase64Encoded");
+        std::string path = event_json.View().GetString("path");
+        std::string content_type = event_header(event_json.View(), "Content-Type");
+        event_json = JsonValue();
 
-        if (is_base64) {
-            Aws::Utils::Base64::Base64 base64;
-            Aws::Utils::CryptoBuffer decoded = base64.Decode(body_raw);
-            body_raw = std::string(reinterpret_cast<char*>(decoded.GetUnderlyingData()), decoded.GetLength());
+        if (is_base64 && !decode_base64(body_raw)) {
+            std::cerr << "Error: Request body is not valid base64" << std::endl;
+            return invocation_response::failure("Request body is not valid base64", "ParseError");
         }
         std::cout << "Body decoded, is_base64: " << (is_base64 ? "true" : "false") << std::endl;
 
-        JsonValue data(body_raw);
+        // A multipart body carries the JSON metadata in its payload part and
+        // the raw archive in its changes part, so the archive skips base64
+        // and stays in body_raw until it is uploaded
+        JsonValue data;
+        std::string_view changes;
+        if (content_type.compare(0, 19, "multipart/form-data") == 0) {
+            std::map<std::string, std::string_view> parts;
+            if (!parse_multipart(content_type, body_raw, parts) || !parts.count("payload")) {
+                std::cerr << "Error: Malformed multipart body" << std::endl;
+                return error_response(400, "Malformed multipart body");
+            }
+            data = JsonValue(Aws::String(parts["payload"]));
+            changes = parts["changes"];
+            std::cout << "Multipart body split, changes: " << changes.size() << " bytes" << std::endl;
+        } else {
+            data = JsonValue(body_raw);
+            std::string().swap(body_raw);
+        }
         if (!data.WasParseSuccessful()) {
             std::cerr << "Error: Failed to parse body JSON" << std::endl;
             return invocation_response::failure("Failed to parse body JSON", "ParseError");
@@ -78,158 +1464,176 @@ invocation_response lambda_handler(invocation_request const& request, S3Client&
         std::cout << "Body JSON parsed successfully" << std::endl;
 
         auto view = data.View();
-        std::string schedule_time = view.GetString("schedule_time");
-        std::string repo_url = view.GetString("repo_url");
-        std::string zip_filename = view.GetString("zip_filename");
-        std::string zip_b64 = view.GetString("zip_base64");
-        std::string github_username = view.GetString("github_username");
-        std::string github_display_name = view.GetString("github_display_name");
-        std::string github_email = view.GetString("github_email");
-        std::string commit_message = view.GetString("commit_message");
-        std::string user_id = view.GetString("user_id");
-        std::cout << "Extracted fields: repo_url=" << repo_url << ", zip_filename=" << zip_filename << ", user_id=" << user_id << std::endl;
-
-        Aws::Utils::DateTime dt;
-        try {
-            dt = parse_iso8601(schedule_time);
-        } catch (const std::exception& e) {
-            std::cerr << "Error: Invalid schedule_time: " << e.what() << std::endl;
-            JsonValue error_body;
-            error_body.WithString("error", std::string("Invalid schedule_time: ") + e.what());
-            return invocation_response::success(create_response(400, error_body).View().WriteCompact(), "application/json");
-        }
-        std::cout << "Schedule time parsed: " << schedule_time << std::endl;
-
-        std::string region = getenv("AWS_APP_REGION") ? getenv("AWS_APP_REGION") : "";
+        if (path.size() >= 11 && path.compare(path.size() - 11, 11, "/upload-url") == 0) {
+            return handle_upload_url(view, s3_client);
+        }
+        if (path.size() >= 10 && path.compare(path.size() - 10, 10, "/multipart") == 0) {
+            return handle_multipart(view, s3_client);
+        }
+        if (path.size() >= 6 && path.compare(path.size() - 6, 6, "/blobs") == 0) {
+            return handle_blob_check(view, s3_client);
+        }
+        if (path.size() >= 15 && path.compare(path.size() - 15, 15, "/schedule/batch") == 0) {
+            return handle_batch(view, s3_client, dynamodb_client);
+        }
+
+        ScheduleJob job;
+        std::string job_error = parse_job(view, view, job);
+        if (!job_error.empty()) {
+            std::cerr << "Error: " << job_error << std::endl;
+            return error_response(400, job_error);
+        }
+        job.changes = changes;
+        // The job holds its own copy of every field, zip_base64 included
+        data = JsonValue();
+        std::cout << "Extracted fields: repo_url=" << job.repo_url << ", zip_filename=" << job.zip_filename << ", user_id=" << job.user_id << std::endl;
+        std::cout << "Schedule time parsed: " << job.schedule_time << std::endl;
+
         std::string bucket = getenv("AWS_BUCKET_NAME") ? getenv("AWS_BUCKET_NAME") : "";
-        std::string project = getenv("AWS_CODEBUILD_PROJECT_NAME") ? getenv("AWS_CODEBUILD_PROJECT_NAME") : "";
-        std::string account_id = getenv("AWS_ACCOUNT_ID") ? getenv("AWS_ACCOUNT_ID") : "";
-        std::string target_role_arn = getenv("EVENTBRIDGE_TARGET_ROLE_ARN") ? getenv("EVENTBRIDGE_TARGET_ROLE_ARN") : "";
-
-        // Decode zip
-        Aws::Utils::Base64::Base64 base64;
-        Aws::Utils::CryptoBuffer zip_bytes;
-        try {
-            zip_bytes = base64.Decode(zip_b64);
-        } catch (const std::exception&) {
-            std::cerr << "Error: zip_base64 is not valid base64" << std::endl;
-            JsonValue error_body;
-            error_body.WithString("error", "zip_base64 is not valid base64");
-            return invocation_response::success(create_response(400, error_body).View().WriteCompact(), "application/json");
-        }
-        std::cout << "Zip decoded, size: " << zip_bytes.GetLength() << " bytes" << std::endl;
-
-        // S3 key
+        std::string table_name = getenv("DYNAMODB_TABLE") ? getenv("DYNAMODB_TABLE") : "";
+        if (table_name.empty()) {
+            std::cerr << "Error: DYNAMODB_TABLE is not set" << std::endl;
+            return error_response(500, "DYNAMODB_TABLE is not set");
+        }
+
         auto now = std::chrono::system_clock::now();
         auto now_tt = std::chrono::system_clock::to_time_t(now);
-        std::string prefix = "changes-" + std::to_string(now_tt);
-        std::string key = prefix + "/" + zip_filename;
+        job.job_id = "gits-" + std::to_string(now_tt);
+        job.added_at = std::to_string(now_tt);
 
-        // Upload to S3
-        std::cout << "Uploading to S3: bucket=" << bucket << ", key=" << key << std::endl;
+        // The idempotency claim and storing the changes do not depend on each
+        // other, so they run concurrently with the SDK's Callable calls. The
+        // request objects outlive their futures because the SDK may run them
+        // by reference. Inline changes go under a key holding the Lambda
+        // request id, so a request that turns out to be a duplicate removes
+        // only the object it stored itself.
+        PutItemRequest claim_put;
+        std::future<PutItemOutcome> claim;
+        if (!job.idempotency_key.empty()) {
+            claim_put = claim_request(table_name, job, now_tt);
+            claim = dynamodb_client.PutItemCallable(claim_put);
+        }
+        HeadObjectRequest head_request;
         PutObjectRequest put_request;
-        put_request.SetBucket(bucket);
-        put_request.SetKey(key);
-        std::shared_ptr<Aws::IOStream> input_data = Aws::MakeShared<Aws::StringStream>("");
-        input_data->write(reinterpret_cast<char*>(zip_bytes.GetUnderlyingData()), zip_bytes.GetLength());
-        put_request.SetBody(input_data);
-        auto put_outcome = s3_client.PutObject(put_request);
-        if (!put_outcome.IsSuccess()) {
-            std::cerr << "Error: Failed to upload to S3: " << put_outcome.GetError().GetMessage() << std::endl;
-            JsonValue error_body;
-            error_body.WithString("error", "Failed to upload to S3: " + put_outcome.GetError().GetMessage());
-            return invocation_response::success(create_response(500, error_body).View().WriteCompact(), "application/json");
-        }
-
-        std::string s3_path = "s3://" + bucket + "/" + key;
+        std::future<HeadObjectOutcome> head;
+        std::future<PutObjectOutcome> put;
+        int store_status = 0;
+        std::string store_error;
+        if (!job.uploaded_key.empty()) {
+            // The client already uploaded the zip through a pre-signed URL
+            job.key = job.uploaded_key;
+            head_request = changes_head_request(bucket, job.key);
+            head = s3_client.HeadObjectCallable(head_request);
+        } else if (job.changes.empty() && !decode_base64(job.zip_b64)) {
+            store_status = 400;
+            store_error = "zip_base64 is not valid base64";
+        } else {
+            // Decoded while the claim is in flight, unless it came raw in a multipart body
+            if (job.changes.empty()) job.changes = job.zip_b64;
+            std::cout << "Zip decoded, size: " << job.changes.size() << " bytes" << std::endl;
+            job.key = changes_key(job.user_id, request.request_id + "-" + job.zip_filename);
+            std::cout << "Uploading to S3: bucket=" << bucket << ", key=" << job.key << std::endl;
+            put_request = changes_put_request(bucket, job.key, job.changes);
+            put = s3_client.PutObjectCallable(put_request);
+        }
+
+        // Every call is waited for before deciding
+        if (head.valid()) {
+            auto head_outcome = head.get();
+            if (!head_outcome.IsSuccess()) {
+                store_status = 400;
+                store_error = "Uploaded changes not found: " + job.uploaded_key;
+            } else {
+                std::cout << "Using uploaded changes: key=" << job.key << ", size: " << head_outcome.GetResult().GetContentLength() << " bytes" << std::endl;
+            }
+        }
+        if (put.valid()) {
+            auto put_outcome = put.get();
+            if (!put_outcome.IsSuccess()) {
+                store_status = 500;
+                store_error = "Failed to upload to S3: " + put_outcome.GetError().GetMessage();
+            } else {
+                job.stored = true;
+            }
+        }
+        bool claimed = false;
+        if (claim.valid()) {
+            JsonValue original;
+            switch (claim_result(claim.get(), dynamodb_client, table_name, job, original)) {
+            case Claim::Acquired:
+                claimed = true;
+                break;
+            case Claim::Duplicate:
+                rollback_job(job, bucket, s3_client);
+                std::cout << "Duplicate request, already scheduled: " << original.View().GetString("job_id") << std::endl;
+                return invocation_response::success(create_response(200, original).View().WriteCompact(), "application/json");
+            case Claim::InProgress:
+                rollback_job(job, bucket, s3_client);
+                std::cerr << "Error: A request with this idempotency key is in progress" << std::endl;
+                return error_response(409, "A request with this idempotency key is in progress");
+            case Claim::Failed:
+                rollback_job(job, bucket, s3_client);
+                return error_response(503, "Failed to claim idempotency key");
+            }
+        }
+        // Errors from here on remove the stored changes and give the key back,
+        // so the client's retry can succeed
+        auto fail = [&](int status, const std::string& message) {
+            std::cerr << "Error: " << message << std::endl;
+            rollback_job(job, bucket, s3_client);
+            if (claimed) release_claim(dynamodb_client, table_name, job);
+            return error_response(status, message);
+        };
+        if (!store_error.empty()) {
+            return fail(store_status, store_error);
+        }
+
+        std::string s3_path = "s3://" + bucket + "/" + job.key;
         std::cout << "S3 upload successful: " << s3_path << std::endl;
 
-        std::string cron_expr = cron_expression(dt);
-        std::string rule_name = "gits-" + std::to_string(now_tt);
-
-        // Put rule
-        std::cout << "Creating EventBridge rule: " << rule_name << ", cron: " << cron_expr << std::endl;
-        PutRuleRequest rule_request;
-        rule_request.SetName(rule_name);
-        rule_request.SetScheduleExpression(cron_expr);
-        rule_request.SetState(RuleState::ENABLED);
-        auto rule_outcome = events_client.PutRule(rule_request);
-        if (!rule_outcome.IsSuccess()) {
-            std::cerr << "Error: Failed to create EventBridge rule: " << rule_outcome.GetError().GetMessage() << std::endl;
-            JsonValue error_body;
-            error_body.WithString("error", "Failed to create EventBridge rule: " + rule_outcome.GetError().GetMessage());
-            return invocation_response::success(create_response(500, error_body).View().WriteCompact(), "application/json");
-        }
-        std::cout << "EventBridge rule created successfully" << std::endl;
-
-        std::string cb_project_arn = "arn:aws:codebuild:" + region + ":" + account_id + ":project/" + project;
-
-        JsonValue input_payload;
-        std::vector<JsonValue> env_vars_vector;
-        env_vars_vector.push_back(JsonValue().WithString("name", "S3_PATH").WithString("value", s3_path).WithString("type", "PLAINTEXT"));
-        env_vars_vector.push_back(JsonValue().WithString("name", "REPO_URL").WithString("value", repo_url).WithString("type", "PLAINTEXT"));
-        env_vars_vector.push_back(JsonValue().WithString("name", "GITHUB_USERNAME").WithString("value", github_username).WithString("type", "PLAINTEXT"));
-        env_vars_vector.push_back(JsonValue().WithString("name", "GITHUB_DISPLAY_NAME").WithString("value", github_display_name).WithString("type", "PLAINTEXT"));
-        env_vars_vector.push_back(JsonValue().WithString("name", "GITHUB_EMAIL").WithString("value", github_email).WithString("type", "PLAINTEXT"));
-        env_vars_vector.push_back(JsonValue().WithString("name", "COMMIT_MESSAGE").WithString("value", commit_message.empty() ? "" : commit_message).WithString("type", "PLAINTEXT"));
-        env_vars_vector.push_back(JsonValue().WithString("name", "USER_ID").WithString("value", user_id).WithString("type", "PLAINTEXT"));
-        Aws::Utils::Array<JsonValue> env_vars(env_vars_vector.data(), env_vars_vector.size());
-        input_payload.WithArray("environmentVariablesOverride", env_vars);
-
-        Target target;
-        target.SetId("Target1");
-        target.SetArn(cb_project_arn);
-        target.SetInput(input_payload.View().WriteCompact());
-        target.SetRoleArn(target_role_arn);
-
-        PutTargetsRequest targets_request;
-        targets_request.SetRule(rule_name);
-        targets_request.SetTargets({target});
-        std::cout << "Setting EventBridge targets for rule: " << rule_name << std::endl;
-        auto targets_outcome = events_client.PutTargets(targets_request);
-        if (!targets_outcome.IsSuccess()) {
-            std::cerr << "Error: Failed to set targets: " << targets_outcome.GetError().GetMessage() << std::endl;
-            JsonValue error_body;
-            error_body.WithString("error", "Failed to set targets: " + targets_outcome.GetError().GetMessage());
-            return invocation_response::success(create_response(500, error_body).View().WriteCompact(), "application/json");
-        }
-        std::cout << "EventBridge targets set successfully" << std::endl;
-
-        // DynamoDB
-        std::string table_name = getenv("DYNAMODB_TABLE") ? getenv("DYNAMODB_TABLE") : "";
-        if (!table_name.empty()) {
-            std::cout << "Writing to DynamoDB table: " << table_name << ", job_id: " << rule_name << std::endl;
+        // The job item is the schedule: the dispatcher starts the build when
+        // its minute comes. It is written only once the changes are in S3, so
+        // a dispatched job never finds them missing.
+        // Requests of one user in the same second (a batch sent as single
+        // requests by an older backend's client) would share the sort key, so
+        // the item is only written where none exists and otherwise moves on to
+        // <epoch>.101, <epoch>.102, ...
+        for (size_t attempt = 0;; ++attempt) {
+            if (attempt > 0) {
+                job.job_id = "gits-" + std::to_string(now_tt) + "-" + std::to_string(MAX_BATCH_JOBS + attempt);
+                job.added_at = batch_added_at(now_tt, MAX_BATCH_JOBS + attempt - 1);
+            }
+            job.due_bucket = job_due_bucket(job, now_tt);
+            std::cout << "Writing to DynamoDB table: " << table_name << ", job_id: " << job.job_id << ", due_bucket: " << job.due_bucket << std::endl;
             PutItemRequest put_item_request;
             put_item_request.SetTableName(table_name);
-            AttributeValue user_id_attr;
-            user_id_attr.SetS(user_id);
-            AttributeValue job_id_attr;
-            job_id_attr.SetS(rule_name);
-            AttributeValue schedule_time_attr;
-            schedule_time_attr.SetS(schedule_time);
-            AttributeValue status_attr;
-            status_attr.SetS("pending");
-            AttributeValue added_at_attr;
-            added_at_attr.SetN(std::to_string(now_tt));
-
-            put_item_request.AddItem("user_id", user_id_attr);
-            put_item_request.AddItem("job_id", job_id_attr);
-            put_item_request.AddItem("schedule_time", schedule_time_attr);
-            put_item_request.AddItem("status", status_attr);
-            put_item_request.AddItem("added_at", added_at_attr);
-
+            put_item_request.SetItem(job_item(job, bucket));
+            put_item_request.SetConditionExpression("attribute_not_exists(user_id)");
             auto db_outcome = dynamodb_client.PutItem(put_item_request);
-            if (!db_outcome.IsSuccess()) {
-                // Log error but don't fail
-                std::cerr << "Failed to write to DynamoDB: " << db_outcome.GetError().GetMessage() << std::endl;
-            } else {
-                std::cout << "DynamoDB write successful" << std::endl;
+            if (db_outcome.IsSuccess()) break;
+            if (db_outcome.GetError().GetErrorType() != DynamoDBErrors::CONDITIONAL_CHECK_FAILED || attempt + 1 == SAME_SECOND_ATTEMPTS) {
+                return fail(500, "Failed to schedule job: " + db_outcome.GetError().GetMessage());
             }
         }
+        std::cout << "DynamoDB write successful" << std::endl;
+
+        if (claimed) {
+            PutItemRequest claim_done_request;
+            claim_done_request.SetTableName(table_name);
+            claim_done_request.SetItem(claim_done_item(job, bucket, now_tt));
+            auto claim_outcome = dynamodb_client.PutItem(claim_done_request);
+            if (!claim_outcome.IsSuccess()) {
+                std::cerr << "Failed to record idempotency key: " << claim_outcome.GetError().GetMessage() << std::endl;
+            }
+        }
+
+        // cron_expression names the minute the job is due, in cron syntax
+        std::string cron_expr = cron_expression(job.dt);
 
         JsonValue success_body;
         success_body.WithString("message", "Scheduled");
-        success_body.WithString("rule_name", rule_name);
+        success_body.WithString("job_id", job.job_id);
+        success_body.WithString("rule_name", job.job_id);  // the job_id, for clients that predate it
         success_body.WithString("cron_expression", cron_expr);
         success_body.WithString("s3_path", s3_path);
         std::cout << "Lambda handler completed successfully" << std::endl;
@@ -250,12 +1654,30 @@ int main() {
     Aws::Client::ClientConfiguration config;
     config.region = getenv("AWS_APP_REGION") ? getenv("AWS_APP_REGION") : "";
 
-    S3Client s3_client(config);
+    // S3_ENDPOINT points the client at an S3-compatible stand-in such as MinIO
+    S3ClientConfiguration s3_config(config);
+    const char* s3_endpoint = getenv("S3_ENDPOINT");
+    if (s3_endpoint && *s3_endpoint) {
+        s3_config.endpointOverride = s3_endpoint;
+        s3_config.useVirtualAddressing = false;
+    }
+
+    S3Client s3_client(s3_config);
     EventBridgeClient events_client(config);
     DynamoDBClient dynamodb_client(config);
+    Aws::CodeBuild::CodeBuildClient codebuild_client(config);
 
+    // Handler time and the process's peak RSS so far (which includes earlier
+    // warm invocations), for comparing memory settings
     auto handler = [&](invocation_request const& req) {
-        return lambda_handler(req, s3_client, events_client, dynamodb_client);
+        auto start = std::chrono::steady_clock::now();
+        auto response = lambda_handler(req, s3_client, events_client, dynamodb_client, codebuild_client);
+        struct rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        std::cout << "Handler finished: duration_ms="
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+                  << ", peak_rss_kb=" << usage.ru_maxrss << ", request_bytes=" << req.payload.size() << std::endl;
+        return response;
     };
 
     run_handler(handler);
@@ -7,9 +7,13 @@
 #include <aws/core/utils/logging/LogLevel.h>
 #include <aws/core/utils/logging/ConsoleLogSystem.h>
 #include <aws/core/utils/logging/LogMacros.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <cstdlib>
+#include <thread>
 
 using namespace aws::lambda_runtime;
 using namespace Aws::DynamoDB;
@@ -17,6 +21,152 @@ using namespace Aws::DynamoDB::Model;
 using namespace Aws::Utils::Json;
 using namespace Aws::Utils::Logging;
 
+// Clients may answer repeated status calls from their own cache for this long
+static const int STATUS_MAX_AGE_SECONDS = 5;
+
+// The ETag names the newest job and its version, which codebuildlense bumps on
+// every status change. Items written before versions existed use their status.
+// Watchers pass wait=<seconds> with their ETag: the item is re-read at this
+// interval until it changes or the wait ends. The cap keeps the request under
+// API Gateway's 29 s integration timeout, and the Lambda timeout above it.
+static const int MAX_WAIT_SECONDS = 20;
+static const std::chrono::seconds WAIT_POLL_INTERVAL(1);
+
+// Function to read a request header; API Gateway passes them with the client's capitalization
+static std::string event_header(JsonView event, const std::string& name)
+{
+    JsonView headers = event.GetObject("headers");
+    if (!headers.IsObject()) return "";
+    for (const auto& header : headers.GetAllObjects()) {
+        const auto& key = header.first;
+        if (key.size() == name.size() && std::equal(key.begin(), key.end(), name.begin(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            })) {
+            return header.second.AsString();
+        }
+    }
+    return "";
+}
+
+static std::string status_etag(const Aws::Map<Aws::String, AttributeValue>& item)
+{
+    std::string etag = "\"" + std::string(item.at("added_at").GetN()) + "-";
+    if (item.count("version")) {
+        etag += "v" + std::string(item.at("version").GetN());
+    } else if (item.count("status")) {
+        etag += item.at("status").GetS();
+    }
+    return etag + "\"";
+}
+
+static JsonValue cache_headers(const std::string& etag)
+{
+    JsonValue headers;
+    headers.WithString("ETag", etag);
+    headers.WithString("Cache-Control", "private, max-age=" + std::to_string(STATUS_MAX_AGE_SECONDS));
+    return headers;
+}
+
+// The job listing (all=1) is paginated: each page carries next_cursor, the
+// added_at of its last job, until the user's jobs are exhausted
+static const int DEFAULT_PAGE_SIZE = 50;
+static const int MAX_PAGE_SIZE = 100;
+
+static bool is_cursor(const std::string& cursor)
+{
+    return !cursor.empty() && cursor.size() <= 32 && cursor.find_first_not_of("0123456789.") == std::string::npos;
+}
+
+static invocation_response list_jobs(DynamoDBClient& dynamoClient, const std::string& table_name, const std::string& user_id, JsonView queryParams)
+{
+    int page_size = DEFAULT_PAGE_SIZE;
+    bool valid = true;
+    try {
+        std::string limit = queryParams.GetString("limit");
+        page_size = limit.empty() ? DEFAULT_PAGE_SIZE : std::clamp(std::stoi(limit), 1, MAX_PAGE_SIZE);
+    } catch (const std::exception&) {
+        valid = false;
+    }
+    std::string cursor = queryParams.GetString("cursor");
+    if (!valid || (!cursor.empty() && !is_cursor(cursor))) {
+        std::cerr << "Invalid cursor or limit" << std::endl;
+        JsonValue fullResponse;
+        fullResponse.WithInteger("statusCode", 400);
+        fullResponse.WithString("body", JsonValue().WithString("error", "Invalid cursor or limit").View().WriteReadable());
+        return invocation_response::success(fullResponse.View().WriteReadable(), "application/json");
+    }
+
+    // Newest first, reading only the attributes the listing shows
+    QueryRequest queryRequest;
+    queryRequest.SetTableName(table_name);
+    queryRequest.SetKeyConditionExpression("user_id = :user_id");
+    AttributeValue userIdAttr;
+    userIdAttr.SetS(user_id);
+    queryRequest.AddExpressionAttributeValues(":user_id", userIdAttr);
+    queryRequest.SetScanIndexForward(false);
+    queryRequest.SetLimit(page_size);
+    queryRequest.SetProjectionExpression("job_id, schedule_time, #status, added_at");
+    queryRequest.AddExpressionAttributeNames("#status", "status");
+
+    // Filters apply after the page is read, so a page may hold fewer jobs than
+    // the limit, or none, and still carry a cursor
+    std::string filter;
+    for (const auto& condition : {std::make_pair("status", "#status = :status"),
+                                  std::make_pair("since", "schedule_time >= :since"),
+                                  std::make_pair("until", "schedule_time < :until")}) {
+        std::string value = queryParams.GetString(condition.first);
+        if (value.empty()) continue;
+        AttributeValue attr;
+        attr.SetS(value);
+        queryRequest.AddExpressionAttributeValues(std::string(":") + condition.first, attr);
+        filter += (filter.empty() ? "" : " AND ") + std::string(condition.second);
+    }
+    if (!filter.empty()) {
+        queryRequest.SetFilterExpression(filter);
+    }
+    if (!cursor.empty()) {
+        AttributeValue addedAtAttr;
+        addedAtAttr.SetN(cursor);
+        queryRequest.AddExclusiveStartKey("user_id", userIdAttr);
+        queryRequest.AddExclusiveStartKey("added_at", addedAtAttr);
+    }
+
+    std::cout << "Listing jobs for user_id: " << user_id << ", limit: " << page_size << ", cursor: " << cursor << std::endl;
+    auto queryOutcome = dynamoClient.Query(queryRequest);
+    if (!queryOutcome.IsSuccess()) {
+        std::cerr << "DynamoDB query failed: " << queryOutcome.GetError().GetMessage() << std::endl;
+        JsonValue fullResponse;
+        fullResponse.WithInteger("statusCode", 500);
+        fullResponse.WithString("body", JsonValue().WithString("error", "Internal server error").View().WriteReadable());
+        return invocation_response::success(fullResponse.View().WriteReadable(), "application/json");
+    }
+
+    const auto& items = queryOutcome.GetResult().GetItems();
+    Aws::Utils::Array<JsonValue> jobs(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        JsonValue job;
+        for (const char* field : {"job_id", "schedule_time", "status"}) {
+            auto it = items[i].find(field);
+            if (it != items[i].end()) job.WithString(field, it->second.GetS());
+        }
+        job.WithString("added_at", items[i].at("added_at").GetN());
+        jobs[i] = job;
+    }
+    JsonValue body;
+    body.WithArray("jobs", jobs);
+    const auto& lastKey = queryOutcome.GetResult().GetLastEvaluatedKey();
+    auto last = lastKey.find("added_at");
+    if (last != lastKey.end()) {
+        body.WithString("next_cursor", last->second.GetN());
+    }
+    std::cout << "Listed " << items.size() << " job(s) of " << queryOutcome.GetResult().GetScannedCount() << " read" << std::endl;
+
+    JsonValue fullResponse;
+    fullResponse.WithInteger("statusCode", 200);
+    fullResponse.WithString("body", body.View().WriteCompact());
+    return invocation_response::success(fullResponse.View().WriteReadable(), "application/json");
+}
+
 static invocation_response my_handler(invocation_request const& request)
 {
     std::cout << "Lambda handler started" << std::endl;
@@ -72,6 +222,10 @@ static invocation_response my_handler(invocation_request const& request)
     DynamoDBClient dynamoClient(clientConfig);
     std::cout << "DynamoDB client initialized" << std::endl;
 
+    if (queryParams.GetString("all") == "1") {
+        return list_jobs(dynamoClient, table_name, user_id, queryParams);
+    }
+
     QueryRequest queryRequest;
     queryRequest.SetTableName(table_name);
     Aws::String keyCondition = "user_id = :user_id";
@@ -82,28 +236,60 @@ static invocation_response my_handler(invocation_request const& request)
     queryRequest.SetScanIndexForward(false);
     queryRequest.SetLimit(1);
 
-    std::cout << "Querying DynamoDB for user_id: " << user_id << std::endl;
-    auto queryOutcome = dynamoClient.Query(queryRequest);
-    if (!queryOutcome.IsSuccess()) {
-        std::cerr << "DynamoDB query failed: " << queryOutcome.GetError().GetMessage() << std::endl;
-        JsonValue fullResponse;
-        fullResponse.WithInteger("statusCode", 500);
-        fullResponse.WithString("body", JsonValue().WithString("error", "Internal server error").View().WriteReadable());
-        return invocation_response::success(fullResponse.View().WriteReadable(), "application/json");
+    std::string if_none_match = event_header(eventView, "If-None-Match");
+    int wait_seconds = 0;
+    try {
+        std::string wait = queryParams.GetString("wait");
+        wait_seconds = wait.empty() ? 0 : std::clamp(std::stoi(wait), 0, MAX_WAIT_SECONDS);
+    } catch (const std::exception&) {
+        std::cerr << "Invalid wait parameter" << std::endl;
     }
-    std::cout << "DynamoDB query successful" << std::endl;
+    if (wait_seconds > 0 && !if_none_match.empty()) {
+        // A watcher needs to see the update as soon as it is written
+        queryRequest.SetConsistentRead(true);
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(wait_seconds);
+
+    Aws::Map<Aws::String, AttributeValue> item;
+    std::string etag;
+    for (;;) {
+        std::cout << "Querying DynamoDB for user_id: " << user_id << std::endl;
+        auto queryOutcome = dynamoClient.Query(queryRequest);
+        if (!queryOutcome.IsSuccess()) {
+            std::cerr << "DynamoDB query failed: " << queryOutcome.GetError().GetMessage() << std::endl;
+            JsonValue fullResponse;
+            fullResponse.WithInteger("statusCode", 500);
+            fullResponse.WithString("body", JsonValue().WithString("error", "Internal server error").View().WriteReadable());
+            return invocation_response::success(fullResponse.View().WriteReadable(), "application/json");
+        }
+        std::cout << "DynamoDB query successful" << std::endl;
 
-    auto& items = queryOutcome.GetResult().GetItems();
-    if (items.empty()) {
-        std::cout << "No items found for user_id: " << user_id << std::endl;
+        auto& items = queryOutcome.GetResult().GetItems();
+        if (items.empty()) {
+            std::cout << "No items found for user_id: " << user_id << std::endl;
+            JsonValue fullResponse;
+            fullResponse.WithInteger("statusCode", 404);
+            fullResponse.WithString("body", JsonValue().WithString("error", "No scheduled jobs found for this user").View().WriteReadable());
+            return invocation_response::success(fullResponse.View().WriteReadable(), "application/json");
+        }
+        std::cout << "Found " << items.size() << " item(s) for user_id: " << user_id << std::endl;
+
+        item = items[0];
+        etag = status_etag(item);
+        if (if_none_match != etag || std::chrono::steady_clock::now() + WAIT_POLL_INTERVAL > deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(WAIT_POLL_INTERVAL);
+    }
+    if (!if_none_match.empty() && if_none_match == etag) {
+        std::cout << "Not modified for user_id: " << user_id << ", etag: " << etag << std::endl;
         JsonValue fullResponse;
-        fullResponse.WithInteger("statusCode", 404);
-        fullResponse.WithString("body", JsonValue().WithString("error", "No scheduled jobs found for this user").View().WriteReadable());
+        fullResponse.WithInteger("statusCode", 304);
+        fullResponse.WithObject("headers", cache_headers(etag));
+        fullResponse.WithString("body", "");
         return invocation_response::success(fullResponse.View().WriteReadable(), "application/json");
     }
-    std::cout << "Found " << items.size() << " item(s) for user_id: " << user_id << std::endl;
 
-    auto& item = items[0];
     JsonValue body;
     if (item.count("job_id")) {
         body.WithString("job_id", item.at("job_id").GetS());
@@ -119,6 +305,7 @@ static invocation_response my_handler(invocation_request const& request)
     std::cout << "Returning success for user_id: " << user_id << std::endl;
     JsonValue fullResponse;
     fullResponse.WithInteger("statusCode", 200);
+    fullResponse.WithObject("headers", cache_headers(etag));
     fullResponse.WithString("body", body.View().WriteReadable());
     std::cout << "Lambda handler completed successfully" << std::endl;
     return invocation_response::success(fullResponse.View().WriteReadable(), "application/json");
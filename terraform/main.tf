@@ -137,7 +137,6 @@ module "lambda" {
   dynamodb_table_name                 = local.dynamodb_table_name
   artifact_bucket_name                = local.artifact_bucket_name
   codebuild_project_name              = var.project_name
-  eventbridge_target_role_arn         = module.iam.eventbridge_target_role_arn
   private_subnet_id                   = module.vpc.private_subnet_id
   schedule_lambda_role_arn            = module.iam.schedule_lambda_role_arn
   delete_lambda_role_arn              = module.iam.delete_lambda_role_arn
@@ -196,6 +195,8 @@ module "eventbridge" {
   project_name             = var.project_name
   codebuildlens_lambda_arn = module.lambda[0].codebuildlens_lambda_arn
   codebuildlens_lambda_name = module.lambda[0].codebuildlens_lambda_name
+  dispatch_lambda_arn      = module.lambda[0].dispatch_lambda_arn
+  dispatch_lambda_name     = module.lambda[0].dispatch_lambda_name
 
   depends_on = [module.lambda]
 }
@@ -9,6 +9,10 @@ resource "aws_api_gateway_rest_api" "main" {
     types = ["REGIONAL"]
   }
 
+  # Multipart schedule bodies carry the raw archive; they reach the lambda
+  # base64-encoded instead of being mangled as text
+  binary_media_types = ["multipart/form-data"]
+
   tags = {
     Name = "${var.project_name}-api"
   }
@@ -48,6 +52,110 @@ resource "aws_lambda_permission" "schedule" {
   source_arn    = "${aws_api_gateway_rest_api.main.execution_arn}/*/*/*"
 }
 
+#------------------------------------------------------------------------------
+# Schedule Batch Resource and Method (served by the schedule lambda)
+#------------------------------------------------------------------------------
+resource "aws_api_gateway_resource" "schedule_batch" {
+  rest_api_id = aws_api_gateway_rest_api.main.id
+  parent_id   = aws_api_gateway_resource.schedule.id
+  path_part   = "batch"
+}
+
+resource "aws_api_gateway_method" "schedule_batch" {
+  rest_api_id      = aws_api_gateway_rest_api.main.id
+  resource_id      = aws_api_gateway_resource.schedule_batch.id
+  http_method      = "POST"
+  authorization    = "NONE"
+  api_key_required = true
+}
+
+resource "aws_api_gateway_integration" "schedule_batch" {
+  rest_api_id             = aws_api_gateway_rest_api.main.id
+  resource_id             = aws_api_gateway_resource.schedule_batch.id
+  http_method             = aws_api_gateway_method.schedule_batch.http_method
+  integration_http_method = "POST"
+  type                    = "AWS_PROXY"
+  uri                     = "arn:aws:apigateway:${var.aws_region}:lambda:path/2015-03-31/functions/${var.schedule_lambda_arn}/invocations"
+}
+
+#------------------------------------------------------------------------------
+# Upload URL Resource and Method (served by the schedule lambda)
+#------------------------------------------------------------------------------
+resource "aws_api_gateway_resource" "upload_url" {
+  rest_api_id = aws_api_gateway_rest_api.main.id
+  parent_id   = aws_api_gateway_rest_api.main.root_resource_id
+  path_part   = "upload-url"
+}
+
+resource "aws_api_gateway_method" "upload_url" {
+  rest_api_id      = aws_api_gateway_rest_api.main.id
+  resource_id      = aws_api_gateway_resource.upload_url.id
+  http_method      = "POST"
+  authorization    = "NONE"
+  api_key_required = true
+}
+
+resource "aws_api_gateway_integration" "upload_url" {
+  rest_api_id             = aws_api_gateway_rest_api.main.id
+  resource_id             = aws_api_gateway_resource.upload_url.id
+  http_method             = aws_api_gateway_method.upload_url.http_method
+  integration_http_method = "POST"
+  type                    = "AWS_PROXY"
+  uri                     = "arn:aws:apigateway:${var.aws_region}:lambda:path/2015-03-31/functions/${var.schedule_lambda_arn}/invocations"
+}
+
+#------------------------------------------------------------------------------
+# Blobs Resource and Method (served by the schedule lambda)
+#------------------------------------------------------------------------------
+resource "aws_api_gateway_resource" "blobs" {
+  rest_api_id = aws_api_gateway_rest_api.main.id
+  parent_id   = aws_api_gateway_rest_api.main.root_resource_id
+  path_part   = "blobs"
+}
+
+resource "aws_api_gateway_method" "blobs" {
+  rest_api_id      = aws_api_gateway_rest_api.main.id
+  resource_id      = aws_api_gateway_resource.blobs.id
+  http_method      = "POST"
+  authorization    = "NONE"
+  api_key_required = true
+}
+
+resource "aws_api_gateway_integration" "blobs" {
+  rest_api_id             = aws_api_gateway_rest_api.main.id
+  resource_id             = aws_api_gateway_resource.blobs.id
+  http_method             = aws_api_gateway_method.blobs.http_method
+  integration_http_method = "POST"
+  type                    = "AWS_PROXY"
+  uri                     = "arn:aws:apigateway:${var.aws_region}:lambda:path/2015-03-31/functions/${var.schedule_lambda_arn}/invocations"
+}
+
+#------------------------------------------------------------------------------
+# Multipart Resource and Method (served by the schedule lambda)
+#------------------------------------------------------------------------------
+resource "aws_api_gateway_resource" "multipart" {
+  rest_api_id = aws_api_gateway_rest_api.main.id
+  parent_id   = aws_api_gateway_rest_api.main.root_resource_id
+  path_part   = "multipart"
+}
+
+resource "aws_api_gateway_method" "multipart" {
+  rest_api_id      = aws_api_gateway_rest_api.main.id
+  resource_id      = aws_api_gateway_resource.multipart.id
+  http_method      = "POST"
+  authorization    = "NONE"
+  api_key_required = true
+}
+
+resource "aws_api_gateway_integration" "multipart" {
+  rest_api_id             = aws_api_gateway_rest_api.main.id
+  resource_id             = aws_api_gateway_resource.multipart.id
+  http_method             = aws_api_gateway_method.multipart.http_method
+  integration_http_method = "POST"
+  type                    = "AWS_PROXY"
+  uri                     = "arn:aws:apigateway:${var.aws_region}:lambda:path/2015-03-31/functions/${var.schedule_lambda_arn}/invocations"
+}
+
 #------------------------------------------------------------------------------
 # Delete Resource and Method
 #------------------------------------------------------------------------------
@@ -127,6 +235,18 @@ resource "aws_api_gateway_deployment" "main" {
       aws_api_gateway_resource.schedule.id,
       aws_api_gateway_method.schedule.id,
       aws_api_gateway_integration.schedule.id,
+      aws_api_gateway_resource.schedule_batch.id,
+      aws_api_gateway_method.schedule_batch.id,
+      aws_api_gateway_integration.schedule_batch.id,
+      aws_api_gateway_resource.upload_url.id,
+      aws_api_gateway_method.upload_url.id,
+      aws_api_gateway_integration.upload_url.id,
+      aws_api_gateway_resource.blobs.id,
+      aws_api_gateway_method.blobs.id,
+      aws_api_gateway_integration.blobs.id,
+      aws_api_gateway_resource.multipart.id,
+      aws_api_gateway_method.multipart.id,
+      aws_api_gateway_integration.multipart.id,
       aws_api_gateway_resource.delete.id,
       aws_api_gateway_method.delete.id,
       aws_api_gateway_integration.delete.id,
@@ -142,6 +262,10 @@ resource "aws_api_gateway_deployment" "main" {
 
   depends_on = [
     aws_api_gateway_integration.schedule,
+    aws_api_gateway_integration.schedule_batch,
+    aws_api_gateway_integration.upload_url,
+    aws_api_gateway_integration.blobs,
+    aws_api_gateway_integration.multipart,
     aws_api_gateway_integration.delete,
     aws_api_gateway_integration.status,
   ]
@@ -25,6 +25,11 @@ resource "aws_dynamodb_table" "jobs" {
     type = "S"
   }
 
+  attribute {
+    name = "due_bucket"
+    type = "S"
+  }
+
   # Global Secondary Index on job_id
   global_secondary_index {
     name            = "job_id-index"
@@ -34,6 +39,24 @@ resource "aws_dynamodb_table" "jobs" {
     write_capacity  = var.billing_mode == "PROVISIONED" ? var.write_capacity : null
   }
 
+  # Pending jobs by the minute they are due, for the dispatcher, and jobs
+  # whose build is being started. Sparse: due_bucket is removed once a job's
+  # build id is recorded.
+  global_secondary_index {
+    name            = "due_bucket-index"
+    hash_key        = "due_bucket"
+    range_key       = "added_at"
+    projection_type = "ALL"
+    read_capacity   = var.billing_mode == "PROVISIONED" ? var.read_capacity : null
+    write_capacity  = var.billing_mode == "PROVISIONED" ? var.write_capacity : null
+  }
+
+  # Idempotency claims expire on their own
+  ttl {
+    attribute_name = "expires_at"
+    enabled        = true
+  }
+
   # Point-in-time recovery
   point_in_time_recovery {
     enabled = var.point_in_time_recovery
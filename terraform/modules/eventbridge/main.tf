@@ -31,3 +31,28 @@ resource "aws_lambda_permission" "eventbridge" {
   principal     = "events.amazonaws.com"
   source_arn    = aws_cloudwatch_event_rule.codebuild_state_change.arn
 }
+
+# EventBridge Rule that runs the dispatcher every minute
+resource "aws_cloudwatch_event_rule" "dispatch" {
+  name                = "${var.project_name}-dispatch"
+  description         = "Triggers the dispatch lambda to start due builds"
+  schedule_expression = "rate(1 minute)"
+
+  tags = {
+    Name = "${var.project_name}-dispatch"
+  }
+}
+
+resource "aws_cloudwatch_event_target" "dispatch" {
+  rule      = aws_cloudwatch_event_rule.dispatch.name
+  target_id = "DispatchLambda"
+  arn       = var.dispatch_lambda_arn
+}
+
+resource "aws_lambda_permission" "dispatch" {
+  statement_id  = "AllowEventBridgeInvoke"
+  action        = "lambda:InvokeFunction"
+  function_name = var.dispatch_lambda_name
+  principal     = "events.amazonaws.com"
+  source_arn    = aws_cloudwatch_event_rule.dispatch.arn
+}
@@ -7,3 +7,8 @@ output "codebuild_state_change_rule_name" {
   description = "Name of the CodeBuild state change EventBridge rule"
   value       = aws_cloudwatch_event_rule.codebuild_state_change.name
 }
+
+output "dispatch_rule_arn" {
+  description = "ARN of the every-minute dispatch EventBridge rule"
+  value       = aws_cloudwatch_event_rule.dispatch.arn
+}
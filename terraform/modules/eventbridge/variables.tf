@@ -12,3 +12,13 @@ variable "codebuildlens_lambda_name" {
   description = "CodeBuildLens Lambda function name"
   type        = string
 }
+
+variable "dispatch_lambda_arn" {
+  description = "Dispatch Lambda ARN"
+  type        = string
+}
+
+variable "dispatch_lambda_name" {
+  description = "Dispatch Lambda function name"
+  type        = string
+}
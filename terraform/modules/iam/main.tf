@@ -39,28 +39,58 @@ resource "aws_iam_role_policy" "schedule_lambda" {
         Effect = "Allow"
         Action = [
           "dynamodb:PutItem",
-          "dynamodb:UpdateItem"
+          "dynamodb:BatchWriteItem",
+          "dynamodb:UpdateItem",
+          "dynamodb:GetItem",
+          "dynamodb:DeleteItem",
+          "dynamodb:Query"
         ]
-        Resource = "arn:aws:dynamodb:${var.aws_region}:${var.account_id}:table/${var.dynamodb_table_name}"
+        Resource = [
+          "arn:aws:dynamodb:${var.aws_region}:${var.account_id}:table/${var.dynamodb_table_name}",
+          "arn:aws:dynamodb:${var.aws_region}:${var.account_id}:table/${var.dynamodb_table_name}/index/*"
+        ]
+      },
+      {
+        Sid      = "CodeBuildStart"
+        Effect   = "Allow"
+        Action   = "codebuild:StartBuild"
+        Resource = "arn:aws:codebuild:${var.aws_region}:${var.account_id}:project/${var.project_name}"
       },
       {
-        Sid    = "EventBridgeCreateRules"
+        Sid    = "EventBridgeSweepRules"
         Effect = "Allow"
         Action = [
-          "events:PutRule",
-          "events:PutTargets",
-          "events:DescribeRule"
+          "events:DescribeRule",
+          "events:RemoveTargets",
+          "events:DeleteRule"
         ]
         Resource = "arn:aws:events:${var.aws_region}:${var.account_id}:rule/*"
       },
+      {
+        Sid      = "EventBridgeListRules"
+        Effect   = "Allow"
+        Action   = "events:ListRules"
+        Resource = "*"
+      },
       {
         Sid    = "S3PutObject"
         Effect = "Allow"
         Action = [
-          "s3:PutObject"
+          "s3:PutObject",
+          "s3:DeleteObject",
+          "s3:GetObject",
+          "s3:ListMultipartUploadParts"
         ]
         Resource = "arn:aws:s3:::${var.artifact_bucket_name}/*"
       },
+      {
+        Sid    = "S3ListBucket"
+        Effect = "Allow"
+        Action = [
+          "s3:ListBucket"
+        ]
+        Resource = "arn:aws:s3:::${var.artifact_bucket_name}"
+      },
       {
         Sid    = "SecretsManagerCreate"
         Effect = "Allow"
@@ -72,12 +102,6 @@ resource "aws_iam_role_policy" "schedule_lambda" {
         ]
         Resource = "arn:aws:secretsmanager:${var.aws_region}:${var.account_id}:secret:*"
       },
-      {
-        Sid      = "PassRoleToEventBridge"
-        Effect   = "Allow"
-        Action   = "iam:PassRole"
-        Resource = aws_iam_role.eventbridge_target.arn
-      },
       {
         Sid    = "ECRAccess"
         Effect = "Allow"
@@ -332,7 +356,8 @@ resource "aws_iam_role_policy" "codebuildlens_lambda" {
 }
 
 #------------------------------------------------------------------------------
-# EventBridge Target Role
+# EventBridge Target Role (per-job rules made before the dispatcher; kept until
+# they have fired)
 #------------------------------------------------------------------------------
 resource "aws_iam_role" "eventbridge_target" {
   name = "${var.project_name}-events-target"
@@ -21,7 +21,6 @@ resource "aws_lambda_function" "schedule" {
       AWS_APP_REGION             = var.aws_region
       AWS_BUCKET_NAME            = var.artifact_bucket_name
       AWS_CODEBUILD_PROJECT_NAME = var.codebuild_project_name
-      EVENTBRIDGE_TARGET_ROLE_ARN = var.eventbridge_target_role_arn
     }
   }
 
@@ -30,6 +29,40 @@ resource "aws_lambda_function" "schedule" {
   }
 }
 
+#------------------------------------------------------------------------------
+# Dispatch Lambda (schedule image, invoked every minute to start due builds)
+#------------------------------------------------------------------------------
+resource "aws_lambda_function" "dispatch" {
+  function_name = "${var.project_name}-dispatch"
+  role          = var.schedule_lambda_role_arn
+  package_type  = "Image"
+  image_uri     = var.image_uri_schedule
+  timeout       = 60
+  memory_size   = var.schedule_memory
+
+  # One run at a time; the conditional claims keep an overlap harmless anyway
+  reserved_concurrent_executions = 1
+
+  vpc_config {
+    subnet_ids         = [var.private_subnet_id]
+    security_group_ids = [var.schedule_lambda_security_group_id]
+  }
+
+  environment {
+    variables = {
+      DYNAMODB_TABLE             = var.dynamodb_table_name
+      AWS_ACCOUNT_ID             = var.account_id
+      AWS_APP_REGION             = var.aws_region
+      AWS_BUCKET_NAME            = var.artifact_bucket_name
+      AWS_CODEBUILD_PROJECT_NAME = var.codebuild_project_name
+    }
+  }
+
+  tags = {
+    Name = "${var.project_name}-dispatch"
+  }
+}
+
 #------------------------------------------------------------------------------
 # Delete Lambda
 #------------------------------------------------------------------------------
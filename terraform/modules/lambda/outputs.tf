@@ -8,6 +8,16 @@ output "schedule_lambda_name" {
   value       = aws_lambda_function.schedule.function_name
 }
 
+output "dispatch_lambda_arn" {
+  description = "ARN of the dispatch Lambda function"
+  value       = aws_lambda_function.dispatch.arn
+}
+
+output "dispatch_lambda_name" {
+  description = "Name of the dispatch Lambda function"
+  value       = aws_lambda_function.dispatch.function_name
+}
+
 output "delete_lambda_arn" {
   description = "ARN of the delete Lambda function"
   value       = aws_lambda_function.delete.arn
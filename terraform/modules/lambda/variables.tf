@@ -28,11 +28,6 @@ variable "codebuild_project_name" {
   type        = string
 }
 
-variable "eventbridge_target_role_arn" {
-  description = "EventBridge target role ARN"
-  type        = string
-}
-
 variable "private_subnet_id" {
   description = "Private subnet ID"
   type        = string
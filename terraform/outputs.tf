@@ -134,6 +134,11 @@ output "schedule_lambda_arn" {
   value       = var.lambda_image_uri_schedule != "" ? module.lambda[0].schedule_lambda_arn : null
 }
 
+output "dispatch_lambda_arn" {
+  description = "ARN of the dispatch Lambda function"
+  value       = var.lambda_image_uri_schedule != "" ? module.lambda[0].dispatch_lambda_arn : null
+}
+
 output "delete_lambda_arn" {
   description = "ARN of the delete Lambda function"
   value       = var.lambda_image_uri_schedule != "" ? module.lambda[0].delete_lambda_arn : null
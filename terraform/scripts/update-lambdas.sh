@@ -51,6 +51,7 @@ update_lambda() {
 
 # Update all Lambda functions
 update_lambda "${PROJECT_NAME}-schedule" "${PROJECT_NAME}-schedule-lambda"
+update_lambda "${PROJECT_NAME}-dispatch" "${PROJECT_NAME}-schedule-lambda"
 update_lambda "${PROJECT_NAME}-delete" "${PROJECT_NAME}-delete-lambda"
 update_lambda "${PROJECT_NAME}-status" "${PROJECT_NAME}-status-lambda"
 update_lambda "${PROJECT_NAME}-codebuildlens" "${PROJECT_NAME}-codebuildlens-lambda"
@@ -195,9 +195,9 @@ variable "lambda_delete_memory" {
 }
 
 variable "lambda_status_timeout" {
-  description = "Timeout for status Lambda (seconds)"
+  description = "Timeout for status Lambda (seconds); long-poll requests wait up to 20"
   type        = number
-  default     = 15
+  default     = 30
 }
 
 variable "lambda_status_memory" {
@@ -3,12 +3,20 @@ Pytest configuration and shared fixtures for E2E tests.
 """
 
 import os
+import io
+import json
 import pytest
 import subprocess
+import sys
 import tempfile
 import shutil
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
 from pathlib import Path
 
+sys.path.insert(0, str(Path(__file__).resolve().parents[2] / "codebuild"))
+from extract_changes import iter_entries  # noqa: E402
+
 
 @pytest.fixture(scope="session")
 def gits_binary():
@@ -151,3 +159,106 @@ def get_future_time(minutes=2):
     from datetime import datetime, timedelta
     future = datetime.now() + timedelta(minutes=minutes)
     return future.strftime("%Y-%m-%dT%H:%M")
+
+
+def read_changeset(data):
+    """Return {name: bytes} for a changeset zip, whatever codecs it uses."""
+    return {info.filename: content for info, content in iter_entries(io.BytesIO(data))}
+
+
+class FakeApi:
+    """Local stand-in for API Gateway that records every request it receives.
+
+    Routes map (method, path) to a callable taking the recorded request dict
+    and returning (status, body_dict) or (status, body_dict, headers_dict). Unknown routes answer 403 like API
+    Gateway does for missing resources.
+    """
+
+    def __init__(self):
+        self.requests = []
+        self.routes = {}
+        handler = self._make_handler()
+        self.server = ThreadingHTTPServer(("127.0.0.1", 0), handler)
+        self.thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+
+    @property
+    def url(self):
+        return f"http://127.0.0.1:{self.server.server_address[1]}"
+
+    def _make_handler(self):
+        api = self
+
+        class Handler(BaseHTTPRequestHandler):
+            protocol_version = "HTTP/1.1"
+
+            def _read_body(self):
+                if self.headers.get("Transfer-Encoding", "").lower() == "chunked":
+                    body = b""
+                    while True:
+                        size = int(self.rfile.readline().strip(), 16)
+                        if size == 0:
+                            self.rfile.readline()
+                            return body
+                        body += self.rfile.read(size)
+                        self.rfile.readline()
+                length = int(self.headers.get("Content-Length", 0))
+                return self.rfile.read(length) if length else b""
+
+            def _handle(self):
+                path, _, query = self.path.partition("?")
+                request = {
+                    "method": self.command,
+                    "path": path,
+                    "query": query,
+                    "headers": dict(self.headers),
+                    "body": self._read_body(),
+                }
+                api.requests.append(request)
+                route = api.routes.get((self.command, path))
+                status, body, *extra = route(request) if route else (403, {"message": "Missing Authentication Token"})
+                out = json.dumps(body).encode() if status != 304 else b""
+                self.send_response(status)
+                self.send_header("Content-Type", "application/json")
+                for name, value in (extra[0] if extra else {}).items():
+                    self.send_header(name, value)
+                self.send_header("Content-Length", str(len(out)))
+                self.end_headers()
+                self.wfile.write(out)
+
+            do_GET = do_POST = do_PUT = _handle
+
+            def log_message(self, *args):
+                pass
+
+        return Handler
+
+
+@pytest.fixture
+def fake_api():
+    """Start a FakeApi server for the duration of a test."""
+    api = FakeApi()
+    api.thread.start()
+    yield api
+    api.server.shutdown()
+
+
+@pytest.fixture
+def api_gits_config(tmp_path, fake_api):
+    """Create a full gits config pointing at the FakeApi server."""
+    config_dir = tmp_path / ".gits"
+    config_dir.mkdir(exist_ok=True)
+    config_file = config_dir / "config"
+    config_file.write_text(f"""GITHUB_EMAIL=test@example.com
+GITHUB_USERNAME=testuser
+GITHUB_DISPLAY_NAME=Test User
+API_GATEWAY_URL={fake_api.url}
+API_KEY=test-key
+""")
+
+    old_home = os.environ.get("HOME")
+    os.environ["HOME"] = str(tmp_path)
+
+    yield config_file
+
+    if old_home:
+        os.environ["HOME"] = old_home
@@ -4,7 +4,7 @@ AWS integration tests for gits CLI.
 These tests verify the full flow:
 1. Schedule a job using gits CLI
 2. Verify DynamoDB entry created
-3. Verify EventBridge rule created
+3. Verify the job is queued for the dispatcher
 4. Wait for scheduled time
 5. Verify CodeBuild execution
 6. Verify commit appeared in test repository
@@ -17,6 +17,7 @@ Test cases covered:
 16. Schedule 2 posts at same time → success
 + Full flow verification
 + Retrieving order verification
++ Malformed schedule_time → 400, nothing queued
 """
 
 import os
@@ -35,12 +36,12 @@ DYNAMODB_TABLE = os.environ.get("DYNAMODB_TABLE", "gits-jobs")
 API_GATEWAY_URL = os.environ.get("API_GATEWAY_URL", "")
 TEST_REPO_PATH = os.environ.get("TEST_REPO_PATH", "/tmp/gitstest")
 TEST_GITHUB_EMAIL = os.environ.get("TEST_GITHUB_EMAIL", "")
+API_KEY = os.environ.get("API_KEY", "")
 GITS_BINARY = os.environ.get("GITS_BINARY", "gits")
 
 
 # AWS clients
 dynamodb = boto3.client("dynamodb", region_name=AWS_REGION)
-events = boto3.client("events", region_name=AWS_REGION)
 codebuild = boto3.client("codebuild", region_name=AWS_REGION)
 
 
@@ -96,16 +97,10 @@ def get_dynamodb_job(user_id, job_id=None):
         return []
 
 
-def get_eventbridge_rule(rule_name):
-    """Get EventBridge rule details."""
-    try:
-        response = events.describe_rule(Name=rule_name)
-        return response
-    except events.exceptions.ResourceNotFoundException:
-        return None
-    except Exception as e:
-        print(f"Error getting EventBridge rule: {e}")
-        return None
+def is_queued(job):
+    """Whether a job item waits for the dispatcher (due_bucket is "<epoch minute>#<shard>")."""
+    minute, _, shard = job.get("due_bucket", {}).get("S", "").partition("#")
+    return minute.isdigit() and shard.isdigit()
 
 
 def delete_job(job_id, user_id):
@@ -228,11 +223,9 @@ class TestScheduleWithFiles:
         assert latest_job["schedule_time"]["S"] == db_time
         assert latest_job["status"]["S"] == "pending"
         
-        # Verify EventBridge rule exists
+        # Verify the job waits for the dispatcher
         job_id = latest_job["job_id"]["S"]
-        rule = get_eventbridge_rule(job_id)
-        assert rule is not None, f"EventBridge rule {job_id} not found"
-        assert rule["State"] == "ENABLED"
+        assert is_queued(latest_job), f"Job {job_id} is not queued"
         
         # Cleanup - delete the job
         delete_job(job_id, TEST_GITHUB_EMAIL)
@@ -274,9 +267,7 @@ class TestScheduleWithDeletedFiles:
         assert latest_job["schedule_time"]["S"] == db_time
 
         job_id = latest_job["job_id"]["S"]
-        rule = get_eventbridge_rule(job_id)
-        assert rule is not None, f"EventBridge rule {job_id} not found"
-        assert rule["State"] == "ENABLED"
+        assert is_queued(latest_job), f"Job {job_id} is not queued"
 
         delete_job(latest_job["job_id"]["S"], TEST_GITHUB_EMAIL)
 
@@ -309,9 +300,7 @@ class TestScheduleAutoDetect:
         assert latest_job["schedule_time"]["S"] == db_time
 
         job_id = latest_job["job_id"]["S"]
-        rule = get_eventbridge_rule(job_id)
-        assert rule is not None, f"EventBridge rule {job_id} not found"
-        assert rule["State"] == "ENABLED"
+        assert is_queued(latest_job), f"Job {job_id} is not queued"
 
         delete_job(latest_job["job_id"]["S"], TEST_GITHUB_EMAIL)
 
@@ -357,14 +346,8 @@ class TestScheduleSameTime:
         assert jobs[0]["schedule_time"]["S"] == db_time
         assert jobs[1]["schedule_time"]["S"] == db_time
 
-        job_id = jobs[0]["job_id"]["S"]
-        rule = get_eventbridge_rule(job_id)
-        assert rule is not None, f"EventBridge rule {job_id} not found"
-        assert rule["State"] == "ENABLED"
-        job_id = jobs[1]["job_id"]["S"]
-        rule = get_eventbridge_rule(job_id)
-        assert rule is not None, f"EventBridge rule {job_id} not found"
-        assert rule["State"] == "ENABLED"
+        for job in jobs[:2]:
+            assert is_queued(job), f"Job {job['job_id']['S']} is not queued"
 
         for job in jobs[:2]:
             delete_job(job["job_id"]["S"], TEST_GITHUB_EMAIL)
@@ -378,7 +361,7 @@ class TestFullFlow:
         """
         Full flow test:
         1. Schedule a job for 2 minutes in the future
-        2. Verify DynamoDB and EventBridge
+        2. Verify the job is queued in DynamoDB
         3. Wait for execution
         4. Verify CodeBuild succeeded
         5. Verify commit appeared in test repo
@@ -416,10 +399,9 @@ class TestFullFlow:
         print(f"Job ID: {job_id}")
         assert job["status"]["S"] == "pending", f"Expected pending, got {job['status']['S']}"
         
-        # Verify EventBridge rule
-        rule = get_eventbridge_rule(job_id)
-        assert rule is not None, f"EventBridge rule not found"
-        print(f"EventBridge rule state: {rule['State']}")
+        # Verify it waits for the dispatcher
+        assert is_queued(job), f"Job {job_id} is not queued"
+        print(f"Due bucket: {job['due_bucket']['S']}")
         
         # Poll for new commit with timeout (2 min schedule + up to 6 min for CodeBuild)
         max_wait = 480  # 8 minutes total
@@ -532,3 +514,33 @@ class TestJobOrdering:
         # Cleanup
         for job in jobs:
             delete_job(job["job_id"]["S"], TEST_GITHUB_EMAIL)
+
+
+class TestInvalidScheduleTime:
+    """Test that the backend refuses times it cannot read instead of running the job now."""
+
+    @pytest.mark.parametrize("schedule_time", ["not-a-time", "tomorrow", ""])
+    def test_malformed_schedule_time_rejected(self, schedule_time):
+        """A malformed or missing schedule_time is a 400 and no job item is written."""
+        if not API_GATEWAY_URL or not API_KEY:
+            pytest.skip("API_GATEWAY_URL and API_KEY are required")
+        before = {job["job_id"]["S"] for job in get_dynamodb_job(TEST_GITHUB_EMAIL)}
+
+        response = requests.post(
+            f"{API_GATEWAY_URL}/schedule",
+            headers={"x-api-key": API_KEY},
+            json={
+                "schedule_time": schedule_time,
+                "repo_url": "https://github.com/example/repo.git",
+                "zip_filename": "gits-changes.zip",
+                "zip_base64": "UEsFBgAAAAAAAAAAAAAAAAAAAAAAAA==",
+                "user_id": TEST_GITHUB_EMAIL,
+                "commit_message": "E2E test: malformed time",
+            },
+            timeout=30,
+        )
+
+        assert response.status_code == 400, response.text
+        assert response.json()["error"] == "Invalid schedule_time"
+        after = {job["job_id"]["S"] for job in get_dynamodb_job(TEST_GITHUB_EMAIL)}
+        assert after == before, "A job was queued for a malformed schedule_time"
@@ -0,0 +1,153 @@
+"""
+Batch scheduling tests for gits schedule --batch - these run the CLI against
+a local FakeApi server instead of API Gateway.
+
+Test cases covered:
+1. Jobs from several repositories go out in one /schedule/batch request,
+   with archives uploaded through pre-signed URLs
+2. Backend without the batch endpoint → one /schedule request per job
+3. A job the backend rejects is reported and the exit code is non-zero
+4. Invalid jobs file, or --batch combined with job options → error
+5. A job that fails to build leaves no archive of earlier jobs behind
+"""
+
+import base64
+import json
+import subprocess
+from conftest import run_gits, get_future_time, read_changeset
+
+
+def make_repo(path, remote):
+    path.mkdir()
+    for args in (["init", "-q"], ["config", "user.email", "test@test.com"], ["config", "user.name", "Test User"]):
+        subprocess.run(["git", *args], cwd=path, check=True, capture_output=True)
+    (path / "README.md").write_text("# Test Repo\n")
+    subprocess.run(["git", "add", "README.md"], cwd=path, check=True, capture_output=True)
+    subprocess.run(["git", "commit", "-q", "-m", "Initial commit"], cwd=path, check=True, capture_output=True)
+    subprocess.run(["git", "remote", "add", "origin", remote], cwd=path, check=True, capture_output=True)
+    return path
+
+
+def write_jobs(tmp_path, jobs):
+    jobs_file = tmp_path / "jobs.json"
+    jobs_file.write_text(json.dumps(jobs))
+    return str(jobs_file)
+
+
+def batch_results(body):
+    jobs = json.loads(body)["jobs"]
+    return [
+        {"index": i, "status": "scheduled", "rule_name": f"gits-1-{i + 1}", "cron_expression": "cron(0 12 1 1 ? 2099)"}
+        for i in range(len(jobs))
+    ]
+
+
+class TestBatchSchedule:
+
+    def test_one_request_for_all_jobs(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """Each job's archive is uploaded, then a single batch call schedules them all."""
+        other = make_repo(tmp_path / "other-repo", "https://github.com/test/other-repo.git")
+        (temp_git_repo / "app.py").write_text("print('first')\n")
+        (other / "lib.py").write_text("print('second')\n")
+
+        def upload_url(r):
+            name = json.loads(r["body"])["zip_filename"]
+            fake_api.routes[("PUT", f"/bucket/{name}")] = lambda r: (200, {})
+            return 200, {"upload_url": f"{fake_api.url}/bucket/{name}", "s3_key": f"changes-1/{name}"}
+
+        fake_api.routes[("POST", "/upload-url")] = upload_url
+        fake_api.routes[("POST", "/schedule/batch")] = lambda r: (200, {"results": batch_results(r["body"])})
+        jobs_file = write_jobs(tmp_path, [
+            {"schedule_time": get_future_time(60), "message": "First"},
+            {"schedule_time": get_future_time(120), "message": "Second", "repo": str(other)},
+        ])
+
+        result = run_gits(gits_binary, ["schedule", "--batch", jobs_file], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert "Successfully scheduled 2 of 2 jobs" in result.stdout
+        assert not [r for r in fake_api.requests if r["path"] == "/schedule"]
+
+        batch = [r for r in fake_api.requests if r["path"] == "/schedule/batch"]
+        assert len(batch) == 1
+        body = json.loads(batch[0]["body"])
+        assert body["user_id"] == "test@example.com"
+        first, second = body["jobs"]
+        assert "user_id" not in first
+        assert first["repo_url"] == "https://github.com/test/test-repo.git"
+        assert second["repo_url"] == "https://github.com/test/other-repo.git"
+        assert first["commit_message"] == "First"
+        assert "zip_base64" not in first and "zip_base64" not in second
+
+        uploads = {r["path"].rsplit("/", 1)[1]: read_changeset(r["body"]) for r in fake_api.requests if r["method"] == "PUT"}
+        assert uploads[first["s3_key"].split("/", 1)[1]]["app.py"] == b"print('first')\n"
+        assert uploads[second["s3_key"].split("/", 1)[1]]["lib.py"] == b"print('second')\n"
+
+    def test_falls_back_to_single_schedule(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """Older deployments without /schedule/batch get one /schedule call per job."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled", "rule_name": "gits-1"})
+        (temp_git_repo / "app.py").write_text("print('hello')\n")
+        jobs_file = write_jobs(tmp_path, [
+            {"schedule_time": get_future_time(60)},
+            {"schedule_time": get_future_time(120), "files": ["app.py"]},
+        ])
+
+        result = run_gits(gits_binary, ["schedule", "--batch", jobs_file], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        singles = [json.loads(r["body"]) for r in fake_api.requests if r["path"] == "/schedule"]
+        assert len(singles) == 2
+        assert singles[0]["user_id"] == "test@example.com"
+        assert set(read_changeset(base64.b64decode(singles[1]["zip_base64"]))) >= {"app.py"}
+        assert "README.md" not in read_changeset(base64.b64decode(singles[1]["zip_base64"]))
+
+    def test_failed_job_reported(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """Per-job failures are printed and make the command fail."""
+        def partial(r):
+            results = batch_results(r["body"])
+            results[1] = {"index": 1, "status": "failed", "error": "Failed to create EventBridge rule: limit"}
+            return 200, {"results": results}
+
+        fake_api.routes[("POST", "/schedule/batch")] = partial
+        (temp_git_repo / "app.py").write_text("print('hello')\n")
+        jobs_file = write_jobs(tmp_path, [{"schedule_time": get_future_time(60)}, {"schedule_time": get_future_time(120)}])
+
+        result = run_gits(gits_binary, ["schedule", "--batch", jobs_file], cwd=temp_git_repo)
+        assert result.returncode == 1
+        assert "Job 2: Failed: Failed to create EventBridge rule: limit" in result.stderr
+        assert "Successfully scheduled 1 of 2 jobs" in result.stdout
+
+    def test_failed_job_leaves_no_archives(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """Archives already built are removed when a later job throws."""
+        (temp_git_repo / "app.py").write_text("print('hello')\n")
+        not_a_repo = tmp_path / "not-a-repo"
+        not_a_repo.mkdir()
+        temp_dir = tmp_path / "tmp"
+        temp_dir.mkdir()
+        jobs_file = write_jobs(tmp_path, [
+            {"schedule_time": get_future_time(60)},
+            {"schedule_time": get_future_time(120), "repo": str(not_a_repo)},
+        ])
+
+        result = run_gits(gits_binary, ["schedule", "--batch", jobs_file], cwd=temp_git_repo, env={"TMPDIR": str(temp_dir)})
+        assert result.returncode == 1
+        assert "Job 2: not a Git repository" in result.stderr
+        assert not list(temp_dir.iterdir())
+
+    def test_invalid_jobs_file(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """Bad jobs are rejected before anything is uploaded."""
+        jobs_file = write_jobs(tmp_path, [{"schedule_time": get_future_time(60), "mode": "tar"}])
+        result = run_gits(gits_binary, ["schedule", "--batch", jobs_file], cwd=temp_git_repo)
+        assert result.returncode == 1
+        assert "Job 1: mode must be zip or bundle" in result.stderr
+
+        jobs_file = write_jobs(tmp_path, {"schedule_time": get_future_time(60)})
+        result = run_gits(gits_binary, ["schedule", "--batch", jobs_file], cwd=temp_git_repo)
+        assert result.returncode == 1
+        assert "must be an array" in result.stderr
+        assert not fake_api.requests
+
+    def test_batch_excludes_job_options(self, gits_binary, temp_git_repo, tmp_path):
+        """--batch takes every job option from the file."""
+        jobs_file = write_jobs(tmp_path, [{"schedule_time": get_future_time(60)}])
+        result = run_gits(gits_binary, ["schedule", "--batch", jobs_file, "--message", "x"], cwd=temp_git_repo)
+        assert result.returncode == 2
+        assert "--batch takes every job option from the jobs file" in result.stderr
@@ -0,0 +1,106 @@
+"""
+Bundle mode tests for gits schedule --mode bundle - the bundle is captured
+from a local FakeApi server and applied to a clone the way CodeBuild does.
+
+Test cases covered:
+1. The local commit (edits, new files, deletions) arrives unchanged and the
+   user's branch and index are left alone
+2. The bundle is thin: a small edit to a large file ships only a delta
+3. Invalid --mode → error
+"""
+
+import base64
+import json
+import os
+import re
+import subprocess
+from conftest import run_gits, get_future_time
+
+
+def git(cwd, *args):
+    return subprocess.run(["git", *args], cwd=cwd, check=True, capture_output=True, text=True).stdout.strip()
+
+
+def mark_pushed(repo):
+    """Pretend HEAD has been pushed, so origin/main exists locally."""
+    git(repo, "update-ref", "refs/remotes/origin/main", "HEAD")
+
+
+def schedule_bundle(gits_binary, repo, fake_api, message="Bundle commit"):
+    fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+    result = run_gits(
+        gits_binary,
+        ["schedule", "--schedule_time", get_future_time(60), "--mode", "bundle", "--message", message],
+        cwd=repo,
+    )
+    assert result.returncode == 0, result.stderr
+    payload = json.loads(next(r["body"] for r in fake_api.requests if r["path"] == "/schedule"))
+    assert payload["format"] == "bundle"
+    assert payload["zip_filename"].endswith(".bundle")
+    return result.stdout, base64.b64decode(payload["zip_base64"])
+
+
+def apply_bundle(tmp_path, repo, data):
+    """Clone the 'remote' state and apply the bundle like the buildspec."""
+    clone = tmp_path / "build"
+    git(tmp_path, "clone", "-q", str(repo), str(clone))
+    git(clone, "reset", "-q", "--hard", "origin/HEAD")
+    (clone / "changes.bundle").write_bytes(data)
+    git(clone, "bundle", "verify", "-q", "changes.bundle")
+    git(clone, "fetch", "-q", "changes.bundle", "refs/gits/changes")
+    os.remove(clone / "changes.bundle")
+    git(clone, "merge", "-q", "--ff-only", "FETCH_HEAD")
+    return clone
+
+
+class TestBundleMode:
+
+    def test_local_commit_shipped_exactly(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """Edits, new files and deletions arrive as the commit made locally."""
+        (temp_git_repo / "old.txt").write_text("remove me\n")
+        git(temp_git_repo, "add", "old.txt")
+        git(temp_git_repo, "commit", "-q", "-m", "Add old.txt")
+        mark_pushed(temp_git_repo)
+        head_before = git(temp_git_repo, "rev-parse", "HEAD")
+
+        (temp_git_repo / "README.md").write_text("# Changed\n")
+        (temp_git_repo / "new.py").write_text("print('new')\n")
+        os.remove(temp_git_repo / "old.txt")
+
+        stdout, data = schedule_bundle(gits_binary, temp_git_repo, fake_api)
+        commit = re.search(r"Bundled commit ([0-9a-f]+)", stdout).group(1)
+
+        # The user's branch and index are untouched
+        assert git(temp_git_repo, "rev-parse", "HEAD") == head_before
+        assert git(temp_git_repo, "diff", "--cached", "--name-only") == ""
+
+        clone = apply_bundle(tmp_path, temp_git_repo, data)
+        assert git(clone, "rev-parse", "HEAD").startswith(commit)
+        assert git(clone, "log", "-1", "--format=%s") == "Bundle commit"
+        assert (clone / "README.md").read_text() == "# Changed\n"
+        assert (clone / "new.py").read_text() == "print('new')\n"
+        assert not (clone / "old.txt").exists()
+
+    def test_small_edit_to_large_file_is_small(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """Only objects the remote lacks are bundled, deltified by git."""
+        lines = [f"line {i}: {os.urandom(24).hex()}\n" for i in range(40000)]
+        (temp_git_repo / "data.txt").write_text("".join(lines))
+        git(temp_git_repo, "add", "data.txt")
+        git(temp_git_repo, "commit", "-q", "-m", "Add data")
+        mark_pushed(temp_git_repo)
+
+        lines[20000] = "edited\n"
+        (temp_git_repo / "data.txt").write_text("".join(lines))
+
+        _, data = schedule_bundle(gits_binary, temp_git_repo, fake_api)
+        size = os.path.getsize(temp_git_repo / "data.txt")
+        assert len(data) * 100 < size
+
+        clone = apply_bundle(tmp_path, temp_git_repo, data)
+        assert (clone / "data.txt").read_text() == "".join(lines)
+
+    def test_invalid_mode(self, gits_binary, temp_git_repo):
+        """Unknown --mode values are rejected."""
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60), "--mode", "tar"], cwd=temp_git_repo)
+        assert result.returncode == 2
+        assert "--mode must be zip or bundle" in result.stderr
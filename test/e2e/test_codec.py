@@ -0,0 +1,100 @@
+"""
+Codec policy tests for gits schedule - the zip is captured from a local
+FakeApi server and unpacked with the CodeBuild extractor.
+
+Test cases covered:
+1. Already-compressed files are stored, text is compressed, and the
+   extractor restores both
+2. ZIP_CODEC=deflate keeps every entry readable by plain unzip
+3. ZIP_CODEC=store disables compression
+4. Invalid ZIP_CODEC → error
+5. base64_check: every base64 implementation the CPU supports against
+   OpenSSL, in place, and on bad padding and invalid characters
+"""
+
+import base64
+import io
+import json
+import os
+import subprocess
+import sys
+import zipfile
+from pathlib import Path
+import pytest
+from conftest import run_gits, get_future_time
+
+
+EXTRACTOR = Path(__file__).resolve().parents[2] / "codebuild" / "extract_changes.py"
+STORED, DEFLATED, ZSTD = 0, 8, 93
+
+PNG = b"\x89PNG\r\n\x1a\n" + os.urandom(4096)
+SOURCE = "".join(f"def handler_{i}(event):\n    return event['{i}']\n" for i in range(200))
+
+
+def schedule_archive(gits_binary, repo, fake_api, config, extra=""):
+    if extra:
+        with open(config, "a") as f:
+            f.write(extra)
+    fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+    (repo / "logo.png").write_bytes(PNG)
+    (repo / "handlers.py").write_text(SOURCE)
+    result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=repo)
+    assert result.returncode == 0, result.stderr
+    body = json.loads(next(r["body"] for r in fake_api.requests if r["path"] == "/schedule"))
+    return base64.b64decode(body["zip_base64"])
+
+
+def methods(data):
+    return {i.filename: i.compress_type for i in zipfile.ZipFile(io.BytesIO(data)).infolist()}
+
+
+class TestCodecPolicy:
+
+    def test_compressed_files_stored_text_compressed(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """PNG is stored as-is, source is zstd (or deflate without zstd)."""
+        data = schedule_archive(gits_binary, temp_git_repo, fake_api, api_gits_config)
+        m = methods(data)
+        assert m["logo.png"] == STORED
+        assert m["handlers.py"] in (DEFLATED, ZSTD)
+
+        (tmp_path / "changes.zip").write_bytes(data)
+        out = tmp_path / "out"
+        out.mkdir()
+        subprocess.run([sys.executable, str(EXTRACTOR), str(tmp_path / "changes.zip")], cwd=out, check=True)
+        assert (out / "logo.png").read_bytes() == PNG
+        assert (out / "handlers.py").read_text() == SOURCE
+
+    def test_deflate_codec(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """ZIP_CODEC=deflate never uses zstd."""
+        data = schedule_archive(gits_binary, temp_git_repo, fake_api, api_gits_config, "ZIP_CODEC=deflate\n")
+        m = methods(data)
+        assert m["handlers.py"] == DEFLATED
+        assert ZSTD not in m.values()
+        assert zipfile.ZipFile(io.BytesIO(data)).testzip() is None
+
+    def test_store_codec(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """ZIP_CODEC=store writes every entry uncompressed."""
+        data = schedule_archive(gits_binary, temp_git_repo, fake_api, api_gits_config, "ZIP_CODEC=store\n")
+        assert set(methods(data).values()) == {STORED}
+
+    def test_invalid_codec(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """Unknown ZIP_CODEC values are rejected."""
+        with open(api_gits_config, "a") as f:
+            f.write("ZIP_CODEC=brotli\n")
+        (temp_git_repo / "app.py").write_text("print('hello')\n")
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode != 0
+        assert "ZIP_CODEC must be" in result.stderr
+
+
+class TestBase64:
+
+    def test_implementations_match_openssl(self, gits_binary):
+        """base64_check (built next to gits) passes for two seeds."""
+        check = Path(gits_binary).with_name("base64_check")
+        if not check.exists():
+            pytest.skip(f"base64_check not found at {check}")
+        for seed in ("1", str(int.from_bytes(os.urandom(4), "little"))):
+            result = subprocess.run([str(check), seed], capture_output=True, text=True)
+            assert result.returncode == 0, result.stderr
+            assert "scalar   ok" in result.stdout
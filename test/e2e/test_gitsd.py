@@ -0,0 +1,167 @@
+"""
+gitsd tests - the daemon is started next to a FakeApi server with its own
+HOME, and gits hands schedules to it over the Unix socket.
+
+Test cases covered:
+1. gits schedule is answered by a running gitsd instead of scanning itself
+2. Edits, new, deleted and staged files made between schedules are tracked,
+   and a file created and removed again is not shipped
+3. Ignored directories are not watched until .gitignore stops ignoring them
+4. Errors such as "No changes found." come back from the daemon unchanged
+5. No daemon (or a socket left by a dead one) and GITSD=0 schedule in-process
+"""
+
+import base64
+import json
+import os
+import signal
+import subprocess
+import time
+import pytest
+from conftest import run_gits, get_future_time, read_changeset
+
+
+@pytest.fixture
+def gitsd(gits_binary, api_gits_config, fake_api, tmp_path):
+    """Start gitsd from the build directory of gits, with HOME=tmp_path."""
+    binary = os.path.join(os.path.dirname(gits_binary), "gitsd")
+    if not os.path.exists(binary):
+        pytest.skip(f"gitsd not found at {binary}")
+    fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+    socket_path = tmp_path / ".gits" / "gitsd.sock"
+    proc = subprocess.Popen([binary], stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    for _ in range(100):
+        if socket_path.exists() or proc.poll() is not None:
+            break
+        time.sleep(0.05)
+    assert socket_path.exists(), proc.stderr.read() if proc.poll() is not None else "no socket"
+    yield proc
+    proc.send_signal(signal.SIGTERM)
+    proc.wait(timeout=10)
+    assert not socket_path.exists()
+
+
+def schedule(gits_binary, repo, tmp_path, env=None):
+    """Run gits schedule with a trace; return (result, trace phase names)."""
+    trace_file = tmp_path / "trace.json"
+    result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60), "--trace", str(trace_file)],
+                      cwd=repo, env=env)
+    events = json.loads(trace_file.read_text())["traceEvents"] if trace_file.exists() else []
+    trace_file.unlink(missing_ok=True)
+    return result, {e["name"] for e in events if e.get("ph") == "X" and e.get("cat") == "phase"}
+
+
+def last_changeset(api):
+    body = json.loads([r for r in api.requests if r["path"] == "/schedule"][-1]["body"])
+    archive = read_changeset(base64.b64decode(body["zip_base64"]))
+    manifest = archive.pop(next(n for n in archive if n.startswith(".gits-manifest-")), None)
+    deleted = json.loads(manifest)["deleted"] if manifest else []
+    return archive, sorted(deleted)
+
+
+class TestGitsd:
+
+    def test_schedule_handed_to_daemon(self, gits_binary, temp_git_repo, fake_api, gitsd, tmp_path):
+        """The CLI only talks to gitsd; the scan and upload happen there."""
+        (temp_git_repo / "app.py").write_text("print('hello')\n")
+        result, phases = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        assert "Successfully scheduled" in result.stdout
+        assert "gitsd" in phases
+        assert "git status" not in phases
+        archive, _ = last_changeset(fake_api)
+        assert archive == {"app.py": b"print('hello')\n"}
+
+    def test_changes_between_schedules_tracked(self, gits_binary, temp_git_repo, fake_api, gitsd, tmp_path):
+        """Each schedule sees exactly the work tree as it is at that moment."""
+        (temp_git_repo / "keep.txt").write_text("keep\n")
+        (temp_git_repo / "gone.txt").write_text("delete me\n")
+        subprocess.run(["git", "add", "."], cwd=temp_git_repo, check=True)
+        subprocess.run(["git", "commit", "-q", "-m", "Add files"], cwd=temp_git_repo, check=True)
+
+        (temp_git_repo / "README.md").write_text("# First\n")
+        result, _ = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        assert last_changeset(fake_api) == ({"README.md": b"# First\n"}, [])
+
+        # Written after the daemon's first scan: only these paths are rechecked
+        (temp_git_repo / "README.md").write_text("# Test Repo\n")
+        (temp_git_repo / "keep.txt").write_text("kept\n")
+        (temp_git_repo / "new.py").write_text("print('new')\n")
+        (temp_git_repo / "scratch.txt").write_text("temporary\n")
+        os.remove(temp_git_repo / "scratch.txt")
+        os.remove(temp_git_repo / "gone.txt")
+        (temp_git_repo / "src").mkdir()
+        (temp_git_repo / "src" / "lib.py").write_text("x = 1\n")
+        result, _ = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        assert last_changeset(fake_api) == ({"keep.txt": b"kept\n", "new.py": b"print('new')\n",
+                                             "src/lib.py": b"x = 1\n"}, ["gone.txt"])
+
+        # Staging and committing move the index and HEAD
+        subprocess.run(["git", "add", "new.py"], cwd=temp_git_repo, check=True)
+        subprocess.run(["git", "commit", "-q", "-m", "Add new.py", "--", "new.py"], cwd=temp_git_repo, check=True)
+        (temp_git_repo / "src" / "lib.py").write_text("x = 2\n")
+        result, _ = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        assert last_changeset(fake_api) == ({"keep.txt": b"kept\n", "src/lib.py": b"x = 2\n"}, ["gone.txt"])
+
+    def test_ignored_directories_not_watched(self, gits_binary, temp_git_repo, fake_api, gitsd, tmp_path):
+        """Ignored directories are skipped, and watched once .gitignore stops ignoring them."""
+        (temp_git_repo / ".gitignore").write_text("build/\n")
+        subprocess.run(["git", "add", ".gitignore"], cwd=temp_git_repo, check=True)
+        subprocess.run(["git", "commit", "-q", "-m", "Ignore build"], cwd=temp_git_repo, check=True)
+        (temp_git_repo / "build" / "obj").mkdir(parents=True)
+
+        (temp_git_repo / "app.py").write_text("print('hello')\n")
+        result, _ = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        (temp_git_repo / "build" / "obj" / "a.o").write_text("object\n")
+        result, _ = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        assert last_changeset(fake_api) == ({"app.py": b"print('hello')\n"}, [])
+
+        # No longer ignored: the directory is watched from the next schedule on
+        (temp_git_repo / ".gitignore").write_text("")
+        result, _ = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        (temp_git_repo / "build" / "obj" / "b.o").write_text("more\n")
+        result, _ = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        archive, _ = last_changeset(fake_api)
+        assert sorted(archive) == [".gitignore", "app.py", "build/obj/a.o", "build/obj/b.o"]
+
+    def test_errors_forwarded(self, gits_binary, temp_git_repo, fake_api, gitsd, tmp_path):
+        """Failures print the same way as without the daemon."""
+        result, _ = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 1
+        assert "No changes found." in result.stderr
+
+        (temp_git_repo / "app.py").write_text("print('hello')\n")
+        fake_api.routes[("POST", "/schedule")] = lambda r: (400, {"error": "schedule_time is in the past"})
+        result, _ = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 1
+        assert "schedule_time is in the past" in result.stderr
+
+
+class TestFallback:
+
+    def test_no_daemon_schedules_in_process(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """A socket nobody listens on is ignored."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        (tmp_path / ".gits" / "gitsd.sock").write_text("")
+        (temp_git_repo / "app.py").write_text("print('hello')\n")
+        result, phases = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        assert "git status" in phases
+        assert last_changeset(fake_api)[0] == {"app.py": b"print('hello')\n"}
+
+    def test_gitsd_disabled(self, gits_binary, temp_git_repo, fake_api, gitsd, api_gits_config, tmp_path):
+        """GITSD=0 in the config skips a running daemon."""
+        with open(api_gits_config, "a") as f:
+            f.write("GITSD=0\n")
+        (temp_git_repo / "app.py").write_text("print('hello')\n")
+        result, phases = schedule(gits_binary, temp_git_repo, tmp_path)
+        assert result.returncode == 0, result.stderr
+        assert "gitsd" not in phases
+        assert "git status" in phases
@@ -0,0 +1,163 @@
+"""
+libgits tests - these load the shared library with ctypes and call the C API
+against a local FakeApi server. They need a build with -DBUILD_SHARED_LIBS=ON
+and GITS_LIBRARY pointing at libgits.so; without it they are skipped.
+
+Test cases covered:
+1. gits_schedule returns the job ID and cron expression from the backend,
+   working inside repo_path without changing the caller's directory
+2. Failures come back as error codes with a message: not a repository,
+   nothing to schedule, a past time
+3. gits_status and gits_list_jobs return jobs as structs
+4. gits_delete reports the backend's error status as GITS_ERR_HTTP
+"""
+
+import ctypes
+import json
+import os
+import pytest
+from conftest import get_future_time
+
+GITS_OK = 0
+GITS_ERR_INVALID = 1
+GITS_ERR_REPO = 3
+GITS_ERR_NO_CHANGES = 4
+GITS_ERR_HTTP = 6
+
+
+class ScheduleOptions(ctypes.Structure):
+    _fields_ = [
+        ("repo_path", ctypes.c_char_p),
+        ("schedule_time", ctypes.c_char_p),
+        ("message", ctypes.c_char_p),
+        ("files", ctypes.POINTER(ctypes.c_char_p)),
+        ("mode", ctypes.c_char_p),
+    ]
+
+
+class ScheduleResult(ctypes.Structure):
+    _fields_ = [
+        ("job_id", ctypes.c_char_p),
+        ("schedule_time", ctypes.c_char_p),
+        ("cron_expression", ctypes.c_char_p),
+        ("duplicate", ctypes.c_int),
+    ]
+
+
+class Job(ctypes.Structure):
+    _fields_ = [
+        ("job_id", ctypes.c_char_p),
+        ("schedule_time", ctypes.c_char_p),
+        ("status", ctypes.c_char_p),
+        ("json", ctypes.c_char_p),
+    ]
+
+
+class JobList(ctypes.Structure):
+    _fields_ = [("jobs", ctypes.POINTER(Job)), ("count", ctypes.c_size_t)]
+
+
+class ListOptions(ctypes.Structure):
+    _fields_ = [("status", ctypes.c_char_p), ("since", ctypes.c_char_p), ("until", ctypes.c_char_p)]
+
+
+@pytest.fixture(scope="session")
+def libgits():
+    path = os.environ.get("GITS_LIBRARY")
+    if not path or not os.path.exists(path):
+        pytest.skip("GITS_LIBRARY not set to a shared libgits build")
+    lib = ctypes.CDLL(path)
+    lib.gits_client_new.restype = ctypes.c_void_p
+    lib.gits_client_new.argtypes = [ctypes.c_char_p]
+    lib.gits_client_free.argtypes = [ctypes.c_void_p]
+    lib.gits_schedule.argtypes = [ctypes.c_void_p, ctypes.POINTER(ScheduleOptions), ctypes.POINTER(ScheduleResult)]
+    lib.gits_schedule_result_free.argtypes = [ctypes.POINTER(ScheduleResult)]
+    lib.gits_status.argtypes = [ctypes.c_void_p, ctypes.POINTER(Job)]
+    lib.gits_job_free.argtypes = [ctypes.POINTER(Job)]
+    lib.gits_list_jobs.argtypes = [ctypes.c_void_p, ctypes.POINTER(ListOptions), ctypes.POINTER(JobList)]
+    lib.gits_job_list_free.argtypes = [ctypes.POINTER(JobList)]
+    lib.gits_delete.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    lib.gits_last_error.restype = ctypes.c_char_p
+    return lib
+
+
+@pytest.fixture
+def client(libgits, api_gits_config):
+    handle = libgits.gits_client_new(str(api_gits_config).encode())
+    assert handle, libgits.gits_last_error()
+    yield handle
+    libgits.gits_client_free(handle)
+
+
+def schedule(libgits, client, repo, when=None):
+    options = ScheduleOptions(repo_path=str(repo).encode(), schedule_time=(when or get_future_time(60)).encode())
+    result = ScheduleResult()
+    code = libgits.gits_schedule(client, ctypes.byref(options), ctypes.byref(result))
+    return code, result
+
+
+class TestSchedule:
+
+    def test_schedule_returns_job(self, libgits, client, temp_git_repo, fake_api):
+        """The backend's job id and cron expression come back in the result."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled", "job_id": "gits-7", "rule_name": "gits-7", "cron_expression": "cron(0 12 1 1 ? 2099)"})
+        (temp_git_repo / "app.py").write_text("print('hi')\n")
+        cwd = os.getcwd()
+
+        code, result = schedule(libgits, client, temp_git_repo)
+        assert code == GITS_OK, libgits.gits_last_error()
+        assert result.job_id == b"gits-7"
+        assert result.cron_expression == b"cron(0 12 1 1 ? 2099)"
+        assert result.schedule_time.endswith(b"Z")
+        assert result.duplicate == 0
+        assert os.getcwd() == cwd
+        payload = json.loads([r for r in fake_api.requests if r["path"] == "/schedule"][0]["body"])
+        assert payload["repo_url"] == "https://github.com/test/test-repo.git"
+        libgits.gits_schedule_result_free(ctypes.byref(result))
+        assert result.job_id is None
+
+    def test_errors_are_codes(self, libgits, client, temp_git_repo, temp_non_git_dir, fake_api):
+        """Failures return a code and a message instead of exiting."""
+        code, _ = schedule(libgits, client, temp_non_git_dir)
+        assert code == GITS_ERR_REPO
+        assert b"Must be run inside a Git repository." in libgits.gits_last_error()
+
+        code, _ = schedule(libgits, client, temp_git_repo)
+        assert code == GITS_ERR_NO_CHANGES
+
+        (temp_git_repo / "app.py").write_text("print('hi')\n")
+        code, _ = schedule(libgits, client, temp_git_repo, when="2000-01-01T00:00")
+        assert code == GITS_ERR_INVALID
+        assert libgits.gits_last_error() == b"Schedule time must be in the future."
+        assert fake_api.requests == []
+
+
+class TestJobs:
+
+    def test_status_and_list(self, libgits, client, fake_api):
+        """The latest job and every job come back as structs."""
+        job = {"job_id": "gits-1", "schedule_time": "2099-01-01T12:00:00Z", "status": "pending"}
+        fake_api.routes[("GET", "/status")] = lambda r: (
+            (200, {"jobs": [job, {**job, "job_id": "gits-0", "status": "SUCCEEDED"}]}) if "all=1" in r["query"] else (200, job)
+        )
+
+        latest = Job()
+        assert libgits.gits_status(client, ctypes.byref(latest)) == GITS_OK, libgits.gits_last_error()
+        assert (latest.job_id, latest.status) == (b"gits-1", b"pending")
+        assert json.loads(latest.json) == job
+        libgits.gits_job_free(ctypes.byref(latest))
+
+        jobs = JobList()
+        options = ListOptions(status=b"pending")
+        assert libgits.gits_list_jobs(client, ctypes.byref(options), ctypes.byref(jobs)) == GITS_OK, libgits.gits_last_error()
+        assert [(jobs.jobs[i].job_id, jobs.jobs[i].status) for i in range(jobs.count)] == [(b"gits-1", b"pending"), (b"gits-0", b"SUCCEEDED")]
+        assert "status=pending" in fake_api.requests[-1]["query"]
+        libgits.gits_job_list_free(ctypes.byref(jobs))
+
+    def test_delete_error(self, libgits, client, fake_api):
+        """A rejected delete returns GITS_ERR_HTTP with the backend's answer."""
+        fake_api.routes[("POST", "/delete")] = lambda r: (400, {"error": "no such job"})
+
+        assert libgits.gits_delete(client, b"gits-9") == GITS_ERR_HTTP
+        assert b"no such job" in libgits.gits_last_error()
+        assert json.loads(fake_api.requests[0]["body"]) == {"job_id": "gits-9", "user_id": "test@example.com"}
@@ -0,0 +1,153 @@
+"""
+Status tests for gits status - these run the CLI against a local FakeApi
+server instead of API Gateway.
+
+Test cases covered:
+1. The ETag of an answer is sent back as If-None-Match and a 304 reuses the
+   cached answer
+2. Within max-age the cached answer is printed without a request
+3. A changed job replaces the cached answer
+4. --watch long-polls with the last ETag and prints one line per change
+   until the job reaches a final status
+5. --all follows the cursor page by page, prints NDJSON and passes the
+   status and time filters
+"""
+
+import json
+import time
+from urllib.parse import parse_qs
+from conftest import run_gits
+
+
+JOB = {"job_id": "gits-1", "schedule_time": "2099-01-01T12:00:00", "status": "pending"}
+
+
+def status_route(fake_api, job, etag, max_age=0):
+    def answer(r):
+        if r["headers"].get("If-None-Match") == etag:
+            return 304, {}, {"ETag": etag, "Cache-Control": f"private, max-age={max_age}"}
+        return 200, job, {"ETag": etag, "Cache-Control": f"private, max-age={max_age}"}
+    fake_api.routes[("GET", "/status")] = answer
+
+
+class TestStatusCache:
+
+    def test_not_modified_reuses_cached_answer(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """The second call revalidates with If-None-Match and prints the cached job."""
+        status_route(fake_api, JOB, '"1-v1"')
+
+        first = run_gits(gits_binary, ["status"], cwd=temp_git_repo)
+        second = run_gits(gits_binary, ["status"], cwd=temp_git_repo)
+        assert first.returncode == 0, first.stderr
+        assert second.returncode == 0, second.stderr
+        assert second.stdout == first.stdout
+        assert "Status: pending" in second.stdout
+        assert [r["headers"].get("If-None-Match") for r in fake_api.requests] == [None, '"1-v1"']
+
+    def test_fresh_answer_needs_no_request(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """Within max-age the answer comes from ~/.gits/status-cache."""
+        status_route(fake_api, JOB, '"1-v1"', max_age=30)
+
+        for _ in range(3):
+            result = run_gits(gits_binary, ["status"], cwd=temp_git_repo)
+            assert result.returncode == 0, result.stderr
+            assert "Job ID: gits-1" in result.stdout
+        assert len(fake_api.requests) == 1
+
+        with open(api_gits_config, "a") as f:
+            f.write("STATUS_MAX_AGE=0\n")
+        result = run_gits(gits_binary, ["status"], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert len(fake_api.requests) == 2
+
+    def test_changed_job_replaces_cache(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """A new ETag brings the new status."""
+        status_route(fake_api, JOB, '"1-v1"')
+        run_gits(gits_binary, ["status"], cwd=temp_git_repo)
+
+        status_route(fake_api, {**JOB, "status": "SUCCEEDED"}, '"1-v2"')
+        result = run_gits(gits_binary, ["status"], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert "Status: SUCCEEDED" in result.stdout
+        cache = json.loads((tmp_path / ".gits" / "status-cache").read_text())
+        assert cache["etag"] == '"1-v2"'
+        assert cache["fetched_at"] <= time.time()
+
+
+class TestStatusWatch:
+
+    def test_streams_changes_until_final(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """One line per change; unchanged polls print nothing; SUCCEEDED ends the watch."""
+        answers = [
+            (200, JOB, {"ETag": '"1-v1"'}),
+            (304, {}, {"ETag": '"1-v1"'}),
+            (200, {**JOB, "status": "IN_PROGRESS"}, {"ETag": '"1-v2"'}),
+            (200, {**JOB, "status": "SUCCEEDED"}, {"ETag": '"1-v3"'}),
+        ]
+        fake_api.routes[("GET", "/status")] = lambda r: answers.pop(0)
+
+        result = run_gits(gits_binary, ["status", "--watch"], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        events = [line.split(" ", 1)[1] for line in result.stdout.splitlines()]
+        assert events == ["gits-1 pending", "gits-1 IN_PROGRESS", "gits-1 SUCCEEDED"]
+        assert [r["headers"].get("If-None-Match") for r in fake_api.requests] == [None, '"1-v1"', '"1-v1"', '"1-v2"']
+        assert all("wait=20" in r["query"] for r in fake_api.requests)
+
+    def test_failed_build_exits_non_zero(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """A job that ends in FAILED makes the watch fail."""
+        fake_api.routes[("GET", "/status")] = lambda r: (200, {**JOB, "status": "FAILED"}, {"ETag": '"1-v2"'})
+
+        result = run_gits(gits_binary, ["status", "--watch"], cwd=temp_git_repo)
+        assert result.returncode == 1
+        assert result.stdout.strip().endswith("gits-1 FAILED")
+
+    def test_invalid_option(self, gits_binary, temp_git_repo, gits_config):
+        """Unknown status options are rejected."""
+        result = run_gits(gits_binary, ["status", "--follow"], cwd=temp_git_repo)
+        assert result.returncode == 2
+        assert "unknown status option: --follow" in result.stderr
+
+
+class TestStatusList:
+
+    def test_pages_streamed_as_ndjson(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """Every page is requested with the previous cursor and each job is one JSON line."""
+        pages = {
+            "": {"jobs": [{**JOB, "job_id": "gits-3", "added_at": "3"}, {**JOB, "job_id": "gits-2", "added_at": "2"}], "next_cursor": "2"},
+            "2": {"jobs": [], "next_cursor": "1.5"},
+            "1.5": {"jobs": [{**JOB, "job_id": "gits-1", "added_at": "1"}]},
+        }
+        fake_api.routes[("GET", "/status")] = lambda r: (200, pages[parse_qs(r["query"]).get("cursor", [""])[0]])
+
+        result = run_gits(gits_binary, ["status", "--all"], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        jobs = [json.loads(line) for line in result.stdout.splitlines()]
+        assert [job["job_id"] for job in jobs] == ["gits-3", "gits-2", "gits-1"]
+        assert len(fake_api.requests) == 3
+        assert all(parse_qs(r["query"])["all"] == ["1"] for r in fake_api.requests)
+
+    def test_filters_sent(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """--status is passed through; --since and --until go out as UTC like schedule_time."""
+        fake_api.routes[("GET", "/status")] = lambda r: (200, {"jobs": []})
+
+        result = run_gits(
+            gits_binary,
+            ["status", "--all", "--status", "pending", "--since", "2099-01-01T00:00", "--until", "2099-02-01T00:00"],
+            cwd=temp_git_repo,
+        )
+        assert result.returncode == 0, result.stderr
+        query = parse_qs(fake_api.requests[0]["query"])
+        assert query["status"] == ["pending"]
+        assert query["since"][0].startswith("20") and query["since"][0].endswith(":00:00Z")
+        assert query["since"][0] < query["until"][0]
+
+    def test_invalid_list_options(self, gits_binary, temp_git_repo, gits_config):
+        """Filters need --all, and --all cannot be watched."""
+        result = run_gits(gits_binary, ["status", "--status", "pending"], cwd=temp_git_repo)
+        assert result.returncode == 2
+        assert "need --all" in result.stderr
+        result = run_gits(gits_binary, ["status", "--all", "--watch"], cwd=temp_git_repo)
+        assert result.returncode == 2
+        result = run_gits(gits_binary, ["status", "--all", "--since", "yesterday"], cwd=temp_git_repo)
+        assert result.returncode == 1
+        assert "Time must be in format" in result.stderr
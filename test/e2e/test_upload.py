@@ -0,0 +1,528 @@
+"""
+Upload path tests for gits schedule - these run the CLI against a local
+FakeApi server instead of API Gateway.
+
+Test cases covered:
+1. Pre-signed upload: raw zip is PUT to the returned URL, schedule request
+   only references the object key
+2. Backend without the upload-url endpoint → inline base64 fallback
+3. Pre-signed upload against a real S3-compatible store (MinIO), enabled
+   by setting S3_ENDPOINT
+4. Large files are shipped by SHA-256 and only missing blobs are uploaded
+5. Paths git would quote (spaces, " -> ", non-ASCII) and renames are
+   detected correctly
+6. Requests of one command share a connection, NETWORK_TIMING reports
+   them, and a stale cached DNS address is replaced
+7. Schedule requests carry a stable idempotency key and transient failures
+   are retried with it until RETRY_DEADLINE
+8. Archives from MULTIPART_MIN_SIZE up go to S3 in parallel parts, and an
+   interrupted upload resumes with only the missing parts
+9. --trace writes a Chrome trace of each step with an HTTP breakdown, and
+   --trace-summary prints the totals to stderr
+10. SCHEDULE_ENCODING=multipart sends inline archives raw in a
+    multipart/form-data body, streamed or buffered, zip or bundle
+11. With STATUS_THREADS > 1, deleted top-level files and directories are
+    still reported
+"""
+
+import base64
+import email.parser
+import email.policy
+import hashlib
+import json
+import os
+import shutil
+import subprocess
+import time
+import pytest
+from conftest import run_gits, get_future_time, read_changeset
+
+
+S3_ENDPOINT = os.environ.get("S3_ENDPOINT", "")
+S3_TEST_BUCKET = os.environ.get("S3_TEST_BUCKET", "gits-test")
+
+
+def make_changes(repo):
+    (repo / "app.py").write_text("print('hello')\n")
+    (repo / "README.md").write_text("# Changed\n")
+
+
+def schedule_payload(api):
+    requests = [r for r in api.requests if r["path"] == "/schedule"]
+    assert len(requests) == 1
+    return json.loads(requests[0]["body"])
+
+
+class TestPresignedUpload:
+
+    def test_raw_zip_uploaded_to_presigned_url(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """Zip goes to the pre-signed URL, schedule only carries the key."""
+        key = "changes-1/gits-changes.zip"
+        fake_api.routes[("POST", "/upload-url")] = lambda r: (200, {
+            "upload_url": f"{fake_api.url}/bucket/{key}",
+            "s3_key": key,
+        })
+        fake_api.routes[("PUT", f"/bucket/{key}")] = lambda r: (200, {})
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+
+        put = [r for r in fake_api.requests if r["method"] == "PUT"]
+        assert len(put) == 1
+        archive = read_changeset(put[0]["body"])
+        assert archive["app.py"] == b"print('hello')\n"
+
+        payload = schedule_payload(fake_api)
+        assert payload["s3_key"] == key
+        assert "zip_base64" not in payload
+
+    def test_falls_back_to_inline_without_upload_endpoint(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """Older deployments without /upload-url still get the zip inline."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+
+        payload = schedule_payload(fake_api)
+        assert "s3_key" not in payload
+        archive = read_changeset(base64.b64decode(payload["zip_base64"]))
+        assert archive["README.md"] == b"# Changed\n"
+
+    @pytest.mark.skipif(not S3_ENDPOINT, reason="S3_ENDPOINT not set (e.g. a local MinIO)")
+    def test_upload_to_s3_compatible_store(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """Round trip through a real pre-signed URL on MinIO."""
+        boto3 = pytest.importorskip("boto3")
+        s3 = boto3.client("s3", endpoint_url=S3_ENDPOINT, region_name=os.environ.get("AWS_REGION", "us-east-1"))
+        try:
+            s3.create_bucket(Bucket=S3_TEST_BUCKET)
+        except s3.exceptions.BucketAlreadyOwnedByYou:
+            pass
+
+        key = f"changes-{os.getpid()}/gits-changes.zip"
+        fake_api.routes[("POST", "/upload-url")] = lambda r: (200, {
+            "upload_url": s3.generate_presigned_url(
+                "put_object", Params={"Bucket": S3_TEST_BUCKET, "Key": key}, ExpiresIn=900
+            ),
+            "s3_key": key,
+        })
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+
+        body = s3.get_object(Bucket=S3_TEST_BUCKET, Key=key)["Body"].read()
+        archive = read_changeset(body)
+        assert archive["app.py"] == b"print('hello')\n"
+        assert schedule_payload(fake_api)["s3_key"] == key
+        s3.delete_object(Bucket=S3_TEST_BUCKET, Key=key)
+
+
+class TestBlobDedup:
+
+    def test_only_missing_blobs_uploaded(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """Files over BLOB_MIN_SIZE go by hash; stored blobs are not re-sent."""
+        with open(api_gits_config, "a") as f:
+            f.write("BLOB_MIN_SIZE=1024\n")
+        stored = b"s" * 4096
+        fresh = b"f" * 4096
+        (temp_git_repo / "stored.bin").write_bytes(stored)
+        (temp_git_repo / "fresh.bin").write_bytes(fresh)
+        (temp_git_repo / "small.txt").write_text("small\n")
+        fresh_hash = hashlib.sha256(fresh).hexdigest()
+        stored_hash = hashlib.sha256(stored).hexdigest()
+
+        def check(request):
+            hashes = json.loads(request["body"])["hashes"]
+            assert sorted(hashes) == sorted([fresh_hash, stored_hash])
+            return 200, {"missing": {fresh_hash: f"{fake_api.url}/blobs/{fresh_hash}"}, "checksum_sha256": True}
+
+        fake_api.routes[("POST", "/blobs")] = check
+        fake_api.routes[("PUT", f"/blobs/{fresh_hash}")] = lambda r: (200, {})
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+
+        puts = [r for r in fake_api.requests if r["method"] == "PUT"]
+        assert [r["body"] for r in puts] == [fresh]
+        checksum = base64.b64encode(hashlib.sha256(fresh).digest()).decode()
+        assert puts[0]["headers"].get("x-amz-checksum-sha256") == checksum
+
+        archive = read_changeset(base64.b64decode(schedule_payload(fake_api)["zip_base64"]))
+        names = list(archive)
+        assert "small.txt" in names
+        assert "stored.bin" not in names and "fresh.bin" not in names
+        manifest = json.loads(archive[next(n for n in names if n.startswith(".gits-manifest-"))])
+        assert {b["path"]: b["sha256"] for b in manifest["blobs"]} == {
+            "stored.bin": stored_hash,
+            "fresh.bin": fresh_hash,
+        }
+
+
+class TestChangeDetection:
+
+    def test_awkward_paths_and_renames(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """Quoted and arrow-containing paths survive status parsing."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        (temp_git_repo / "old name.txt").write_text("rename me\n")
+        (temp_git_repo / "gone.txt").write_text("delete me\n")
+        subprocess.run(["git", "add", "."], cwd=temp_git_repo, check=True)
+        subprocess.run(["git", "commit", "-q", "-m", "Add files"], cwd=temp_git_repo, check=True)
+
+        subprocess.run(["git", "mv", "old name.txt", "a -> b.txt"], cwd=temp_git_repo, check=True)
+        os.remove(temp_git_repo / "gone.txt")
+        (temp_git_repo / "naïve café.txt").write_text("unicode\n")
+        (temp_git_repo / "sub dir").mkdir()
+        (temp_git_repo / "sub dir" / "x.txt").write_text("nested\n")
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+
+        archive = read_changeset(base64.b64decode(schedule_payload(fake_api)["zip_base64"]))
+        assert archive["a -> b.txt"] == b"rename me\n"
+        assert archive["naïve café.txt"] == b"unicode\n"
+        assert archive["sub dir/x.txt"] == b"nested\n"
+        manifest = json.loads(archive[next(n for n in archive if n.startswith(".gits-manifest-"))])
+        assert sorted(manifest["deleted"]) == ["gone.txt", "old name.txt"]
+
+    def test_deleted_top_level_entries_with_status_threads(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """A sharded work tree scan still reports top-level files and directories that are gone."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        with open(api_gits_config, "a") as f:
+            f.write("STATUS_THREADS=4\n")
+        for name in ("a.txt", "b.txt", "c.txt", "gone.txt"):
+            (temp_git_repo / name).write_text(name + "\n")
+        (temp_git_repo / "olddir").mkdir()
+        (temp_git_repo / "olddir" / "one.txt").write_text("one\n")
+        (temp_git_repo / "olddir" / "two.txt").write_text("two\n")
+        subprocess.run(["git", "add", "."], cwd=temp_git_repo, check=True)
+        subprocess.run(["git", "commit", "-q", "-m", "Add files"], cwd=temp_git_repo, check=True)
+
+        os.remove(temp_git_repo / "gone.txt")
+        shutil.rmtree(temp_git_repo / "olddir")
+        (temp_git_repo / "a.txt").write_text("changed\n")
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+
+        archive = read_changeset(base64.b64decode(schedule_payload(fake_api)["zip_base64"]))
+        assert archive["a.txt"] == b"changed\n"
+        manifest = json.loads(archive[next(n for n in archive if n.startswith(".gits-manifest-"))])
+        assert sorted(manifest["deleted"]) == ["gone.txt", "olddir/one.txt", "olddir/two.txt"]
+
+
+class TestHttpClient:
+
+    def test_connection_reused_and_timing_reported(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """All requests of one command share a connection; NETWORK_TIMING reports them."""
+        with open(api_gits_config, "a") as f:
+            f.write("NETWORK_TIMING=1\n")
+        key = "changes-1/gits-changes.zip"
+        fake_api.routes[("POST", "/upload-url")] = lambda r: (200, {
+            "upload_url": f"{fake_api.url}/bucket/{key}",
+            "s3_key": key,
+        })
+        fake_api.routes[("PUT", f"/bucket/{key}")] = lambda r: (200, {})
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert "Network: 3 request(s), 0 over HTTP/2, 1 new connection(s)" in result.stderr
+
+        port = fake_api.url.rsplit(":", 1)[1]
+        cache = (tmp_path / ".gits" / "dns-cache").read_text().split()
+        assert cache[:2] == [f"127.0.0.1:{port}", "127.0.0.1"]
+
+    def test_stale_cached_address_is_replaced(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """A cached address that no longer answers is dropped and the host looked up again."""
+        port = fake_api.url.rsplit(":", 1)[1]
+        api_gits_config.write_text(api_gits_config.read_text().replace("127.0.0.1", "localhost"))
+        (tmp_path / ".gits" / "dns-cache").write_text(f"localhost:{port} 127.0.0.2 {int(time.time())}\n")
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert "127.0.0.2" not in (tmp_path / ".gits" / "dns-cache").read_text()
+
+
+class FakeMultipart:
+    """Serves /multipart and the part URLs like the schedule lambda and S3 would."""
+
+    PART_SIZE = 100
+
+    def __init__(self, api, fail_part=None):
+        self.api = api
+        self.fail_part = fail_part
+        self.etags = {}
+        self.completed = []
+        api.routes[("POST", "/multipart")] = self.handle
+        api.routes[("POST", "/upload-url")] = lambda r: (200, {
+            "upload_url": f"{api.url}/bucket/single", "s3_key": "changes-1/gits-changes.zip",
+        })
+        api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        for n in range(1, 1001):
+            api.routes[("PUT", f"/bucket/part-{n}")] = lambda r, n=n: self.put_part(n, r)
+
+    def urls(self, numbers):
+        return [{"part_number": n, "url": f"{self.api.url}/bucket/part-{n}?uploadId=up-1"} for n in numbers]
+
+    def put_part(self, n, request):
+        if n == self.fail_part:
+            return (400, {"error": "RequestTimeout"})
+        self.etags[n] = (f'"etag-{n}"', request["body"])
+        return (200, {}, {"ETag": f'"etag-{n}"'})
+
+    def handle(self, request):
+        body = json.loads(request["body"])
+        if body["action"] == "start":
+            parts = -(-body["size"] // self.PART_SIZE)
+            return (200, {"upload_id": "up-1", "s3_key": "changes-1/gits-changes.zip",
+                          "part_size": self.PART_SIZE, "part_urls": self.urls(range(1, parts + 1))})
+        if body["action"] == "resume":
+            uploaded = [{"part_number": n, "etag": etag, "size": len(data)} for n, (etag, data) in sorted(self.etags.items())]
+            return (200, {"parts": uploaded, "part_urls": self.urls(n for n in body["part_numbers"] if n not in self.etags)})
+        self.completed.append(body["parts"])
+        return (200, {"s3_key": body["s3_key"]})
+
+    def assembled(self):
+        return b"".join(data for _, (_, data) in sorted(self.etags.items()))
+
+
+class TestMultipartUpload:
+
+    def enable(self, api_gits_config):
+        with open(api_gits_config, "a") as f:
+            f.write("MULTIPART_MIN_SIZE=1\n")
+
+    def test_parts_uploaded_and_completed(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """Every part is PUT, complete lists all ETags and schedule carries the key."""
+        self.enable(api_gits_config)
+        s3 = FakeMultipart(fake_api)
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert "Uploaded" in result.stdout
+
+        assert len(s3.etags) > 1
+        archive = read_changeset(s3.assembled())
+        assert archive["app.py"] == b"print('hello')\n"
+        assert s3.completed == [[{"part_number": n, "etag": f'"etag-{n}"'} for n in sorted(s3.etags)]]
+        assert not any(r["path"] == "/bucket/single" for r in fake_api.requests)
+        assert schedule_payload(fake_api)["s3_key"] == "changes-1/gits-changes.zip"
+        assert not (api_gits_config.parent / "uploads").exists() or not any((api_gits_config.parent / "uploads").iterdir())
+
+    def test_interrupted_upload_resumes(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """A failed part leaves a checkpoint; the next run uploads only what is missing."""
+        self.enable(api_gits_config)
+        s3 = FakeMultipart(fake_api, fail_part=3)
+        make_changes(temp_git_repo)
+        schedule_time = get_future_time(60)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", schedule_time], cwd=temp_git_repo)
+        assert result.returncode == 1
+        assert "run the same command again to resume" in result.stderr
+        assert list((api_gits_config.parent / "uploads").glob("*/state.json"))
+        assert not any(r["path"] == "/schedule" for r in fake_api.requests)
+        first_run = {r["path"] for r in fake_api.requests if r["method"] == "PUT" and r["path"] != "/bucket/part-3"}
+
+        s3.fail_part = None
+        fake_api.requests.clear()
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", schedule_time], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert "Resuming upload" in result.stdout
+
+        second_run = {r["path"] for r in fake_api.requests if r["method"] == "PUT"}
+        assert "/bucket/part-3" in second_run
+        assert not first_run & second_run
+        assert read_changeset(s3.assembled())["README.md"] == b"# Changed\n"
+        assert len(s3.completed) == 1
+        assert schedule_payload(fake_api)["s3_key"] == "changes-1/gits-changes.zip"
+        assert not any((api_gits_config.parent / "uploads").iterdir())
+
+    def test_corrupt_checkpoint_starts_over(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """A state.json with bad part numbers or ETags is no checkpoint, not a crash."""
+        self.enable(api_gits_config)
+        s3 = FakeMultipart(fake_api, fail_part=3)
+        make_changes(temp_git_repo)
+        schedule_time = get_future_time(60)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", schedule_time], cwd=temp_git_repo)
+        assert result.returncode == 1
+        state_file, = (api_gits_config.parent / "uploads").glob("*/state.json")
+        state = json.loads(state_file.read_text())
+        state["parts"] = {"one": 42}
+        state_file.write_text(json.dumps(state))
+
+        s3.fail_part = None
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", schedule_time], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert "Resuming upload" not in result.stdout
+        assert read_changeset(s3.assembled())["README.md"] == b"# Changed\n"
+        assert schedule_payload(fake_api)["s3_key"] == "changes-1/gits-changes.zip"
+
+
+class TestRetry:
+
+    def test_idempotency_key_is_stable(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """The same changes scheduled twice carry the same idempotency key."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        make_changes(temp_git_repo)
+        schedule_time = get_future_time(60)
+
+        for _ in range(2):
+            result = run_gits(gits_binary, ["schedule", "--schedule_time", schedule_time], cwd=temp_git_repo)
+            assert result.returncode == 0, result.stderr
+        first, second = [json.loads(r["body"]) for r in fake_api.requests if r["path"] == "/schedule"]
+        assert len(first["idempotency_key"]) == 64
+        assert first["idempotency_key"] == second["idempotency_key"]
+
+        (temp_git_repo / "app.py").write_text("print('changed')\n")
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", schedule_time], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        third = json.loads(fake_api.requests[-1]["body"])
+        assert third["idempotency_key"] != first["idempotency_key"]
+
+    def test_transient_errors_retried_with_same_key(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """503s are retried and every attempt carries the same key."""
+        answers = [(503, {"message": "Service Unavailable"}), (503, {"message": "Service Unavailable"}), (200, {"message": "Scheduled"})]
+        fake_api.routes[("POST", "/schedule")] = lambda r: answers.pop(0)
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert result.stderr.count("retrying in") == 2
+        keys = {json.loads(r["body"])["idempotency_key"] for r in fake_api.requests if r["path"] == "/schedule"}
+        assert len(keys) == 1
+
+    def test_client_errors_not_retried(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """A 400 fails at once."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (400, {"error": "Invalid schedule_time format"})
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert "retrying" not in result.stderr
+        assert len([r for r in fake_api.requests if r["path"] == "/schedule"]) == 1
+
+    def test_duplicate_reported(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """A request the backend already scheduled is reported, not scheduled again."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled", "rule_name": "gits-1", "duplicate": True})
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+        assert "Already scheduled by an earlier attempt: gits-1" in result.stdout
+
+    def test_retry_deadline(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """RETRY_DEADLINE=0 turns retries off."""
+        with open(api_gits_config, "a") as f:
+            f.write("RETRY_DEADLINE=0\n")
+        fake_api.routes[("POST", "/schedule")] = lambda r: (503, {"message": "Service Unavailable"})
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode != 0
+        assert len([r for r in fake_api.requests if r["path"] == "/schedule"]) == 1
+
+
+class TestTrace:
+
+    def test_trace_file_and_summary(self, gits_binary, temp_git_repo, fake_api, api_gits_config, tmp_path):
+        """Every step and request is a span; requests carry their timing breakdown."""
+        key = "changes-1/gits-changes.zip"
+        fake_api.routes[("POST", "/upload-url")] = lambda r: (200, {
+            "upload_url": f"{fake_api.url}/bucket/{key}?X-Amz-Signature=secret",
+            "s3_key": key,
+        })
+        fake_api.routes[("PUT", f"/bucket/{key}")] = lambda r: (200, {})
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        make_changes(temp_git_repo)
+        trace_file = tmp_path / "trace.json"
+
+        result = run_gits(gits_binary, ["schedule", "--trace", str(trace_file), "--schedule_time", get_future_time(60),
+                                        "--trace-summary"], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+
+        events = json.loads(trace_file.read_text())["traceEvents"]
+        spans = [e for e in events if e["ph"] == "X"]
+        phases = {e["name"] for e in spans if e["cat"] == "phase"}
+        assert {"load config", "git checks", "git status", "gather_file_changes", "create_zip", "upload",
+                "send_schedule_request"} <= phases
+        requests = [e for e in spans if e["cat"] == "http"]
+        assert {e["name"] for e in requests} == {"POST /upload-url", f"PUT /bucket/{key}", "POST /schedule"}
+        assert all(e["args"]["status"] == "200" for e in requests)
+        assert "secret" not in trace_file.read_text()
+        steps = [e for e in spans if e["cat"] == "http.step"]
+        assert {"connect", "wait"} <= {e["name"] for e in steps}
+        for step in steps:
+            parent = next(r for r in requests if r["tid"] == step["tid"] and r["ts"] <= step["ts"] + 1
+                          and step["ts"] + step["dur"] <= r["ts"] + r["dur"] + 1)
+            assert parent
+
+        assert "Trace:" in result.stderr
+        assert "gather_file_changes" in result.stderr
+        assert "HTTP (3 requests)" in result.stderr
+
+
+def multipart_parts(request):
+    """Split a recorded multipart/form-data request into {name: (headers, bytes)}."""
+    content_type = request["headers"]["Content-Type"]
+    assert content_type.startswith("multipart/form-data; boundary=")
+    message = email.parser.BytesParser(policy=email.policy.HTTP).parsebytes(
+        b"Content-Type: " + content_type.encode() + b"\r\n\r\n" + request["body"])
+    return {part.get_param("name", header="content-disposition"): (part, part.get_payload(decode=True))
+            for part in message.iter_parts()}
+
+
+class TestScheduleEncoding:
+
+    @pytest.mark.parametrize("upload_mode", ["stream", "buffered"])
+    def test_multipart_body(self, gits_binary, temp_git_repo, fake_api, api_gits_config, upload_mode):
+        """The metadata is a JSON part and the zip a raw part, without base64."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled", "rule_name": "gits-1"})
+        with open(api_gits_config, "a") as f:
+            f.write(f"UPLOAD_MODE={upload_mode}\nSCHEDULE_ENCODING=multipart\n")
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+
+        request = next(r for r in fake_api.requests if r["path"] == "/schedule")
+        parts = multipart_parts(request)
+        assert set(parts) == {"payload", "changes"}
+        payload = json.loads(parts["payload"][1])
+        assert "zip_base64" not in payload
+        assert payload["idempotency_key"]
+        assert parts["changes"][0].get_filename() == payload["zip_filename"]
+        archive = read_changeset(parts["changes"][1])
+        assert archive["app.py"] == b"print('hello')\n"
+        assert archive["README.md"] == b"# Changed\n"
+
+    def test_multipart_bundle_without_upload_endpoint(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        """A bundle sent inline goes raw too."""
+        fake_api.routes[("POST", "/schedule")] = lambda r: (200, {"message": "Scheduled"})
+        with open(api_gits_config, "a") as f:
+            f.write("SCHEDULE_ENCODING=multipart\n")
+        make_changes(temp_git_repo)
+
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60), "--mode", "bundle"], cwd=temp_git_repo)
+        assert result.returncode == 0, result.stderr
+
+        parts = multipart_parts(next(r for r in fake_api.requests if r["path"] == "/schedule"))
+        assert json.loads(parts["payload"][1])["format"] == "bundle"
+        assert parts["changes"][1].startswith(b"# v2 git bundle\n")
+        assert not list(temp_git_repo.glob("*.bundle"))
+
+    def test_invalid_encoding(self, gits_binary, temp_git_repo, fake_api, api_gits_config):
+        with open(api_gits_config, "a") as f:
+            f.write("SCHEDULE_ENCODING=cbor\n")
+        make_changes(temp_git_repo)
+        result = run_gits(gits_binary, ["schedule", "--schedule_time", get_future_time(60)], cwd=temp_git_repo)
+        assert result.returncode == 1
+        assert "SCHEDULE_ENCODING must be json or multipart" in result.stderr